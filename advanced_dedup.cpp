@@ -1,1158 +1,10158 @@
-#include <iostream>
-#include <filesystem>
-#include <fstream>
-#include <vector>
-#include <map>
-#include <string>
-#include <algorithm>
-#include <chrono>
-#include <limits>
-#include <sstream>
-#include <set>
-#include <cstring>
-#include <locale>
-#include <windows.h>
-
-namespace fs = std::filesystem;
-
-class InteractiveFileDeduplicator {
-private:
-    bool dryRun;
-    bool verbose;
-    bool autoConfirm;
-    bool skipEmptyFolders;
-    size_t samplePoints;
-    size_t sampleSize;
-    std::string mode;
-
-    struct DeduplicationResult {
-    std::vector<std::vector<fs::path>> duplicateGroups;
-    int totalFiles = 0;
-    uintmax_t totalSize = 0;
-    std::string error;
-    };
-
-public:
-    InteractiveFileDeduplicator(bool dry = false, bool verb = false, bool autoConfirm = false,
-                               bool skipEmpty = true, size_t points = 4, size_t size = 4096,
-                               const std::string& mod = "all")
-        : dryRun(dry), verbose(verb), autoConfirm(autoConfirm), skipEmptyFolders(skipEmpty),
-          samplePoints(points), sampleSize(size), mode(mod) {}
-
-    // 获取文件大小
-    uintmax_t getFileSize(const fs::path& filepath) {
-        return fs::file_size(filepath);
-    }
-
-    // 格式化文件大小
-    std::string formatFileSize(uintmax_t size) {
-        const char* units[] = {"B", "KB", "MB", "GB"};
-        int unitIndex = 0;
-        double sizeValue = static_cast<double>(size);
-        
-        while (sizeValue >= 1024.0 && unitIndex < 3) {
-            sizeValue /= 1024.0;
-            unitIndex++;
-        }
-        
-        char buffer[32];
-        snprintf(buffer, sizeof(buffer), "%.2f %s", sizeValue, units[unitIndex]);
-        return buffer;
-    }
-
-    // 获取文件修改时间
-    std::string getFileTimeString(const fs::path& filepath) {
-        auto writeTime = fs::last_write_time(filepath);
-        auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-            writeTime - fs::file_time_type::clock::now() + std::chrono::system_clock::now());
-        std::time_t time = std::chrono::system_clock::to_time_t(sctp);
-        
-        char buffer[64];
-        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", std::localtime(&time));
-        return buffer;
-    }
-
-    // 快速抽样比较
-    std::string generateFileSignature(const fs::path& filepath) {
-        uintmax_t size = getFileSize(filepath);
-        std::string signature = std::to_string(size) + "|";
-        
-        if (size <= sampleSize * 2) {
-            return signature + "SMALL";
-        }
-
-        std::ifstream file(filepath, std::ios::binary);
-        if (!file) {
-            throw std::runtime_error("无法打开文件: " + filepath.string());
-        }
-
-        std::vector<uintmax_t> keyPositions = {0};
-        
-        for (size_t i = 1; i <= samplePoints; ++i) {
-            uintmax_t pos = (size * i) / (samplePoints + 1);
-            keyPositions.push_back(pos);
-        }
-        
-        keyPositions.push_back(size - std::min(sampleSize, size));
-
-        std::sort(keyPositions.begin(), keyPositions.end());
-        keyPositions.erase(std::unique(keyPositions.begin(), keyPositions.end()), keyPositions.end());
-
-        std::vector<char> buffer(sampleSize);
-        
-        for (uintmax_t pos : keyPositions) {
-            uintmax_t readSize = std::min(sampleSize, size - pos);
-            file.seekg(pos);
-            file.read(buffer.data(), readSize);
-            
-            if (file.gcount() != readSize) {
-                throw std::runtime_error("读取文件失败: " + filepath.string());
-            }
-            
-            uint32_t simpleHash = 0;
-            for (size_t i = 0; i < readSize; ++i) {
-                simpleHash = (simpleHash * 31) + static_cast<unsigned char>(buffer[i]);
-            }
-            
-            signature += std::to_string(simpleHash) + "|";
-        }
-
-        return signature;
-    }
-
-    // 逐字节比较文件内容
-    bool areFilesIdentical(const fs::path& file1, const fs::path& file2) {
-        uintmax_t size1 = getFileSize(file1);
-        uintmax_t size2 = getFileSize(file2);
-        
-        if (size1 != size2) {
-            return false;
-        }
-        
-        if (size1 == 0) {
-            return true;
-        }
-
-        std::ifstream f1(file1, std::ios::binary);
-        std::ifstream f2(file2, std::ios::binary);
-        
-        if (!f1 || !f2) {
-            return false;
-        }
-
-        const size_t bufferSize = 1024 * 64;
-        std::vector<char> buffer1(bufferSize);
-        std::vector<char> buffer2(bufferSize);
-        
-        uintmax_t totalRead = 0;
-        
-        while (totalRead < size1) {
-            size_t toRead = std::min(bufferSize, static_cast<size_t>(size1 - totalRead));
-            
-            f1.read(buffer1.data(), toRead);
-            f2.read(buffer2.data(), toRead);
-            
-            size_t bytesRead1 = f1.gcount();
-            size_t bytesRead2 = f2.gcount();
-            
-            if (bytesRead1 != bytesRead2 || bytesRead1 != toRead) {
-                return false;
-            }
-            
-            if (memcmp(buffer1.data(), buffer2.data(), toRead) != 0) {
-                return false;
-            }
-            
-            totalRead += toRead;
-        }
-
-        return true;
-    }
-
-    // 用户确认函数
-    bool askForConfirmation(const std::string& question, bool defaultYes = false) {
-        if (autoConfirm) {
-            std::cout << question << " (自动确认: 是)" << std::endl;
-            return true;
-        }
-        
-        std::cout << question << " [" << (defaultYes ? "Y/n" : "y/N") << "]: ";
-        std::cout.flush();
-        
-        std::string response;
-        std::getline(std::cin, response);
-        
-        if (response.empty()) {
-            return defaultYes;
-        }
-        
-        char firstChar = std::tolower(response[0]);
-        return (firstChar == 'y');
-    }
-
-    // 显示重复文件组（带编号）
-    void displayDuplicateGroupsWithNumbers(const std::vector<std::vector<fs::path>>& duplicateGroups) {
-        std::cout << "\n" << std::string(80, '=') << std::endl;
-        std::cout << "重复文件详细列表 (带编号)" << std::endl;
-        std::cout << std::string(80, '=') << std::endl;
-        
-        for (size_t groupIndex = 0; groupIndex < duplicateGroups.size(); ++groupIndex) {
-            const auto& group = duplicateGroups[groupIndex];
-            uintmax_t groupSize = getFileSize(group[0]);
-            
-            std::cout << "\n第 " << (groupIndex + 1) << " 组重复文件 (" << group.size() << " 个文件, " 
-                      << formatFileSize(groupSize) << "):" << std::endl;
-            std::cout << std::string(60, '-') << std::endl;
-            
-            for (size_t i = 0; i < group.size(); ++i) {
-                std::cout << "  [" << (i + 1) << "] " 
-                          << (i == 0 ? "✓ 保留: " : "✗ 删除: ") 
-                          << group[i].filename() << std::endl;
-                std::cout << "      路径: " << group[i].parent_path() << std::endl;
-                std::cout << "      大小: " << formatFileSize(getFileSize(group[i])) 
-                          << ", 修改时间: " << getFileTimeString(group[i]) << std::endl;
-            }
-        }
-        
-        std::cout << std::string(80, '=') << std::endl;
-    }
-
-    // 显示单个重复文件组的详细信息
-    void displaySingleGroup(const std::vector<fs::path>& group, int groupIndex) {
-        std::cout << "\n" << std::string(60, '=') << std::endl;
-        std::cout << "第 " << groupIndex << " 组重复文件 (" << group.size() << " 个文件):" << std::endl;
-        std::cout << std::string(60, '=') << std::endl;
-        
-        for (size_t i = 0; i < group.size(); ++i) {
-            std::cout << "  [" << (i + 1) << "] " << group[i].filename() << std::endl;
-            std::cout << "      路径: " << group[i] << std::endl;
-            std::cout << "      大小: " << formatFileSize(getFileSize(group[i])) 
-                      << ", 修改时间: " << getFileTimeString(group[i]) << std::endl;
-        }
-        std::cout << std::string(60, '=') << std::endl;
-    }
-
-    // 显示修改后的保留方案
-    void displayModifiedRetention(const std::vector<std::vector<fs::path>>& duplicateGroups,
-                                 const std::vector<std::set<size_t>>& keepFiles) {
-        std::cout << "\n" << std::string(80, '=') << std::endl;
-        std::cout << "修改后的保留方案" << std::endl;
-        std::cout << std::string(80, '=') << std::endl;
-        
-        int totalKept = 0;
-        int totalDeleted = 0;
-        uintmax_t totalSpaceSaved = 0;
-
-        for (size_t groupIndex = 0; groupIndex < duplicateGroups.size(); ++groupIndex) {
-            const auto& group = duplicateGroups[groupIndex];
-            const auto& keepSet = keepFiles[groupIndex];
-            
-            std::cout << "\n第 " << (groupIndex + 1) << " 组重复文件:" << std::endl;
-            std::cout << std::string(60, '-') << std::endl;
-            
-            for (size_t i = 0; i < group.size(); ++i) {
-                bool willKeep = (keepSet.find(i + 1) != keepSet.end());
-                std::cout << "  " << (willKeep ? "✓ 保留" : "✗ 删除") 
-                          << " [" << (i + 1) << "] " << group[i].filename() << std::endl;
-                
-                if (!willKeep) {
-                    totalDeleted++;
-                    totalSpaceSaved += getFileSize(group[i]);
-                } else {
-                    totalKept++;
-                }
-            }
-            
-            std::cout << "  本组保留: " << keepSet.size() << " 个文件" << std::endl;
-        }
-        
-        std::cout << std::string(80, '=') << std::endl;
-        std::cout << "总计: 保留 " << totalKept << " 个文件, 删除 " << totalDeleted 
-                  << " 个文件, 节省 " << formatFileSize(totalSpaceSaved) << std::endl;
-        std::cout << std::string(80, '=') << std::endl;
-    }
-
-    // 自动选择保留文件的策略
-    std::set<size_t> autoSelectKeepFiles(const std::vector<fs::path>& group, const std::string& strategy) {
-        std::set<size_t> keepSet;
-        
-        if (strategy == "newest") {
-            // 保留修改时间最新的文件
-            std::vector<std::pair<fs::file_time_type, size_t>> times;
-            for (size_t i = 0; i < group.size(); ++i) {
-                times.emplace_back(fs::last_write_time(group[i]), i + 1);
-            }
-            std::sort(times.begin(), times.end(), std::greater<>());
-            keepSet.insert(times[0].second);
-            
-        } else if (strategy == "oldest") {
-            // 保留修改时间最旧的文件
-            std::vector<std::pair<fs::file_time_type, size_t>> times;
-            for (size_t i = 0; i < group.size(); ++i) {
-                times.emplace_back(fs::last_write_time(group[i]), i + 1);
-            }
-            std::sort(times.begin(), times.end());
-            keepSet.insert(times[0].second);
-            
-        } else if (strategy == "longest-name") {
-            // 保留文件名最长的文件
-            size_t maxLength = 0;
-            size_t keepIndex = 1;
-            for (size_t i = 0; i < group.size(); ++i) {
-                size_t length = group[i].filename().string().length();
-                if (length > maxLength) {
-                    maxLength = length;
-                    keepIndex = i + 1;
-                }
-            }
-            keepSet.insert(keepIndex);
-            
-        } else if (strategy == "shortest-name") {
-            // 保留文件名最短的文件
-            size_t minLength = std::numeric_limits<size_t>::max();
-            size_t keepIndex = 1;
-            for (size_t i = 0; i < group.size(); ++i) {
-                size_t length = group[i].filename().string().length();
-                if (length < minLength) {
-                    minLength = length;
-                    keepIndex = i + 1;
-                }
-            }
-            keepSet.insert(keepIndex);
-        }
-        
-        return keepSet;
-    }
-
-    // 让用户修改保留方案 - 新版本
-    std::vector<std::set<size_t>> letUserModifyRetention(const std::vector<std::vector<fs::path>>& duplicateGroups) {
-        std::vector<std::set<size_t>> keepFiles(duplicateGroups.size());
-        
-        // 初始化默认保留方案（每个组保留第一个文件）
-        for (size_t i = 0; i < duplicateGroups.size(); ++i) {
-            keepFiles[i] = {1};
-        }
-
-        std::cout << "\n🛠️  自定义保留方案" << std::endl;
-        std::cout << "操作说明:" << std::endl;
-        std::cout << "  - 输入组号 (如: 1) 查看并修改该组的保留文件" << std::endl;
-        std::cout << "  - 输入 'all' 对所有组使用自动选择" << std::endl;
-        std::cout << "  - 输入 'auto' 对当前组使用自动选择" << std::endl;
-        std::cout << "  - 输入 'list' 显示所有重复组" << std::endl;
-        std::cout << "  - 输入 'done' 完成自定义" << std::endl;
-        std::cout << "  - 输入 'view 组号' 查看指定组的详细信息" << std::endl;
-
-        while (true) {
-            std::cout << "\n请输入命令 (组号/all/auto/list/done/view): ";
-            std::cout.flush();
-            
-            std::string input;
-            std::getline(std::cin, input);
-            
-            if (input.empty()) {
-                continue;
-            }
-            
-            // 转换为小写处理命令
-            std::string command = input;
-            std::transform(command.begin(), command.end(), command.begin(), ::tolower);
-            
-            if (command == "done") {
-                break;
-            }
-            else if (command == "list") {
-                displayDuplicateGroupsWithNumbers(duplicateGroups);
-            }
-            else if (command == "all") {
-                // 对所有组使用自动选择
-                std::cout << "请选择自动保留策略:" << std::endl;
-                std::cout << "  1. 保留修改时间最新的文件" << std::endl;
-                std::cout << "  2. 保留修改时间最旧的文件" << std::endl;
-                std::cout << "  3. 保留文件名最长的文件" << std::endl;
-                std::cout << "  4. 保留文件名最短的文件" << std::endl;
-                std::cout << "请输入选择 (1-4): ";
-                
-                std::string strategyInput;
-                std::getline(std::cin, strategyInput);
-                
-                std::string strategy;
-                if (strategyInput == "1") strategy = "newest";
-                else if (strategyInput == "2") strategy = "oldest";
-                else if (strategyInput == "3") strategy = "longest-name";
-                else if (strategyInput == "4") strategy = "shortest-name";
-                else {
-                    std::cout << "无效选择，使用默认策略(最新文件)" << std::endl;
-                    strategy = "newest";
-                }
-                
-                for (size_t i = 0; i < duplicateGroups.size(); ++i) {
-                    keepFiles[i] = autoSelectKeepFiles(duplicateGroups[i], strategy);
-                }
-                
-                std::cout << "已对所有组应用自动选择策略: " << strategy << std::endl;
-                displayModifiedRetention(duplicateGroups, keepFiles);
-            }
-            else if (command.find("view") == 0) {
-                // 查看指定组的详细信息
-                std::stringstream ss(input);
-                std::string cmd;
-                int groupNum;
-                ss >> cmd >> groupNum;
-                
-                if (groupNum < 1 || groupNum > duplicateGroups.size()) {
-                    std::cout << "错误: 组号 " << groupNum << " 超出范围 (1-" << duplicateGroups.size() << ")" << std::endl;
-                } else {
-                    displaySingleGroup(duplicateGroups[groupNum - 1], groupNum);
-                }
-            }
-            else if (command == "auto") {
-                std::cout << "请先输入要自动选择的组号: ";
-                std::string groupInput;
-                std::getline(std::cin, groupInput);
-                
-                try {
-                    int groupNum = std::stoi(groupInput);
-                    if (groupNum < 1 || groupNum > duplicateGroups.size()) {
-                        std::cout << "错误: 组号 " << groupNum << " 超出范围 (1-" << duplicateGroups.size() << ")" << std::endl;
-                        continue;
-                    }
-                    
-                    std::cout << "请选择自动保留策略:" << std::endl;
-                    std::cout << "  1. 保留修改时间最新的文件" << std::endl;
-                    std::cout << "  2. 保留修改时间最旧的文件" << std::endl;
-                    std::cout << "  3. 保留文件名最长的文件" << std::endl;
-                    std::cout << "  4. 保留文件名最短的文件" << std::endl;
-                    std::cout << "请输入选择 (1-4): ";
-                    
-                    std::string strategyInput;
-                    std::getline(std::cin, strategyInput);
-                    
-                    std::string strategy;
-                    if (strategyInput == "1") strategy = "newest";
-                    else if (strategyInput == "2") strategy = "oldest";
-                    else if (strategyInput == "3") strategy = "longest-name";
-                    else if (strategyInput == "4") strategy = "shortest-name";
-                    else {
-                        std::cout << "无效选择，使用默认策略(最新文件)" << std::endl;
-                        strategy = "newest";
-                    }
-                    
-                    keepFiles[groupNum - 1] = autoSelectKeepFiles(duplicateGroups[groupNum - 1], strategy);
-                    std::cout << "已对第 " << groupNum << " 组应用自动选择策略: " << strategy << std::endl;
-                    
-                } catch (const std::exception& e) {
-                    std::cout << "错误: 无效的组号 '" << groupInput << "'" << std::endl;
-                }
-            }
-            else {
-                // 处理组号输入
-                try {
-                    int groupNum = std::stoi(input);
-                    if (groupNum < 1 || groupNum > duplicateGroups.size()) {
-                        std::cout << "错误: 组号 " << groupNum << " 超出范围 (1-" << duplicateGroups.size() << ")" << std::endl;
-                        continue;
-                    }
-                    
-                    const auto& group = duplicateGroups[groupNum - 1];
-                    displaySingleGroup(group, groupNum);
-                    
-                    std::cout << "当前保留的文件: ";
-                    for (size_t idx : keepFiles[groupNum - 1]) {
-                        std::cout << "[" << idx << "] ";
-                    }
-                    std::cout << std::endl;
-                    
-                    std::cout << "请输入要保留的文件编号 (多个编号直接输入无间隔数字，如: 123): ";
-                    std::string selection;
-                    std::getline(std::cin, selection);
-                    
-                    std::set<size_t> newKeepSet;
-                    bool validInput = true;
-                    
-                    for (char c : selection) {
-                        if (c < '1' || c > '9') {
-                            std::cout << "错误: 包含无效字符 '" << c << "'" << std::endl;
-                            validInput = false;
-                            break;
-                        }
-                        
-                        int fileNum = c - '0';
-                        if (fileNum < 1 || fileNum > group.size()) {
-                            std::cout << "错误: 文件编号 " << fileNum << " 超出范围 (1-" << group.size() << ")" << std::endl;
-                            validInput = false;
-                            break;
-                        }
-                        
-                        newKeepSet.insert(fileNum);
-                    }
-                    
-                    if (validInput && !newKeepSet.empty()) {
-                        keepFiles[groupNum - 1] = newKeepSet;
-                        std::cout << "第 " << groupNum << " 组保留方案已更新: ";
-                        for (size_t idx : newKeepSet) {
-                            std::cout << "[" << idx << "] ";
-                        }
-                        std::cout << std::endl;
-                    } else if (newKeepSet.empty()) {
-                        std::cout << "错误: 至少需要保留一个文件" << std::endl;
-                    }
-                    
-                } catch (const std::exception& e) {
-                    std::cout << "错误: 无效输入 '" << input << "'" << std::endl;
-                }
-            }
-        }
-        
-        return keepFiles;
-    }
-
-    // 对候选组进行精确比较
-    std::vector<std::vector<fs::path>> findExactDuplicates(const std::vector<fs::path>& candidateGroup) {
-        std::vector<std::vector<fs::path>> duplicateGroups;
-        std::vector<bool> processed(candidateGroup.size(), false);
-
-        if (verbose) {
-            std::cout << "  精确比较 " << candidateGroup.size() << " 个候选文件" << std::endl;
-        }
-
-        for (size_t i = 0; i < candidateGroup.size(); ++i) {
-            if (processed[i]) continue;
-
-            std::vector<fs::path> duplicateGroup;
-            duplicateGroup.push_back(candidateGroup[i]);
-            processed[i] = true;
-
-            for (size_t j = i + 1; j < candidateGroup.size(); ++j) {
-                if (processed[j]) continue;
-
-                try {
-                    if (areFilesIdentical(candidateGroup[i], candidateGroup[j])) {
-                        duplicateGroup.push_back(candidateGroup[j]);
-                        processed[j] = true;
-                    }
-                } catch (const std::exception& e) {
-                    std::cerr << "比较文件失败: " << candidateGroup[j] << " - " << e.what() << std::endl;
-                }
-            }
-
-            if (duplicateGroup.size() > 1) {
-                duplicateGroups.push_back(duplicateGroup);
-            }
-        }
-
-        return duplicateGroups;
-    }
-
-    // 在单个文件夹内查找重复文件
-    DeduplicationResult findDuplicatesInFolder(const fs::path& folder) {
-        DeduplicationResult result;
-        
-        if (!fs::exists(folder) || !fs::is_directory(folder)) {
-            result.error = "目录不存在或不是有效目录";
-            return result;
-        }
-
-        // 第一层：按文件大小分组
-        std::map<uintmax_t, std::vector<fs::path>> sizeGroups;
-        
-        for (const auto& entry : fs::directory_iterator(folder)) {
-            if (entry.is_regular_file()) {
-                try {
-                    uintmax_t size = getFileSize(entry.path());
-                    sizeGroups[size].push_back(entry.path());
-                    result.totalFiles++;
-                    result.totalSize += size;
-                } catch (const std::exception& e) {
-                    std::cerr << "处理文件出错: " << entry.path() << " - " << e.what() << std::endl;
-                }
-            }
-        }
-
-        // 第二层：抽样比较
-        std::map<std::string, std::vector<fs::path>> signatureGroups;
-
-        for (const auto& sizeGroup : sizeGroups) {
-            if (sizeGroup.second.size() > 1) {
-                for (const auto& filepath : sizeGroup.second) {
-                    try {
-                        std::string signature = generateFileSignature(filepath);
-                        signatureGroups[signature].push_back(filepath);
-                    } catch (const std::exception& e) {
-                        std::cerr << "生成签名失败: " << filepath << " - " << e.what() << std::endl;
-                    }
-                }
-            }
-        }
-
-        // 第三层：逐字节比较
-        for (const auto& signatureGroup : signatureGroups) {
-            if (signatureGroup.second.size() > 1) {
-                auto duplicateGroups = findExactDuplicates(signatureGroup.second);
-                for (const auto& group : duplicateGroups) {
-                    result.duplicateGroups.push_back(group);
-                }
-            }
-        }
-
-        return result;
-    }
-
-    // 处理单个文件夹（带自定义保留功能）
-    bool processSingleFolder(const fs::path& folder, int folderIndex = -1, int totalFolders = -1) {
-        std::string prefix = "";
-        if (folderIndex >= 0 && totalFolders > 0) {
-            prefix = "[" + std::to_string(folderIndex) + "/" + std::to_string(totalFolders) + "] ";
-        }
-        
-        std::cout << "\n" << std::string(60, '-') << std::endl;
-        std::cout << prefix << "处理文件夹: " << folder << std::endl;
-        std::cout << std::string(60, '-') << std::endl;
-
-        auto startTime = std::chrono::high_resolution_clock::now();
-        auto result = findDuplicatesInFolder(folder);
-        auto endTime = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
-
-        if (!result.error.empty()) {
-            std::cerr << "错误: " << result.error << std::endl;
-            return false;
-        }
-
-        // 显示文件夹统计信息
-        std::cout << "文件数: " << result.totalFiles << ", 大小: " << formatFileSize(result.totalSize) 
-                  << ", 重复组: " << result.duplicateGroups.size() 
-                  << ", 耗时: " << duration.count() << " ms" << std::endl;
-
-        // 计算可删除的文件数和节省空间
-        int deletableFiles = 0;
-        uintmax_t spaceSavable = 0;
-        for (const auto& group : result.duplicateGroups) {
-            deletableFiles += group.size() - 1;
-            spaceSavable += getFileSize(group[0]) * (group.size() - 1);
-        }
-
-        std::cout << "可删除文件: " << deletableFiles << " 个, 可节省空间: " << formatFileSize(spaceSavable) << std::endl;
-
-        // 如果没有重复文件且设置了跳过选项
-        if (result.duplicateGroups.empty()) {
-            if (skipEmptyFolders) {
-                std::cout << "⏭️  跳过无重复文件的文件夹" << std::endl;
-                return true;
-            } else {
-                std::cout << "ℹ️  此文件夹无重复文件" << std::endl;
-                return true;
-            }
-        }
-
-        // 显示带编号的重复文件列表
-        displayDuplicateGroupsWithNumbers(result.duplicateGroups);
-
-        // 询问是否自定义保留方案
-        bool customizeRetention = askForConfirmation("是否要自定义保留哪些文件?", false);
-        std::vector<std::set<size_t>> keepFiles;
-        
-        if (customizeRetention) {
-            keepFiles = letUserModifyRetention(result.duplicateGroups);
-            displayModifiedRetention(result.duplicateGroups, keepFiles);
-        } else {
-            // 使用默认方案（每个组保留第一个文件）
-            for (const auto& group : result.duplicateGroups) {
-                keepFiles.push_back({1});
-            }
-        }
-
-        // 询问是否确认删除
-        bool confirmDelete = askForConfirmation("是否确认按此方案删除重复文件?", false);
-        if (!confirmDelete) {
-            std::cout << "❌ 跳过此文件夹的删除操作" << std::endl;
-            return true;
-        }
-
-        // 执行删除操作
-        performDeletionWithCustomRetention(result.duplicateGroups, keepFiles);
-        return true;
-    }
-
-// 收集所有子文件夹
-std::vector<fs::path> collectAllSubfolders(const fs::path& rootFolder) {
-    std::cout << "正在收集子文件夹..." << std::endl;
-    std::vector<fs::path> folders;
-    folders.push_back(rootFolder);  // 包括根目录本身
-
-    try {
-        for (const auto& entry : fs::recursive_directory_iterator(rootFolder)) {
-            if (entry.is_directory()) {
-                folders.push_back(entry.path());
-                if (verbose) {
-                    std::cout << "找到文件夹: " << entry.path() << std::endl;
-                }
-            }
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "遍历目录时出错: " << e.what() << std::endl;
-    }
-
-    // 按路径长度排序，确保父文件夹在前
-    std::sort(folders.begin(), folders.end(), [](const fs::path& a, const fs::path& b) {
-        return a.string().length() < b.string().length();
-    });
-
-    std::cout << "共找到 " << folders.size() << " 个文件夹" << std::endl;
-    return folders;
-}
-
-// 主去重处理函数
-void deduplicate(const std::string& directory) {
-    std::cout << "开始处理目录: " << directory << std::endl;
-    
-    if (!fs::exists(directory)) {
-        std::cerr << "错误: 目录不存在: " << directory << std::endl;
-        return;
-    }
-    
-    if (!fs::is_directory(directory)) {
-        std::cerr << "错误: 路径不是目录: " << directory << std::endl;
-        return;
-    }
-
-    std::cout << "🎯 文件去重工具 - 模式: " << (mode == "all" ? "全局去重" : "单文件夹去重") << std::endl;
-    std::cout << "目标目录: " << directory << std::endl;
-    std::cout << "跳过无重复文件夹: " << (skipEmptyFolders ? "是" : "否") << std::endl;
-
-    if (mode == "per-folder" || mode == "folder") {
-        // 单文件夹模式：分别处理每个文件夹
-        std::cout << "使用单文件夹模式..." << std::endl;
-        auto folders = collectAllSubfolders(directory);
-        std::cout << "\n找到 " << folders.size() << " 个文件夹需要处理" << std::endl;
-
-        int processedCount = 0;
-        int skippedCount = 0;
-
-        for (size_t i = 0; i < folders.size(); ++i) {
-            bool result = processSingleFolder(folders[i], i + 1, folders.size());
-            if (result) {
-                processedCount++;
-            } else {
-                skippedCount++;
-            }
-
-            // 如果不是自动确认模式，询问是否继续处理下一个文件夹
-            if (!autoConfirm && i < folders.size() - 1) {
-                bool continueProcessing = askForConfirmation("\n是否继续处理下一个文件夹?", true);
-                if (!continueProcessing) {
-                    std::cout << "⏹️  用户中止处理" << std::endl;
-                    break;
-                }
-            }
-        }
-
-        std::cout << "\n" << std::string(50, '=') << std::endl;
-        std::cout << "处理完成!" << std::endl;
-        std::cout << "已处理: " << processedCount << " 个文件夹" << std::endl;
-        if (skippedCount > 0) {
-            std::cout << "已跳过: " << skippedCount << " 个文件夹" << std::endl;
-        }
-        std::cout << std::string(50, '=') << std::endl;
-
-    } else {
-        // 全局模式：在整个目录树中查找重复文件
-        std::cout << "使用全局模式..." << std::endl;
-        
-        // 修改 findDuplicatesInFolder 以支持递归扫描
-        auto result = findDuplicatesInFolderRecursive(directory);
-        
-        if (!result.error.empty()) {
-            std::cerr << "错误: " << result.error << std::endl;
-            return;
-        }
-
-        std::cout << "\n" << std::string(50, '=') << std::endl;
-        std::cout << "全局扫描完成!" << std::endl;
-        std::cout << std::string(50, '=') << std::endl;
-        std::cout << "总文件数: " << result.totalFiles << std::endl;
-        std::cout << "总大小: " << formatFileSize(result.totalSize) << std::endl;
-        std::cout << "发现重复组: " << result.duplicateGroups.size() << " 组" << std::endl;
-        
-        int totalDuplicateFiles = 0;
-        uintmax_t totalSpaceSaved = 0;
-        for (const auto& group : result.duplicateGroups) {
-            totalDuplicateFiles += group.size() - 1;
-            totalSpaceSaved += getFileSize(group[0]) * (group.size() - 1);
-        }
-        
-        std::cout << "重复文件数: " << totalDuplicateFiles << " 个" << std::endl;
-        std::cout << "可节省空间: " << formatFileSize(totalSpaceSaved) << std::endl;
-
-        if (result.duplicateGroups.empty()) {
-            std::cout << "\n🎉 恭喜！没有找到重复文件。" << std::endl;
-            return;
-        }
-
-        // 显示带编号的重复文件列表
-        displayDuplicateGroupsWithNumbers(result.duplicateGroups);
-
-        // 询问是否自定义保留方案
-        bool customizeRetention = askForConfirmation("\n是否要自定义保留哪些文件?", false);
-        std::vector<std::set<size_t>> keepFiles;
-        
-        if (customizeRetention) {
-            keepFiles = letUserModifyRetention(result.duplicateGroups);
-            displayModifiedRetention(result.duplicateGroups, keepFiles);
-        } else {
-            // 使用默认方案（每个组保留第一个文件）
-            for (const auto& group : result.duplicateGroups) {
-                keepFiles.push_back({1});
-            }
-        }
-
-        // 询问是否确认删除
-        bool confirmDelete = askForConfirmation("\n是否确认按此方案删除所有重复文件? (此操作不可恢复)", false);
-        if (!confirmDelete) {
-            std::cout << "❌ 操作已取消。" << std::endl;
-            return;
-        }
-
-        // 执行全局删除
-        performGlobalDeletionWithCustomRetention(result.duplicateGroups, keepFiles, totalSpaceSaved);
-    }
-}
-
-// 添加全局模式的支持方法
-DeduplicationResult findDuplicatesInFolderRecursive(const fs::path& folder) {
-    DeduplicationResult result;
-    
-    if (!fs::exists(folder) || !fs::is_directory(folder)) {
-        result.error = "目录不存在或不是有效目录";
-        return result;
-    }
-
-    std::cout << "正在递归扫描目录: " << folder << std::endl;
-
-    // 第一层：按文件大小分组（递归扫描所有文件）
-    std::map<uintmax_t, std::vector<fs::path>> sizeGroups;
-    
-    try {
-        for (const auto& entry : fs::recursive_directory_iterator(folder)) {
-            if (entry.is_regular_file()) {
-                try {
-                    uintmax_t size = getFileSize(entry.path());
-                    sizeGroups[size].push_back(entry.path());
-                    result.totalFiles++;
-                    result.totalSize += size;
-                    
-                    if (verbose && result.totalFiles % 100 == 0) {
-                        std::cout << "已扫描 " << result.totalFiles << " 个文件..." << std::endl;
-                    }
-                } catch (const std::exception& e) {
-                    std::cerr << "处理文件出错: " << entry.path() << " - " << e.what() << std::endl;
-                }
-            }
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "遍历目录时出错: " << e.what() << std::endl;
-    }
-
-    std::cout << "扫描完成，共找到 " << result.totalFiles << " 个文件" << std::endl;
-
-    // 第二层：抽样比较
-    std::map<std::string, std::vector<fs::path>> signatureGroups;
-    int samplingCount = 0;
-
-    std::cout << "正在分析文件内容..." << std::endl;
-    for (const auto& sizeGroup : sizeGroups) {
-        if (sizeGroup.second.size() > 1) {
-            for (const auto& filepath : sizeGroup.second) {
-                try {
-                    std::string signature = generateFileSignature(filepath);
-                    signatureGroups[signature].push_back(filepath);
-                    samplingCount++;
-                    
-                    if (verbose && samplingCount % 50 == 0) {
-                        std::cout << "已分析 " << samplingCount << " 个文件..." << std::endl;
-                    }
-                } catch (const std::exception& e) {
-                    std::cerr << "生成签名失败: " << filepath << " - " << e.what() << std::endl;
-                }
-            }
-        }
-    }
-
-    // 第三层：逐字节比较
-    std::cout << "正在确认重复文件..." << std::endl;
-    for (const auto& signatureGroup : signatureGroups) {
-        if (signatureGroup.second.size() > 1) {
-            auto duplicateGroups = findExactDuplicates(signatureGroup.second);
-            for (const auto& group : duplicateGroups) {
-                result.duplicateGroups.push_back(group);
-            }
-        }
-    }
-
-    return result;
-}
-
-// 全局删除方法（带自定义保留）
-void performGlobalDeletionWithCustomRetention(const std::vector<std::vector<fs::path>>& duplicateGroups,
-                                             const std::vector<std::set<size_t>>& keepFiles,
-                                             uintmax_t totalSpaceSaved) {
-    std::cout << "\n开始删除重复文件..." << std::endl;
-    
-    int successfullyDeleted = 0;
-    int failedToDelete = 0;
-    uintmax_t actualSpaceSaved = 0;
-
-    for (size_t groupIndex = 0; groupIndex < duplicateGroups.size(); ++groupIndex) {
-        const auto& group = duplicateGroups[groupIndex];
-        const auto& keepSet = keepFiles[groupIndex];
-        
-        for (size_t i = 0; i < group.size(); ++i) {
-            // 如果文件不在保留列表中，则删除
-            if (keepSet.find(i + 1) == keepSet.end()) {
-                uintmax_t fileSize = getFileSize(group[i]);
-                try {
-                    if (!dryRun) {
-                        fs::remove(group[i]);
-                        std::cout << "✓ 已删除: [" << (i + 1) << "] " << group[i].filename() << std::endl;
-                    } else {
-                        std::cout << "✓ [模拟] 将删除: [" << (i + 1) << "] " << group[i].filename() << std::endl;
-                    }
-                    successfullyDeleted++;
-                    actualSpaceSaved += fileSize;
-                } catch (const std::exception& e) {
-                    std::cerr << "✗ 删除失败: [" << (i + 1) << "] " << group[i] << " - " << e.what() << std::endl;
-                    failedToDelete++;
-                }
-            }
-        }
-    }
-
-    std::cout << "\n" << std::string(50, '=') << std::endl;
-    std::cout << "删除操作完成!" << std::endl;
-    std::cout << std::string(50, '=') << std::endl;
-    std::cout << "成功删除: " << successfullyDeleted << " 个文件" << std::endl;
-    
-    if (failedToDelete > 0) {
-        std::cout << "删除失败: " << failedToDelete << " 个文件" << std::endl;
-    }
-    
-    std::cout << "实际节省: " << formatFileSize(actualSpaceSaved) << std::endl;
-    
-    if (dryRun) {
-        std::cout << "注意: 这是模拟运行，没有实际删除文件" << std::endl;
-    }
-}
-
-private:
-
-    // 执行带自定义保留方案的删除
-    void performDeletionWithCustomRetention(const std::vector<std::vector<fs::path>>& duplicateGroups,
-                                           const std::vector<std::set<size_t>>& keepFiles) {
-        std::cout << "\n开始删除重复文件..." << std::endl;
-        
-        int successfullyDeleted = 0;
-        int failedToDelete = 0;
-        uintmax_t actualSpaceSaved = 0;
-
-        for (size_t groupIndex = 0; groupIndex < duplicateGroups.size(); ++groupIndex) {
-            const auto& group = duplicateGroups[groupIndex];
-            const auto& keepSet = keepFiles[groupIndex];
-            
-            for (size_t i = 0; i < group.size(); ++i) {
-                // 如果文件不在保留列表中，则删除
-                if (keepSet.find(i + 1) == keepSet.end()) {
-                    uintmax_t fileSize = getFileSize(group[i]);
-                    try {
-                        if (!dryRun) {
-                            fs::remove(group[i]);
-                            std::cout << "✓ 已删除: [" << (i + 1) << "] " << group[i].filename() << std::endl;
-                        } else {
-                            std::cout << "✓ [模拟] 将删除: [" << (i + 1) << "] " << group[i].filename() << std::endl;
-                        }
-                        successfullyDeleted++;
-                        actualSpaceSaved += fileSize;
-                    } catch (const std::exception& e) {
-                        std::cerr << "✗ 删除失败: [" << (i + 1) << "] " << group[i] << " - " << e.what() << std::endl;
-                        failedToDelete++;
-                    }
-                }
-            }
-        }
-
-        std::cout << "\n" << std::string(50, '=') << std::endl;
-        std::cout << "删除操作完成!" << std::endl;
-        std::cout << std::string(50, '=') << std::endl;
-        std::cout << "成功删除: " << successfullyDeleted << " 个文件" << std::endl;
-        
-        if (failedToDelete > 0) {
-            std::cout << "删除失败: " << failedToDelete << " 个文件" << std::endl;
-        }
-        
-        std::cout << "实际节省: " << formatFileSize(actualSpaceSaved) << std::endl;
-        
-        if (dryRun) {
-            std::cout << "注意: 这是模拟运行，没有实际删除文件" << std::endl;
-        }
-    }
-};
-
-int main(int argc, char* argv[]) {
-    // 全面设置编码
-    SetConsoleOutputCP(65001);
-    SetConsoleCP(65001);
-    
-    std::cout << "程序启动..." << std::endl;
-    
-    // 安全的本地化设置方式
-    try {
-        std::locale::global(std::locale("")); // 使用系统默认本地化
-    } catch (const std::exception& e) {
-        std::cout << "警告: 无法设置本地化，使用C本地化 (" << e.what() << ")" << std::endl;
-        std::locale::global(std::locale("C"));
-    }
-    
-    if (argc < 2) {
-        std::cerr << "错误: 请指定目录路径" << std::endl;
-        std::cerr << "使用 -h 查看帮助信息" << std::endl;
-        return 1;
-    }
-
-    // 显示参数信息
-    std::cout << "接收到 " << argc << " 个参数:" << std::endl;
-    for (int i = 0; i < argc; i++) {
-        std::cout << "  参数[" << i << "]: " << argv[i] << std::endl;
-    }
-
-    bool dryRun = false;
-    bool verbose = false;
-    bool autoConfirm = false;
-    bool skipEmptyFolders = true;
-    size_t samplePoints = 4;
-    size_t sampleSize = 4096;
-    std::string mode = "all";  // 默认全局模式
-    std::string directory;
-
-// 在 main 函数的参数解析部分，修改为：
-
-// 参数解析
-for (int i = 1; i < argc; i++) {
-    std::string arg = argv[i];
-    std::cout << "解析参数: " << arg << std::endl;
-    
-    if (arg == "-h" || arg == "--help") {
-        std::cout << "高级文件去重工具 - 支持子文件夹处理" << std::endl;
-        std::cout << "用法: advanced_dedup [选项] <目录路径>" << std::endl;
-        std::cout << "选项:" << std::endl;
-        std::cout << "  -d, --dry-run         模拟运行，不实际删除" << std::endl;
-        std::cout << "  -v, --verbose         详细输出" << std::endl;
-        std::cout << "  -y, --yes             自动确认所有操作" << std::endl;
-        std::cout << "  -m, --mode MODE       处理模式: all(全局) 或 folder(单文件夹) [默认: all]" << std::endl;
-        std::cout << "  -n, --no-skip         不跳过无重复文件的文件夹" << std::endl;
-        std::cout << "  -p, --points NUM      设置抽样点数 (默认: 4)" << std::endl;
-        std::cout << "  -s, --size SIZE       设置抽样大小 (默认: 4096)" << std::endl;
-        std::cout << std::endl;
-        std::cout << "模式说明:" << std::endl;
-        std::cout << "  all:    在整个目录树中查找重复文件（跨文件夹比较）" << std::endl;
-        std::cout << "  folder: 分别在每个文件夹内查找重复文件（不跨文件夹比较）" << std::endl;
-        return 0;
-    } else if (arg == "-d" || arg == "--dry-run") {
-        dryRun = true;
-        std::cout << "设置: 模拟运行模式" << std::endl;
-    } else if (arg == "-v" || arg == "--verbose") {
-        verbose = true;
-        std::cout << "设置: 详细输出模式" << std::endl;
-    } else if (arg == "-y" || arg == "--yes") {
-        autoConfirm = true;
-        std::cout << "设置: 自动确认模式" << std::endl;
-    } else if (arg == "-m" || arg == "--mode") {
-        if (i + 1 < argc) {
-            mode = argv[++i];
-            if (mode != "all" && mode != "folder") {
-                std::cerr << "错误: 模式必须是 'all' 或 'folder'" << std::endl;
-                return 1;
-            }
-            std::cout << "设置: 模式 = " << mode << std::endl;
-        } else {
-            std::cerr << "错误: -m 参数需要指定模式" << std::endl;
-            return 1;
-        }
-    } else if (arg == "-n" || arg == "--no-skip") {
-        skipEmptyFolders = false;
-        std::cout << "设置: 不跳过无重复文件的文件夹" << std::endl;
-    } else if (arg == "-p" || arg == "--points") {
-        if (i + 1 < argc) {
-            try {
-                samplePoints = std::stoul(argv[++i]);
-                std::cout << "设置: 抽样点数 = " << samplePoints << std::endl;
-            } catch (const std::exception& e) {
-                std::cerr << "错误: 无效的抽样点数 '" << argv[i] << "'" << std::endl;
-                return 1;
-            }
-        } else {
-            std::cerr << "错误: -p 参数需要指定数字" << std::endl;
-            return 1;
-        }
-    } else if (arg == "-s" || arg == "--size") {
-        if (i + 1 < argc) {
-            try {
-                sampleSize = std::stoul(argv[++i]);
-                std::cout << "设置: 抽样大小 = " << sampleSize << std::endl;
-            } catch (const std::exception& e) {
-                std::cerr << "错误: 无效的抽样大小 '" << argv[i] << "'" << std::endl;
-                return 1;
-            }
-        } else {
-            std::cerr << "错误: -s 参数需要指定数字" << std::endl;
-            return 1;
-        }
-    } else if (arg[0] != '-') {
-        // 这是目录路径
-        directory = arg;
-        std::cout << "设置: 目录路径 = " << directory << std::endl;
-    } else {
-        std::cerr << "未知选项: " << arg << std::endl;
-        return 1;
-    }
-}
-
-// 在参数解析完成后，添加路径验证
-if (directory.empty()) {
-    std::cerr << "错误: 未指定目录路径" << std::endl;
-    std::cerr << "请使用: main.exe [选项] <目录路径>" << std::endl;
-    std::cerr << "使用 -h 查看帮助信息" << std::endl;
-    return 1;
-}
-
-// 验证目录是否存在
-std::cout << "验证目录是否存在..." << std::endl;
-if (!fs::exists(directory)) {
-    std::cerr << "错误: 目录不存在: " << directory << std::endl;
-    return 1;
-}
-
-if (!fs::is_directory(directory)) {
-    std::cerr << "错误: 路径不是目录: " << directory << std::endl;
-    return 1;
-}
-
-std::cout << "目录验证通过" << std::endl;
-
-    std::cout << "最终参数:" << std::endl;
-    std::cout << "  目录: " << directory << std::endl;
-    std::cout << "  模式: " << mode << std::endl;
-    std::cout << "  模拟运行: " << (dryRun ? "是" : "否") << std::endl;
-    std::cout << "  详细输出: " << (verbose ? "是" : "否") << std::endl;
-
-    try {
-        InteractiveFileDeduplicator dedup(dryRun, verbose, autoConfirm, skipEmptyFolders, 
-                                      samplePoints, sampleSize, mode);
-        std::cout << "开始执行去重操作..." << std::endl;
-        dedup.deduplicate(directory);
-        std::cout << "去重操作完成" << std::endl;
-    } catch (const std::exception& e) {
-        std::cerr << "程序出错: " << e.what() << std::endl;
-        return 1;
-    }
-
-    std::cout << "程序正常结束" << std::endl;
-    return 0;
-}
\ No newline at end of file
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <sstream>
+#include <iomanip>
+#include <set>
+#include <cstring>
+#include <locale>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <functional>
+#include <condition_variable>
+#include <deque>
+#include <type_traits>
+#include <tuple>
+#include <array>
+#include <cstdint>
+#include <cerrno>
+#include <cstdlib>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <winioctl.h>
+#include <psapi.h>
+#endif
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#if defined(__linux__)
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define AFD_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+#if defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// 128 位内容摘要
+struct Digest128 {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool operator==(const Digest128& other) const {
+        return lo == other.lo && hi == other.hi;
+    }
+
+    bool operator!=(const Digest128& other) const {
+        return !(*this == other);
+    }
+
+    bool operator<(const Digest128& other) const {
+        return hi != other.hi ? hi < other.hi : lo < other.lo;
+    }
+
+    std::string toHex() const {
+        char buffer[33];
+        snprintf(buffer, sizeof(buffer), "%016llx%016llx",
+                 static_cast<unsigned long long>(hi), static_cast<unsigned long long>(lo));
+        return buffer;
+    }
+};
+
+// 哈希引擎：XXH3 风格的条带累加哈希，输出 128 位摘要
+// 每 64 字节条带并行更新 8 条 64 位累加通道，内核在运行时按 CPU 能力选择
+// (AVX2 / NEON / 标量)，各内核结果逐位一致
+namespace hashing {
+
+constexpr size_t kStripeSize = 64;
+constexpr size_t kStripesPerBlock = 16;
+constexpr size_t kSecretSize = 192;
+
+constexpr uint32_t kPrime32_1 = 0x9E3779B1U;
+constexpr uint32_t kPrime32_2 = 0x85EBCA77U;
+constexpr uint32_t kPrime32_3 = 0xC2B2AE3DU;
+constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+alignas(64) static const uint64_t kSecretWords[kSecretSize / 8] = {
+    0x1AC046DDA8E86E2AULL, 0xBE2C3B00B1D348C8ULL, 0x9B1A66A95412FF75ULL,
+    0xC448C2B1F05F7E4CULL, 0xC111CA6B8F6E73C4ULL, 0xB54861920D05B01DULL,
+    0x8D61500F4A7BBE16ULL, 0x5E0C25471F89E02EULL, 0x48105A3D28F0E221ULL,
+    0x2169F8846B637746ULL, 0x3D628782E0C0D863ULL, 0xA5DDB2216078AA40ULL,
+    0xC8119D17F0571101ULL, 0x98E2E2EB8F33280FULL, 0x8CD1E28860679CC4ULL,
+    0x9DCA6189C923AEF3ULL, 0x9D8D3071BA4F04C4ULL, 0x5D395ADA34220C26ULL,
+    0xE6DE42A441A1E28EULL, 0x308FBF68CC864F59ULL, 0x216A3C81332862F9ULL,
+    0xBACECA0A77F3132EULL, 0xDF2A2215339CA69CULL, 0x3E4C11A103A5D859ULL,
+};
+
+inline const unsigned char* secret() {
+    return reinterpret_cast<const unsigned char*>(kSecretWords);
+}
+
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t mul128Fold64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t high;
+    uint64_t low = _umul128(a, b, &high);
+    return low ^ high;
+#else
+    uint64_t aLo = a & 0xFFFFFFFFULL, aHi = a >> 32;
+    uint64_t bLo = b & 0xFFFFFFFFULL, bHi = b >> 32;
+    uint64_t loLo = aLo * bLo, hiLo = aHi * bLo, loHi = aLo * bHi, hiHi = aHi * bHi;
+    uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFFULL) + loHi;
+    uint64_t upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+    uint64_t lower = (cross << 32) | (loLo & 0xFFFFFFFFULL);
+    return lower ^ upper;
+#endif
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+// 条带内核：accumulate 吸收一个 64 字节条带，scramble 在每个块结束时打散累加器
+struct Kernel {
+    const char* name;
+    void (*accumulate)(uint64_t* acc, const unsigned char* stripe, const unsigned char* key);
+    void (*scramble)(uint64_t* acc, const unsigned char* key);
+};
+
+inline void accumulateScalar(uint64_t* acc, const unsigned char* stripe, const unsigned char* key) {
+    for (size_t i = 0; i < 8; ++i) {
+        uint64_t data = read64(stripe + 8 * i);
+        uint64_t dataKey = data ^ read64(key + 8 * i);
+        acc[i ^ 1] += data;
+        acc[i] += (dataKey & 0xFFFFFFFFULL) * (dataKey >> 32);
+    }
+}
+
+inline void scrambleScalar(uint64_t* acc, const unsigned char* key) {
+    for (size_t i = 0; i < 8; ++i) {
+        uint64_t value = acc[i];
+        value ^= value >> 47;
+        value ^= read64(key + 8 * i);
+        value *= kPrime32_1;
+        acc[i] = value;
+    }
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(__GNUC__) || defined(__clang__)
+#define AFD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define AFD_TARGET_AVX2
+#endif
+
+AFD_TARGET_AVX2 inline void accumulateAvx2(uint64_t* acc, const unsigned char* stripe, const unsigned char* key) {
+    __m256i* accVec = reinterpret_cast<__m256i*>(acc);
+    for (size_t i = 0; i < 2; ++i) {
+        __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stripe) + i);
+        __m256i keyVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key) + i);
+        __m256i dataKey = _mm256_xor_si256(data, keyVec);
+        __m256i dataKeyHi = _mm256_srli_epi64(dataKey, 32);
+        __m256i product = _mm256_mul_epu32(dataKey, dataKeyHi);
+        __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        __m256i sum = _mm256_add_epi64(_mm256_loadu_si256(accVec + i), swapped);
+        _mm256_storeu_si256(accVec + i, _mm256_add_epi64(product, sum));
+    }
+}
+
+AFD_TARGET_AVX2 inline void scrambleAvx2(uint64_t* acc, const unsigned char* key) {
+    __m256i* accVec = reinterpret_cast<__m256i*>(acc);
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32_1));
+    for (size_t i = 0; i < 2; ++i) {
+        __m256i value = _mm256_loadu_si256(accVec + i);
+        value = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+        __m256i keyVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key) + i);
+        __m256i dataKey = _mm256_xor_si256(value, keyVec);
+        __m256i dataKeyHi = _mm256_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+        __m256i productLo = _mm256_mul_epu32(dataKey, prime);
+        __m256i productHi = _mm256_mul_epu32(dataKeyHi, prime);
+        _mm256_storeu_si256(accVec + i, _mm256_add_epi64(productLo, _mm256_slli_epi64(productHi, 32)));
+    }
+}
+
+inline bool cpuSupportsAvx2() {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0x6) == 0x6);
+    if (!osSavesYmm) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#endif
+}
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+inline void accumulateNeon(uint64_t* acc, const unsigned char* stripe, const unsigned char* key) {
+    for (size_t i = 0; i < 4; ++i) {
+        uint64x2_t accVec = vld1q_u64(acc + 2 * i);
+        uint64x2_t data = vreinterpretq_u64_u8(vld1q_u8(stripe + 16 * i));
+        uint64x2_t keyVec = vreinterpretq_u64_u8(vld1q_u8(key + 16 * i));
+        uint64x2_t dataKey = veorq_u64(data, keyVec);
+        uint32x2_t dataKeyLo = vmovn_u64(dataKey);
+        uint32x2_t dataKeyHi = vshrn_n_u64(dataKey, 32);
+        accVec = vaddq_u64(accVec, vextq_u64(data, data, 1));
+        vst1q_u64(acc + 2 * i, vmlal_u32(accVec, dataKeyLo, dataKeyHi));
+    }
+}
+
+inline void scrambleNeon(uint64_t* acc, const unsigned char* key) {
+    const uint32x2_t prime = vdup_n_u32(kPrime32_1);
+    for (size_t i = 0; i < 4; ++i) {
+        uint64x2_t value = vld1q_u64(acc + 2 * i);
+        value = veorq_u64(value, vshrq_n_u64(value, 47));
+        value = veorq_u64(value, vreinterpretq_u64_u8(vld1q_u8(key + 16 * i)));
+        uint32x2_t valueLo = vmovn_u64(value);
+        uint32x2_t valueHi = vshrn_n_u64(value, 32);
+        uint64x2_t productHi = vshlq_n_u64(vmull_u32(valueHi, prime), 32);
+        vst1q_u64(acc + 2 * i, vmlal_u32(productHi, valueLo, prime));
+    }
+}
+#endif
+
+inline const Kernel& activeKernel() {
+    static const Kernel kernel = []() -> Kernel {
+#if defined(__x86_64__) || defined(_M_X64)
+        if (cpuSupportsAvx2()) {
+            return {"avx2", accumulateAvx2, scrambleAvx2};
+        }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        return {"neon", accumulateNeon, scrambleNeon};
+#endif
+        return {"scalar", accumulateScalar, scrambleScalar};
+    }();
+    return kernel;
+}
+
+// 流式 128 位哈希：可多次 update，最后 digest
+class Hasher128 {
+private:
+    alignas(32) uint64_t acc[8];
+    unsigned char pending[kStripeSize];
+    size_t pendingLength = 0;
+    size_t stripeInBlock = 0;
+    uint64_t totalLength = 0;
+    const Kernel& kernel;
+
+    void consumeStripe(const unsigned char* stripe) {
+        kernel.accumulate(acc, stripe, secret() + 8 * stripeInBlock);
+        if (++stripeInBlock == kStripesPerBlock) {
+            kernel.scramble(acc, secret() + kSecretSize - kStripeSize);
+            stripeInBlock = 0;
+        }
+    }
+
+    uint64_t mergeAccumulators(const unsigned char* key, uint64_t start) const {
+        uint64_t result = start;
+        for (size_t i = 0; i < 4; ++i) {
+            result += mul128Fold64(acc[2 * i] ^ read64(key + 16 * i),
+                                   acc[2 * i + 1] ^ read64(key + 16 * i + 8));
+        }
+        return avalanche(result);
+    }
+
+public:
+    Hasher128() : acc{kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3,
+                      kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1},
+                  kernel(activeKernel()) {}
+
+    void update(const void* data, size_t length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        totalLength += length;
+
+        if (pendingLength > 0) {
+            size_t fill = std::min(length, kStripeSize - pendingLength);
+            std::memcpy(pending + pendingLength, bytes, fill);
+            pendingLength += fill;
+            bytes += fill;
+            length -= fill;
+            if (pendingLength < kStripeSize) {
+                return;
+            }
+            consumeStripe(pending);
+            pendingLength = 0;
+        }
+
+        while (length >= kStripeSize) {
+            consumeStripe(bytes);
+            bytes += kStripeSize;
+            length -= kStripeSize;
+        }
+
+        if (length > 0) {
+            std::memcpy(pending, bytes, length);
+            pendingLength = length;
+        }
+    }
+
+    Digest128 digest() const {
+        Hasher128 tail(*this);
+        if (tail.pendingLength > 0) {
+            std::memset(tail.pending + tail.pendingLength, 0, kStripeSize - tail.pendingLength);
+            tail.kernel.accumulate(tail.acc, tail.pending, secret() + kSecretSize - kStripeSize - 7);
+        }
+
+        Digest128 result;
+        result.lo = tail.mergeAccumulators(secret() + 11, totalLength * kPrime64_1);
+        result.hi = tail.mergeAccumulators(secret() + kSecretSize - kStripeSize - 11,
+                                           ~(totalLength * kPrime64_2));
+        return result;
+    }
+};
+
+inline Digest128 hash128(const void* data, size_t length) {
+    Hasher128 hasher;
+    hasher.update(data, length);
+    return hasher.digest();
+}
+
+} // namespace hashing
+
+// 内容定义分块 (FastCDC)：用 gear 滚动哈希在内容上找切点，插入或追加数据只影响附近的分块，
+// 截断或追加过的副本与原文件仍有大量相同分块。采用归一化分块：未到平均长度前用更严的掩码，
+// 之后用更松的掩码，分块长度集中在平均值附近；最小长度以内不计算滚动哈希直接跳过。
+// 分块指纹取 Hasher128 摘要的低 64 位，与全文哈希在同一次读取中流式计算
+class ContentChunker {
+public:
+    struct Chunk {
+        uint64_t hash;
+        uint32_t length;
+    };
+
+private:
+    size_t minSize;
+    size_t averageSize;
+    size_t maxSize;
+    uint64_t strictMask;  // 滚动哈希的高位参与判断，低位只受最近几个字节影响
+    uint64_t looseMask;
+    uint64_t fingerprint = 0;
+    size_t chunkLength = 0;
+    std::optional<hashing::Hasher128> chunkHasher;
+    std::vector<Chunk>& chunks;
+
+    static const std::array<uint64_t, 256>& gearTable() {
+        static const std::array<uint64_t, 256> table = [] {
+            std::array<uint64_t, 256> values{};
+            uint64_t state = 0x243F6A8885A308D3ULL;
+            for (auto& value : values) {
+                state += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = state;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                value = z ^ (z >> 31);
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    static uint64_t highBits(size_t count) {
+        return count == 0 ? 0 : ~0ULL << (64 - count);
+    }
+
+    void emit() {
+        chunks.push_back({chunkHasher->digest().lo, static_cast<uint32_t>(chunkLength)});
+        chunkHasher.emplace();
+        chunkLength = 0;
+        fingerprint = 0;
+    }
+
+    // 从 position 起到 end 为止用 mask 找切点；找到时 position 指向切点之后并返回 true
+    bool findCut(const unsigned char* data, size_t& position, size_t end, uint64_t mask) {
+        const std::array<uint64_t, 256>& gear = gearTable();
+        uint64_t hash = fingerprint;
+        size_t i = position;
+        bool found = false;
+        while (i < end) {
+            hash = (hash << 1) + gear[data[i++]];
+            if ((hash & mask) == 0) {
+                found = true;
+                break;
+            }
+        }
+        fingerprint = hash;
+        position = i;
+        return found;
+    }
+
+public:
+    // averageSize 必须是 2 的幂；最小长度为平均值的 1/4，最大长度为 8 倍
+    ContentChunker(size_t average, std::vector<Chunk>& output)
+        : minSize(average / 4), averageSize(average), maxSize(average * 8), chunks(output) {
+        size_t bits = 0;
+        while ((size_t(1) << bits) < average) {
+            ++bits;
+        }
+        strictMask = highBits(bits + 1);
+        looseMask = highBits(bits - 1);
+        chunkHasher.emplace();
+    }
+
+    void update(const unsigned char* data, size_t length) {
+        while (length > 0) {
+            // 分块内依次经过 跳过区 (< minSize)、严格区 (< averageSize)、宽松区 (< maxSize)，到 maxSize 强制切分
+            size_t consumed = chunkLength < minSize ? std::min(length, minSize - chunkLength) : 0;
+            bool cut = false;
+            if (consumed < length && chunkLength + consumed < averageSize) {
+                cut = findCut(data, consumed, std::min(length, averageSize - chunkLength), strictMask);
+            }
+            if (!cut && consumed < length && chunkLength + consumed >= averageSize) {
+                cut = findCut(data, consumed, std::min(length, maxSize - chunkLength), looseMask) ||
+                      chunkLength + consumed == maxSize;
+            }
+            chunkHasher->update(data, consumed);
+            chunkLength += consumed;
+            data += consumed;
+            length -= consumed;
+            if (cut) {
+                emit();
+            }
+        }
+    }
+
+    // 文件结束：剩余数据作为最后一个分块
+    void finish() {
+        if (chunkLength > 0) {
+            emit();
+        }
+    }
+};
+
+// 抽样签名：定长 POD 键，文件大小 + 全部抽样块摘要折叠成的 128 位值
+// 可直接 memcmp/排序，不需要任何堆分配
+struct FileSignature {
+    static constexpr uint32_t kSmall = 1;       // 文件太小或已无后续轮次，未抽样
+    static constexpr uint32_t kRoundShift = 8;  // flags 高位保存抽样轮次
+
+    uint64_t size = 0;
+    uint32_t flags = 0;
+    uint32_t sampleCount = 0;
+    Digest128 samples;
+
+    bool operator==(const FileSignature& other) const {
+        return size == other.size && flags == other.flags &&
+               sampleCount == other.sampleCount && samples == other.samples;
+    }
+
+    bool operator<(const FileSignature& other) const {
+        if (size != other.size) return size < other.size;
+        if (flags != other.flags) return flags < other.flags;
+        if (sampleCount != other.sampleCount) return sampleCount < other.sampleCount;
+        return samples < other.samples;
+    }
+
+    uint32_t round() const {
+        return flags >> kRoundShift;
+    }
+};
+
+// 签名分组记录：签名 + 文件在候选列表中的下标
+struct SignatureEntry {
+    FileSignature signature;
+    uint32_t index;
+
+    bool operator<(const SignatureEntry& other) const {
+        if (!(signature == other.signature)) return signature < other.signature;
+        return index < other.index;
+    }
+};
+
+// 大小分组记录：文件大小 + 文件表下标
+struct SizeEntry {
+    uint64_t size;
+    uint32_t index;
+
+    bool operator<(const SizeEntry& other) const {
+        if (size != other.size) return size < other.size;
+        return index < other.index;
+    }
+};
+
+// 文件读取后端
+enum class IoBackend {
+    Stream,  // std::ifstream
+    Mmap,    // 内存映射 (CreateFileMapping / mmap)
+    Direct,  // 绕过系统缓存的大块对齐读取 (FILE_FLAG_NO_BUFFERING / O_DIRECT)
+    Async    // 抽样和同步比较使用异步引擎 (IOCP / io_uring)，其余读取同 Stream
+};
+
+// 访问模式提示，传给系统预读策略
+enum class AccessPattern {
+    Random,
+    Sequential
+};
+
+inline const char* ioBackendName(IoBackend backend) {
+    switch (backend) {
+        case IoBackend::Mmap: return "mmap";
+        case IoBackend::Direct: return "direct";
+        case IoBackend::Async: return "async";
+        default: return "stream";
+    }
+}
+
+inline bool parseIoBackend(const std::string& name, IoBackend& backend) {
+    if (name == "stream") backend = IoBackend::Stream;
+    else if (name == "mmap") backend = IoBackend::Mmap;
+    else if (name == "direct") backend = IoBackend::Direct;
+    else if (name == "async") backend = IoBackend::Async;
+    else return false;
+    return true;
+}
+
+// 运行阶段，--stats 按阶段汇总
+enum class Phase {
+    Enumeration,   // 目录枚举
+    Sampling,      // 渐进抽样
+    Verification,  // 精确比较
+    Deletion,      // 删除 / 替换
+    None           // 不属于任何阶段，不统计
+};
+
+constexpr size_t kPhaseCount = static_cast<size_t>(Phase::None);
+
+inline const char* phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::Enumeration: return "enumeration";
+        case Phase::Sampling: return "sampling";
+        case Phase::Verification: return "verification";
+        case Phase::Deletion: return "deletion";
+        default: return "none";
+    }
+}
+
+// 进程的峰值内存占用 (字节)，无法获取时返回 0
+inline uint64_t processPeakMemory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return static_cast<uint64_t>(counters.PeakWorkingSetSize);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// 分阶段计数：每个线程记着当前所处的阶段，读取路径上的打开 / 定位 / 读取调用和缓存命中计入该阶段；
+// 计数始终进行 (每次调用一个原子加)，--stats 只决定是否输出
+class PhaseProfiler {
+public:
+    struct Counters {
+        std::atomic<int64_t> wallNs{0};
+        std::atomic<uint64_t> filesIn{0};
+        std::atomic<uint64_t> filesOut{0};
+        std::atomic<uint64_t> bytesRead{0};
+        std::atomic<uint64_t> opens{0};
+        std::atomic<uint64_t> seeks{0};
+        std::atomic<uint64_t> reads{0};
+        std::atomic<uint64_t> cacheHits{0};
+        std::atomic<uint64_t> peakMemory{0};  // 阶段结束时观察到的进程峰值内存
+    };
+
+    static Phase& currentPhase() {
+        thread_local Phase phase = Phase::None;
+        return phase;
+    }
+
+    static Counters& counters(Phase phase) {
+        static Counters table[kPhaseCount + 1];
+        return table[static_cast<size_t>(phase)];
+    }
+
+    static void countOpen() {
+        counters(currentPhase()).opens.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void countSeek() {
+        counters(currentPhase()).seeks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void countRead(uint64_t bytes) {
+        Counters& c = counters(currentPhase());
+        c.reads.fetch_add(1, std::memory_order_relaxed);
+        c.bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    static void countCacheHit() {
+        counters(currentPhase()).cacheHits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void countFiles(Phase phase, uint64_t in, uint64_t out) {
+        Counters& c = counters(phase);
+        c.filesIn.fetch_add(in, std::memory_order_relaxed);
+        c.filesOut.fetch_add(out, std::memory_order_relaxed);
+    }
+};
+
+// 作用域内本线程的读取计入 phase，退出时恢复之前的阶段
+class PhaseScope {
+private:
+    Phase saved;
+
+public:
+    explicit PhaseScope(Phase phase) : saved(PhaseProfiler::currentPhase()) {
+        PhaseProfiler::currentPhase() = phase;
+    }
+
+    ~PhaseScope() {
+        PhaseProfiler::currentPhase() = saved;
+    }
+
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+};
+
+// 在 PhaseScope 的基础上把作用域的墙钟时间计入该阶段，并记下结束时的峰值内存
+// 并行的多个计时 (如各文件夹并行检测) 时间相加，可能超过实际经过的时间
+class PhaseTimer {
+private:
+    Phase phase;
+    PhaseScope scope;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit PhaseTimer(Phase phase) : phase(phase), scope(phase), start(std::chrono::steady_clock::now()) {}
+
+    ~PhaseTimer() {
+        PhaseProfiler::Counters& c = PhaseProfiler::counters(phase);
+        c.wallNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        uint64_t peak = processPeakMemory();
+        uint64_t seen = c.peakMemory.load(std::memory_order_relaxed);
+        while (peak > seen && !c.peakMemory.compare_exchange_weak(seen, peak, std::memory_order_relaxed)) {
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+};
+
+// 实时进度计数，供 --progress 的状态行和 --metrics-file / --metrics-port 的指标使用：
+// 完成的文件数记在每个线程独占的槽位上 (各占一条缓存行，加计数不争用)，由报告线程汇总；
+// 预计总量和队列深度是各阶段共享的原子量。读取字节数直接取 PhaseProfiler 的分阶段计数
+class ProgressCounters {
+public:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> files[kPhaseCount] = {};
+    };
+
+    struct Snapshot {
+        uint64_t files[kPhaseCount] = {};
+        uint64_t expectedFiles[kPhaseCount] = {};
+        uint64_t expectedBytes[kPhaseCount] = {};
+        uint64_t bytesRead[kPhaseCount] = {};
+        uint64_t queueDepth[kPhaseCount] = {};
+    };
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::deque<Slot> slots;     // deque 扩展时已有槽位的地址不变
+        std::vector<Slot*> idle;    // 已退出线程留下的槽位，计数保留，由新线程接着累加
+        std::atomic<uint64_t> expectedFiles[kPhaseCount] = {};
+        std::atomic<uint64_t> expectedBytes[kPhaseCount] = {};
+        std::atomic<uint64_t> queueDepth[kPhaseCount] = {};
+    };
+
+    static Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    // 线程第一次计数时领取槽位，退出时归还；槽位数等于同时存在过的最多线程数
+    class SlotLease {
+    public:
+        Slot* slot;
+
+        SlotLease() {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            if (r.idle.empty()) {
+                slot = &r.slots.emplace_back();
+            } else {
+                slot = r.idle.back();
+                r.idle.pop_back();
+            }
+        }
+
+        ~SlotLease() {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.idle.push_back(slot);
+        }
+    };
+
+    static Slot& localSlot() {
+        thread_local SlotLease lease;
+        return *lease.slot;
+    }
+
+public:
+    static void advance(Phase phase, uint64_t files) {
+        localSlot().files[static_cast<size_t>(phase)].fetch_add(files, std::memory_order_relaxed);
+    }
+
+    // 阶段新增的预计工作量，用来估算剩余时间；枚举阶段没有预计总量
+    static void expect(Phase phase, uint64_t files, uint64_t bytes) {
+        Registry& r = registry();
+        r.expectedFiles[static_cast<size_t>(phase)].fetch_add(files, std::memory_order_relaxed);
+        r.expectedBytes[static_cast<size_t>(phase)].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    static void setQueueDepth(Phase phase, uint64_t depth) {
+        registry().queueDepth[static_cast<size_t>(phase)].store(depth, std::memory_order_relaxed);
+    }
+
+    static Snapshot snapshot() {
+        Registry& r = registry();
+        Snapshot result;
+        {
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (const Slot& slot : r.slots) {
+                for (size_t i = 0; i < kPhaseCount; ++i) {
+                    result.files[i] += slot.files[i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        for (size_t i = 0; i < kPhaseCount; ++i) {
+            result.expectedFiles[i] = r.expectedFiles[i].load(std::memory_order_relaxed);
+            result.expectedBytes[i] = r.expectedBytes[i].load(std::memory_order_relaxed);
+            result.queueDepth[i] = r.queueDepth[i].load(std::memory_order_relaxed);
+            result.bytesRead[i] = PhaseProfiler::counters(static_cast<Phase>(i)).bytesRead.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+};
+
+// 标准错误上的刷新状态行：行首回车重画，画完光标回到行首，之后的普通输出从行首覆盖它；
+// 等待用户输入期间 (StatusLinePause) 擦掉状态行且不再重画
+class StatusLine {
+private:
+    struct State {
+        std::mutex mutex;
+        bool shown = false;
+        int pauses = 0;
+    };
+
+    static State& state() {
+        static State instance;
+        return instance;
+    }
+
+    static void erase(State& s) {
+        if (s.shown) {
+            std::cerr << "\r\033[K" << std::flush;
+            s.shown = false;
+        }
+    }
+
+public:
+    static void show(const std::string& text) {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.pauses == 0) {
+            std::cerr << '\r' << text << "\033[K\r" << std::flush;
+            s.shown = true;
+        }
+    }
+
+    // 不刷新的输出 (标准错误不是终端时) 每次输出一整行
+    static void print(const std::string& text) {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.pauses == 0) {
+            std::cerr << text << std::endl;
+        }
+    }
+
+    static void clear() {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        erase(s);
+    }
+
+    static void pause() {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        erase(s);
+        ++s.pauses;
+    }
+
+    static void resume() {
+        State& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        --s.pauses;
+    }
+};
+
+class StatusLinePause {
+public:
+    StatusLinePause() {
+        StatusLine::pause();
+    }
+
+    ~StatusLinePause() {
+        StatusLine::resume();
+    }
+
+    StatusLinePause(const StatusLinePause&) = delete;
+    StatusLinePause& operator=(const StatusLinePause&) = delete;
+};
+
+// 文件读取接口：按偏移随机读取，所有后端均以字节偏移寻址
+class FileReader {
+public:
+    virtual ~FileReader() = default;
+
+    virtual uintmax_t size() const = 0;
+
+    // 从 offset 起读取最多 length 字节，返回实际读取的字节数
+    virtual size_t readAt(uintmax_t offset, void* buffer, size_t length) = 0;
+
+    // 零拷贝视图，仅内存映射后端支持，其余返回 nullptr
+    virtual const unsigned char* view(uintmax_t offset, size_t length) {
+        (void)offset;
+        (void)length;
+        return nullptr;
+    }
+
+    // 取得 [offset, offset + length) 的数据：能映射就直接返回映射地址，否则读入 scratch
+    const unsigned char* fetch(uintmax_t offset, size_t length, std::vector<unsigned char>& scratch) {
+        if (const unsigned char* mapped = view(offset, length)) {
+            return mapped;
+        }
+        if (scratch.size() < length) {
+            scratch.resize(length);
+        }
+        if (readAt(offset, scratch.data(), length) != length) {
+            throw std::runtime_error("读取文件失败");
+        }
+        return scratch.data();
+    }
+};
+
+class StreamFileReader : public FileReader {
+private:
+    std::ifstream file;
+    uintmax_t fileSize;
+
+public:
+    explicit StreamFileReader(const fs::path& filepath) : file(filepath, std::ios::binary) {
+        if (!file) {
+            throw std::runtime_error("无法打开文件: " + filepath.string());
+        }
+        PhaseProfiler::countOpen();
+        fileSize = fs::file_size(filepath);
+    }
+
+    uintmax_t size() const override {
+        return fileSize;
+    }
+
+    size_t readAt(uintmax_t offset, void* buffer, size_t length) override {
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(static_cast<char*>(buffer), static_cast<std::streamsize>(length));
+        PhaseProfiler::countSeek();
+        PhaseProfiler::countRead(static_cast<uint64_t>(file.gcount()));
+        return static_cast<size_t>(file.gcount());
+    }
+};
+
+#ifdef _WIN32
+inline HANDLE openReadHandle(const fs::path& filepath, DWORD flags) {
+    HANDLE handle = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, flags, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("无法打开文件: " + filepath.string());
+    }
+    PhaseProfiler::countOpen();
+    return handle;
+}
+
+inline uintmax_t handleFileSize(HANDLE handle) {
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        return 0;
+    }
+    return static_cast<uintmax_t>(size.QuadPart);
+}
+
+inline size_t readHandleAt(HANDLE handle, uintmax_t offset, void* buffer, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        OVERLAPPED overlapped = {};
+        uintmax_t position = offset + total;
+        overlapped.Offset = static_cast<DWORD>(position & 0xFFFFFFFFULL);
+        overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(length - total, 1u << 30));
+        DWORD got = 0;
+        BOOL ok = ReadFile(handle, static_cast<char*>(buffer) + total, chunk, &got, &overlapped);
+        PhaseProfiler::countRead(ok ? got : 0);
+        if (!ok || got == 0) {
+            break;
+        }
+        total += got;
+    }
+    return total;
+}
+#else
+inline int openReadDescriptor(const fs::path& filepath, int extraFlags) {
+    int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC | extraFlags);
+    if (fd < 0) {
+        throw std::runtime_error("无法打开文件: " + filepath.string());
+    }
+    PhaseProfiler::countOpen();
+    return fd;
+}
+
+inline uintmax_t descriptorFileSize(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return 0;
+    }
+    return static_cast<uintmax_t>(st.st_size);
+}
+
+inline size_t readDescriptorAt(int fd, uintmax_t offset, void* buffer, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t got = ::pread(fd, static_cast<char*>(buffer) + total, length - total,
+                              static_cast<off_t>(offset + total));
+        PhaseProfiler::countRead(got > 0 ? static_cast<uint64_t>(got) : 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        total += static_cast<size_t>(got);
+    }
+    return total;
+}
+#endif
+
+// 整读小文件：打开、读入调用方的缓冲区、关闭，返回读到的字节数 (最多 expected + 1)。
+// 多请求 1 字节以发现枚举之后变大的文件；普通文件的单次读取只在文件末尾才会少读，
+// 读到 expected 字节即已到末尾，不必再读一次确认
+inline size_t readWholeFile(const fs::path& filepath, void* buffer, size_t expected) {
+#ifdef _WIN32
+    HANDLE handle = openReadHandle(filepath, FILE_FLAG_SEQUENTIAL_SCAN);
+    DWORD first = 0;
+    if (!ReadFile(handle, buffer, static_cast<DWORD>(expected + 1), &first, nullptr)) {
+        first = 0;
+    }
+    PhaseProfiler::countRead(first);
+    size_t got = first;
+    if (got < expected) {
+        got += readHandleAt(handle, got, static_cast<char*>(buffer) + got, expected + 1 - got);
+    }
+    CloseHandle(handle);
+#else
+    int fd = openReadDescriptor(filepath, 0);
+    ssize_t first = ::pread(fd, buffer, expected + 1, 0);
+    PhaseProfiler::countRead(first > 0 ? static_cast<uint64_t>(first) : 0);
+    size_t got = first > 0 ? static_cast<size_t>(first) : 0;
+    if (got < expected) {
+        got += readDescriptorAt(fd, got, static_cast<char*>(buffer) + got, expected + 1 - got);
+    }
+    ::close(fd);
+#endif
+    return got;
+}
+
+// 内存映射后端：整个文件映射为只读视图，读取即内存访问
+class MappedFileReader : public FileReader {
+private:
+    const unsigned char* data = nullptr;
+    uintmax_t fileSize = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+
+public:
+    MappedFileReader(const fs::path& filepath, AccessPattern pattern) {
+#ifdef _WIN32
+        DWORD flags = pattern == AccessPattern::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+        fileHandle = openReadHandle(filepath, flags);
+        fileSize = handleFileSize(fileHandle);
+        if (fileSize == 0) {
+            return;
+        }
+        mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle) {
+            data = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (!data) {
+            close();
+            throw std::runtime_error("无法映射文件: " + filepath.string());
+        }
+#else
+        fd = openReadDescriptor(filepath, 0);
+        fileSize = descriptorFileSize(fd);
+        if (fileSize == 0) {
+            return;
+        }
+        void* mapped = ::mmap(nullptr, static_cast<size_t>(fileSize), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close();
+            throw std::runtime_error("无法映射文件: " + filepath.string());
+        }
+        ::madvise(mapped, static_cast<size_t>(fileSize),
+                  pattern == AccessPattern::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        data = static_cast<const unsigned char*>(mapped);
+#endif
+    }
+
+    ~MappedFileReader() override {
+        close();
+    }
+
+    MappedFileReader(const MappedFileReader&) = delete;
+    MappedFileReader& operator=(const MappedFileReader&) = delete;
+
+    uintmax_t size() const override {
+        return fileSize;
+    }
+
+    size_t readAt(uintmax_t offset, void* buffer, size_t length) override {
+        if (offset >= fileSize) {
+            return 0;
+        }
+        size_t available = static_cast<size_t>(std::min<uintmax_t>(length, fileSize - offset));
+        std::memcpy(buffer, data + offset, available);
+        return available;
+    }
+
+    const unsigned char* view(uintmax_t offset, size_t length) override {
+        if (offset + length > fileSize || (!data && length > 0)) {
+            return nullptr;
+        }
+        return data ? data + offset : reinterpret_cast<const unsigned char*>("");
+    }
+
+private:
+    void close() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mappingHandle) CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+        mappingHandle = nullptr;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (data) ::munmap(const_cast<unsigned char*>(data), static_cast<size_t>(fileSize));
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        data = nullptr;
+    }
+};
+
+// 无缓冲后端：以对齐的大块从设备直接读取，不污染系统缓存
+// 请求的偏移和长度不必对齐，由内部对齐缓冲区转换；最近读取的块会被复用
+class DirectFileReader : public FileReader {
+private:
+    static constexpr size_t kAlignment = 4096;
+    static constexpr size_t kBlockSize = 1024 * 1024;
+
+    unsigned char* block = nullptr;
+    uintmax_t blockOffset = 0;
+    size_t blockLength = 0;
+    uintmax_t fileSize = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+    bool dropCache = false;  // 未能以 O_DIRECT 打开，每次读取后让内核丢弃这段缓存
+#endif
+
+    size_t readAligned(uintmax_t alignedOffset) {
+#ifdef _WIN32
+        return readHandleAt(fileHandle, alignedOffset, block, kBlockSize);
+#else
+        size_t length = readDescriptorAt(fd, alignedOffset, block, kBlockSize);
+#if defined(POSIX_FADV_DONTNEED)
+        if (dropCache && length > 0) {
+            ::posix_fadvise(fd, static_cast<off_t>(alignedOffset), static_cast<off_t>(length), POSIX_FADV_DONTNEED);
+        }
+#endif
+        return length;
+#endif
+    }
+
+public:
+    DirectFileReader(const fs::path& filepath, AccessPattern pattern) {
+#ifdef _WIN32
+        DWORD flags = FILE_FLAG_NO_BUFFERING |
+                      (pattern == AccessPattern::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS);
+        fileHandle = openReadHandle(filepath, flags);
+        fileSize = handleFileSize(fileHandle);
+        block = static_cast<unsigned char*>(_aligned_malloc(kBlockSize, kAlignment));
+#else
+#if defined(O_DIRECT)
+        try {
+            fd = openReadDescriptor(filepath, O_DIRECT);
+        } catch (const std::exception&) {
+            // 部分文件系统 (tmpfs 等) 不支持 O_DIRECT，退回普通读取，读过的块随即从缓存中丢弃
+            fd = openReadDescriptor(filepath, 0);
+            dropCache = true;
+        }
+#else
+        fd = openReadDescriptor(filepath, 0);
+#if defined(F_NOCACHE)
+        ::fcntl(fd, F_NOCACHE, 1);
+#endif
+#endif
+        fileSize = descriptorFileSize(fd);
+#if defined(POSIX_FADV_SEQUENTIAL)
+        ::posix_fadvise(fd, 0, 0, pattern == AccessPattern::Sequential ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+#else
+        (void)pattern;
+#endif
+        void* memory = nullptr;
+        if (posix_memalign(&memory, kAlignment, kBlockSize) == 0) {
+            block = static_cast<unsigned char*>(memory);
+        }
+#endif
+        if (!block) {
+            close();
+            throw std::bad_alloc();
+        }
+    }
+
+    ~DirectFileReader() override {
+        close();
+    }
+
+    DirectFileReader(const DirectFileReader&) = delete;
+    DirectFileReader& operator=(const DirectFileReader&) = delete;
+
+    uintmax_t size() const override {
+        return fileSize;
+    }
+
+    size_t readAt(uintmax_t offset, void* buffer, size_t length) override {
+        size_t total = 0;
+        unsigned char* out = static_cast<unsigned char*>(buffer);
+
+        while (total < length && offset + total < fileSize) {
+            uintmax_t position = offset + total;
+            if (blockLength == 0 || position < blockOffset || position >= blockOffset + blockLength) {
+                blockOffset = position & ~static_cast<uintmax_t>(kAlignment - 1);
+                blockLength = readAligned(blockOffset);
+                if (blockLength <= position - blockOffset) {
+                    blockLength = 0;
+                    break;
+                }
+            }
+
+            size_t inBlock = static_cast<size_t>(position - blockOffset);
+            size_t chunk = std::min(length - total, blockLength - inBlock);
+            std::memcpy(out + total, block + inBlock, chunk);
+            total += chunk;
+        }
+
+        return total;
+    }
+
+private:
+    void close() {
+#ifdef _WIN32
+        if (block) _aligned_free(block);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        free(block);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        block = nullptr;
+    }
+};
+
+inline std::unique_ptr<FileReader> openFileReader(const fs::path& filepath, IoBackend backend,
+                                                  AccessPattern pattern = AccessPattern::Random) {
+    switch (backend) {
+        case IoBackend::Mmap:
+            return std::make_unique<MappedFileReader>(filepath, pattern);
+        case IoBackend::Direct:
+            return std::make_unique<DirectFileReader>(filepath, pattern);
+        default:
+            return std::make_unique<StreamFileReader>(filepath);
+    }
+}
+
+#ifdef _WIN32
+// 文件所在卷的簇大小，查询失败时返回 0
+inline uint64_t volumeClusterSize(const fs::path& filepath) {
+    wchar_t mountPoint[MAX_PATH + 1];
+    DWORD sectorsPerCluster = 0, bytesPerSector = 0, freeClusters = 0, totalClusters = 0;
+    if (!GetVolumePathNameW(filepath.c_str(), mountPoint, MAX_PATH) ||
+        !GetDiskFreeSpaceW(mountPoint, &sectorsPerCluster, &bytesPerSector, &freeClusters, &totalClusters)) {
+        return 0;
+    }
+    return static_cast<uint64_t>(sectorsPerCluster) * bytesPerSector;
+}
+#endif
+
+// 查询文件中各块所在的物理偏移 (设备上的字节位置)，用于按磁盘顺序调度读取
+// Windows 用 FSCTL_GET_RETRIEVAL_POINTERS，Linux 用 FIEMAP，macOS 用 F_LOG2PHYS_EXT；
+// 文件系统不支持或任何一块查询失败时返回空
+inline std::vector<uint64_t> queryPhysicalOffsets(const fs::path& filepath,
+                                                  const std::vector<std::pair<uintmax_t, size_t>>& blocks) {
+    std::vector<uint64_t> physical;
+#ifdef _WIN32
+    uint64_t clusterSize = volumeClusterSize(filepath);
+    if (clusterSize == 0) {
+        return physical;
+    }
+
+    HANDLE handle = CreateFileW(filepath.c_str(), FILE_READ_ATTRIBUTES,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, 0, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return physical;
+    }
+    for (const auto& block : blocks) {
+        STARTING_VCN_INPUT_BUFFER input;
+        input.StartingVcn.QuadPart = static_cast<LONGLONG>(block.first / clusterSize);
+        RETRIEVAL_POINTERS_BUFFER output;
+        DWORD bytes = 0;
+        BOOL ok = DeviceIoControl(handle, FSCTL_GET_RETRIEVAL_POINTERS, &input, sizeof(input),
+                                  &output, sizeof(output), &bytes, nullptr);
+        // 只取一个区段，ERROR_MORE_DATA 表示后面还有区段
+        if ((!ok && GetLastError() != ERROR_MORE_DATA) || output.ExtentCount == 0 ||
+            output.Extents[0].Lcn.QuadPart < 0) {
+            physical.clear();
+            break;
+        }
+        uint64_t vcnDelta = static_cast<uint64_t>(input.StartingVcn.QuadPart - output.StartingVcn.QuadPart);
+        physical.push_back((static_cast<uint64_t>(output.Extents[0].Lcn.QuadPart) + vcnDelta) * clusterSize +
+                           block.first % clusterSize);
+    }
+    CloseHandle(handle);
+#elif defined(__linux__)
+    int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return physical;
+    }
+    alignas(struct fiemap) unsigned char request[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    for (const auto& block : blocks) {
+        std::memset(request, 0, sizeof(request));
+        auto* map = reinterpret_cast<struct fiemap*>(request);
+        map->fm_start = block.first;
+        map->fm_length = block.second;
+        map->fm_extent_count = 1;
+        if (ioctl(fd, FS_IOC_FIEMAP, map) != 0 || map->fm_mapped_extents == 0 ||
+            (map->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN)) {
+            physical.clear();
+            break;
+        }
+        const struct fiemap_extent& extent = map->fm_extents[0];
+        physical.push_back(block.first >= extent.fe_logical ? extent.fe_physical + (block.first - extent.fe_logical)
+                                                            : extent.fe_physical);
+    }
+    ::close(fd);
+#elif defined(__APPLE__)
+    int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return physical;
+    }
+    for (const auto& block : blocks) {
+        struct log2phys mapping = {};
+        mapping.l2p_contigbytes = static_cast<off_t>(block.second);
+        mapping.l2p_devoffset = static_cast<off_t>(block.first);
+        if (fcntl(fd, F_LOG2PHYS_EXT, &mapping) == -1) {
+            physical.clear();
+            break;
+        }
+        physical.push_back(static_cast<uint64_t>(mapping.l2p_devoffset));
+    }
+    ::close(fd);
+#else
+    (void)filepath;
+    (void)blocks;
+#endif
+    return physical;
+}
+
+// 供异步引擎使用的只读文件句柄 (Windows 以 FILE_FLAG_OVERLAPPED 打开)
+class AsyncFile {
+public:
+#ifdef _WIN32
+    using NativeHandle = HANDLE;
+#else
+    using NativeHandle = int;
+#endif
+
+    explicit AsyncFile(const fs::path& filepath) {
+#ifdef _WIN32
+        handle = openReadHandle(filepath, FILE_FLAG_OVERLAPPED);
+#else
+        handle = openReadDescriptor(filepath, 0);
+#endif
+    }
+
+    ~AsyncFile() {
+#ifdef _WIN32
+        CloseHandle(handle);
+#else
+        ::close(handle);
+#endif
+    }
+
+    AsyncFile(const AsyncFile&) = delete;
+    AsyncFile& operator=(const AsyncFile&) = delete;
+
+    NativeHandle native() const {
+        return handle;
+    }
+
+private:
+    NativeHandle handle;
+};
+
+// 异步读取引擎：同时保持最多 depth() 个读取在途，完成后按提交时的标签取回
+// 短读由引擎自动续读，调用方只会看到整块成功或失败
+class AsyncReadEngine {
+public:
+    struct Completion {
+        size_t tag;
+        bool ok;
+    };
+
+    explicit AsyncReadEngine(size_t depth) : slots(depth == 0 ? 1 : depth) {
+        for (size_t i = slots.size(); i > 0; --i) {
+            freeSlots.push_back(i - 1);
+        }
+    }
+
+    virtual ~AsyncReadEngine() = default;
+
+    AsyncReadEngine(const AsyncReadEngine&) = delete;
+    AsyncReadEngine& operator=(const AsyncReadEngine&) = delete;
+
+    virtual const char* name() const = 0;
+
+    // 文件首次提交前调用（IOCP 需要把句柄关联到完成端口）
+    virtual void attach(const AsyncFile& file) {
+        (void)file;
+    }
+
+    size_t depth() const {
+        return slots.size();
+    }
+
+    size_t inFlight() const {
+        return slots.size() - freeSlots.size();
+    }
+
+    // 提交读取，调用前须保证 inFlight() < depth()；缓冲区在完成前必须保持有效
+    void submit(const AsyncFile& file, uint64_t offset, unsigned char* buffer, size_t length, size_t tag) {
+        size_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        Slot& s = slots[slot];
+        s.handle = file.native();
+        s.offset = offset;
+        s.buffer = buffer;
+        s.length = length;
+        s.done = 0;
+        s.tag = tag;
+        issue(slot);
+    }
+
+    // 等待至少一个读取完成，结果追加到 completions
+    void wait(std::vector<Completion>& completions) {
+        size_t before = completions.size();
+        std::vector<std::pair<size_t, long long>> results;
+        while (completions.size() == before && inFlight() > 0) {
+            results.clear();
+            reap(results);
+            for (const auto& result : results) {
+                PhaseProfiler::countRead(result.second > 0 ? static_cast<uint64_t>(result.second) : 0);
+                Slot& s = slots[result.first];
+                if (result.second > 0 && s.done + static_cast<size_t>(result.second) < s.length) {
+                    s.done += static_cast<size_t>(result.second);
+                    issue(result.first);
+                    continue;
+                }
+                bool ok = result.second > 0 && s.done + static_cast<size_t>(result.second) == s.length;
+                completions.push_back({s.tag, ok});
+                freeSlots.push_back(result.first);
+            }
+        }
+    }
+
+protected:
+    struct Slot {
+        AsyncFile::NativeHandle handle;
+        uint64_t offset = 0;
+        unsigned char* buffer = nullptr;
+        size_t length = 0;
+        size_t done = 0;
+        size_t tag = 0;
+#ifdef _WIN32
+        OVERLAPPED overlapped;
+#elif defined(AFD_HAVE_IO_URING)
+        struct iovec iov;
+#endif
+    };
+
+    std::vector<Slot> slots;  // 构造后不再改变大小，平台结构体地址保持稳定
+    std::vector<size_t> freeSlots;
+
+    // 发出 slots[slot] 剩余部分的读取
+    virtual void issue(size_t slot) = 0;
+
+    // 阻塞直到至少一个读取完成，返回 (槽位, 读取字节数；失败为负数)
+    virtual void reap(std::vector<std::pair<size_t, long long>>& results) = 0;
+};
+
+// 同步退化实现：提交时直接读取，用于没有异步接口或初始化失败的环境
+class BlockingReadEngine : public AsyncReadEngine {
+public:
+    explicit BlockingReadEngine(size_t depth) : AsyncReadEngine(depth) {}
+
+    const char* name() const override {
+        return "blocking";
+    }
+
+protected:
+    std::vector<std::pair<size_t, long long>> finished;
+
+    void issue(size_t slot) override {
+        Slot& s = slots[slot];
+        long long result = -1;
+#ifdef _WIN32
+        DWORD length = static_cast<DWORD>(std::min<size_t>(s.length - s.done, 1u << 30));
+        uint64_t position = s.offset + s.done;
+        ZeroMemory(&s.overlapped, sizeof(s.overlapped));
+        s.overlapped.Offset = static_cast<DWORD>(position);
+        s.overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+        DWORD bytes = 0;
+        if (ReadFile(s.handle, s.buffer + s.done, length, nullptr, &s.overlapped) ||
+            GetLastError() == ERROR_IO_PENDING) {
+            if (GetOverlappedResult(s.handle, &s.overlapped, &bytes, TRUE)) {
+                result = bytes;
+            }
+        }
+#else
+        ssize_t bytes;
+        do {
+            bytes = ::pread(s.handle, s.buffer + s.done, s.length - s.done, static_cast<off_t>(s.offset + s.done));
+        } while (bytes < 0 && errno == EINTR);
+        result = bytes;
+#endif
+        finished.emplace_back(slot, result);
+    }
+
+    void reap(std::vector<std::pair<size_t, long long>>& results) override {
+        results.swap(finished);
+        finished.clear();
+    }
+};
+
+#ifdef _WIN32
+// IOCP 实现：每个文件句柄关联到同一个完成端口，读取以 OVERLAPPED 发出
+class IocpReadEngine : public AsyncReadEngine {
+public:
+    explicit IocpReadEngine(size_t depth) : AsyncReadEngine(depth) {
+        port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+        if (!port) {
+            throw std::runtime_error("无法创建完成端口");
+        }
+    }
+
+    ~IocpReadEngine() override {
+        CloseHandle(port);
+    }
+
+    const char* name() const override {
+        return "iocp";
+    }
+
+    void attach(const AsyncFile& file) override {
+        if (!CreateIoCompletionPort(file.native(), port, 0, 0)) {
+            throw std::runtime_error("无法关联完成端口");
+        }
+    }
+
+protected:
+    HANDLE port;
+    std::vector<std::pair<size_t, long long>> failedImmediately;
+
+    void issue(size_t slot) override {
+        Slot& s = slots[slot];
+        DWORD length = static_cast<DWORD>(std::min<size_t>(s.length - s.done, 1u << 30));
+        uint64_t position = s.offset + s.done;
+        ZeroMemory(&s.overlapped, sizeof(s.overlapped));
+        s.overlapped.Offset = static_cast<DWORD>(position);
+        s.overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+        // 同步完成时完成端口同样会收到通知
+        if (!ReadFile(s.handle, s.buffer + s.done, length, nullptr, &s.overlapped) &&
+            GetLastError() != ERROR_IO_PENDING) {
+            failedImmediately.emplace_back(slot, -1);
+        }
+    }
+
+    void reap(std::vector<std::pair<size_t, long long>>& results) override {
+        if (!failedImmediately.empty()) {
+            results.swap(failedImmediately);
+            failedImmediately.clear();
+            return;
+        }
+
+        OVERLAPPED_ENTRY entries[64];
+        ULONG count = 0;
+        if (!GetQueuedCompletionStatusEx(port, entries, 64, &count, INFINITE, FALSE)) {
+            throw std::runtime_error("等待异步读取失败");
+        }
+        const char* base = reinterpret_cast<const char*>(&slots[0].overlapped);
+        for (ULONG i = 0; i < count; ++i) {
+            size_t slot = static_cast<size_t>(reinterpret_cast<const char*>(entries[i].lpOverlapped) - base) / sizeof(Slot);
+            // Internal 保存操作的 NTSTATUS，非零表示失败 (包括读到文件末尾)
+            bool failed = entries[i].lpOverlapped->Internal != 0;
+            results.emplace_back(slot, failed ? -1 : static_cast<long long>(entries[i].dwNumberOfBytesTransferred));
+        }
+    }
+};
+#endif
+
+#ifdef AFD_HAVE_IO_URING
+// io_uring 实现：直接通过系统调用建立提交/完成环，不依赖 liburing
+// 使用 IORING_OP_READV 以兼容 5.1 起的内核
+class IoUringReadEngine : public AsyncReadEngine {
+public:
+    explicit IoUringReadEngine(size_t depth) : AsyncReadEngine(depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(slots.size()), &params));
+        if (ringFd < 0) {
+            throw std::runtime_error(std::string("io_uring 不可用: ") + std::strerror(errno));
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        cqRing = singleMap ? sqRing
+                           : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqeMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMap == MAP_FAILED) {
+            release();
+            throw std::runtime_error("io_uring 映射失败");
+        }
+        sqes = static_cast<io_uring_sqe*>(sqeMap);
+
+        char* sq = static_cast<char*>(sqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUringReadEngine() override {
+        release();
+    }
+
+    const char* name() const override {
+        return "io_uring";
+    }
+
+protected:
+    int ringFd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqRingSize = 0, cqRingSize = 0, sqesSize = 0;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned pendingSubmit = 0;
+
+    void release() {
+        if (sqes) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing != MAP_FAILED) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (ringFd >= 0) {
+            ::close(ringFd);
+        }
+    }
+
+    // 只写入提交环，真正的提交与等待合并在 reap 的一次 io_uring_enter 中
+    void issue(size_t slot) override {
+        Slot& s = slots[slot];
+        s.iov.iov_base = s.buffer + s.done;
+        s.iov.iov_len = s.length - s.done;
+
+        unsigned tail = *sqTail;
+        unsigned index = tail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = s.handle;
+        sqe->off = s.offset + s.done;
+        sqe->addr = reinterpret_cast<uint64_t>(&s.iov);
+        sqe->len = 1;
+        sqe->user_data = slot;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++pendingSubmit;
+    }
+
+    void reap(std::vector<std::pair<size_t, long long>>& results) override {
+        for (;;) {
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            if (head != tail) {
+                for (; head != tail; ++head) {
+                    const io_uring_cqe& cqe = cqes[head & cqMask];
+                    results.emplace_back(static_cast<size_t>(cqe.user_data), static_cast<long long>(cqe.res));
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+                return;
+            }
+
+            long submitted = syscall(__NR_io_uring_enter, ringFd, pendingSubmit, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (submitted < 0) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("io_uring_enter 失败: ") + std::strerror(errno));
+            }
+            pendingSubmit -= static_cast<unsigned>(submitted);
+        }
+    }
+};
+#endif
+
+// 选择当前平台可用的异步引擎，初始化失败 (如内核禁用 io_uring) 时退化为同步读取
+inline std::unique_ptr<AsyncReadEngine> createAsyncReadEngine(size_t depth) {
+#ifdef _WIN32
+    try {
+        return std::make_unique<IocpReadEngine>(depth);
+    } catch (const std::exception&) {
+    }
+#elif defined(AFD_HAVE_IO_URING)
+    try {
+        return std::make_unique<IoUringReadEngine>(depth);
+    } catch (const std::exception&) {
+    }
+#endif
+    return std::make_unique<BlockingReadEngine>(depth);
+}
+
+// 文件元数据：文件身份 (卷 + 文件 ID) 加大小和最后修改时间
+struct FileMeta {
+    uint64_t volume = 0;
+    uint64_t fileId[2] = {0, 0};
+    uintmax_t size = 0;
+    int64_t mtimeNs = 0;  // 自 1970-01-01 起的纳秒数
+
+    // 枚举接口未提供文件 ID 时 (如 FindFirstFileExW) 身份为空
+    bool hasIdentity() const {
+        return volume != 0 || fileId[0] != 0 || fileId[1] != 0;
+    }
+};
+
+#ifdef _WIN32
+// FILETIME (1601 起的 100ns 计数) 转为 Unix 纳秒
+inline int64_t fileTimeToUnixNs(const FILETIME& ft) {
+    int64_t ticks = (static_cast<int64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+    return (ticks - 116444736000000000LL) * 100;
+}
+#endif
+
+// 读取文件身份和元数据，只访问元数据，不读取文件内容
+inline FileMeta statFileMeta(const fs::path& filepath) {
+    FileMeta meta;
+#ifdef _WIN32
+    HANDLE handle = CreateFileW(filepath.c_str(), FILE_READ_ATTRIBUTES,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("无法读取文件信息: " + filepath.string());
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    BOOL ok = GetFileInformationByHandle(handle, &info);
+    CloseHandle(handle);
+    if (!ok) {
+        throw std::runtime_error("无法读取文件信息: " + filepath.string());
+    }
+    meta.volume = info.dwVolumeSerialNumber;
+    meta.fileId[0] = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    meta.size = (static_cast<uintmax_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    meta.mtimeNs = fileTimeToUnixNs(info.ftLastWriteTime);
+#else
+    struct stat st;
+    if (::stat(filepath.c_str(), &st) != 0) {
+        throw std::runtime_error("无法读取文件信息: " + filepath.string());
+    }
+    meta.volume = static_cast<uint64_t>(st.st_dev);
+    meta.fileId[0] = static_cast<uint64_t>(st.st_ino);
+    meta.size = static_cast<uintmax_t>(st.st_size);
+#if defined(__APPLE__)
+    meta.mtimeNs = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    meta.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+#endif
+    return meta;
+}
+
+// 文件当前的元数据与记录不一致的原因，一致时为 nullptr；
+// 记录的修改时间为 0 时不比较修改时间，任一方没有文件身份时不比较文件 ID
+inline const char* metaChangeReason(const FileMeta& recorded, const FileMeta& current) {
+    if (current.size != recorded.size) {
+        return "大小已变化";
+    }
+    if (recorded.mtimeNs != 0 && current.mtimeNs != recorded.mtimeNs) {
+        return "修改时间已变化";
+    }
+    if (recorded.hasIdentity() && current.hasIdentity() &&
+        (current.volume != recorded.volume || current.fileId[0] != recorded.fileId[0] ||
+         current.fileId[1] != recorded.fileId[1])) {
+        return "文件 ID 已变化";
+    }
+    return nullptr;
+}
+
+// 两份元数据指的是同一个文件 (卷和文件 ID 都相同)，没有文件身份的不算
+inline bool sameFileIdentity(const FileMeta& a, const FileMeta& b) {
+    return a.hasIdentity() && b.hasIdentity() && a.volume == b.volume && a.fileId[0] == b.fileId[0] &&
+           a.fileId[1] == b.fileId[1];
+}
+
+// 持久化签名缓存
+// 以 (卷, 文件 ID) 为键保存抽样签名和全文摘要，大小或修改时间变化即视为失效。
+// 磁盘格式为定长记录的紧凑二进制索引，加载时整体映射读入，保存时写临时文件后原子替换
+class SignatureCache {
+public:
+    static constexpr uint32_t kCachedRounds = 6;  // 保存第 1 到 kCachedRounds 轮的签名
+
+private:
+    static constexpr uint32_t kMagic = 0x43444641;  // "AFDC"
+    static constexpr uint32_t kVersion = 3;
+    static constexpr uint32_t kHasContentDigest = 2;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t samplePoints;
+        uint64_t sampleSize;
+        uint64_t recordCount;
+    };
+
+    // 一轮的抽样签名，文件大小取自所在的记录
+    struct RoundSignature {
+        uint32_t flags;
+        uint32_t sampleCount;
+        Digest128 samples;
+    };
+
+    struct Record {
+        uint64_t volume;
+        uint64_t fileId[2];
+        uint64_t size;
+        int64_t mtimeNs;
+        RoundSignature signatures[kCachedRounds];  // 下标为轮次 - 1
+        Digest128 contentDigest;
+        uint32_t flags;
+        uint32_t rounds;  // 第 r 轮的签名有效时第 r - 1 位为 1
+    };
+
+    struct Key {
+        uint64_t volume;
+        uint64_t fileId[2];
+
+        bool operator==(const Key& other) const {
+            return volume == other.volume && fileId[0] == other.fileId[0] && fileId[1] == other.fileId[1];
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t h = key.volume * hashing::kPrime64_1 ^ key.fileId[0] * hashing::kPrime64_2 ^ key.fileId[1];
+            return static_cast<size_t>(hashing::avalanche(h));
+        }
+    };
+
+    fs::path cachePath;
+    uint64_t samplePoints;
+    uint64_t sampleSize;
+    std::unordered_map<Key, Record, KeyHash> records;
+    std::mutex mutex;
+    bool dirty = false;
+
+    static Key keyOf(const FileMeta& meta) {
+        return {meta.volume, {meta.fileId[0], meta.fileId[1]}};
+    }
+
+    // 找到与当前元数据一致的记录；大小或修改时间不一致的旧记录直接丢弃
+    Record* findValid(const FileMeta& meta) {
+        auto it = records.find(keyOf(meta));
+        if (it == records.end()) {
+            return nullptr;
+        }
+        if (it->second.size != meta.size || it->second.mtimeNs != meta.mtimeNs) {
+            records.erase(it);
+            dirty = true;
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    Record& upsert(const FileMeta& meta) {
+        Record* existing = findValid(meta);
+        if (existing) {
+            return *existing;
+        }
+        Record record = {};
+        record.volume = meta.volume;
+        record.fileId[0] = meta.fileId[0];
+        record.fileId[1] = meta.fileId[1];
+        record.size = meta.size;
+        record.mtimeNs = meta.mtimeNs;
+        return records[keyOf(meta)] = record;
+    }
+
+public:
+    std::atomic<uint64_t> signatureHits{0};
+    std::atomic<uint64_t> contentHits{0};
+    std::atomic<uint64_t> misses{0};
+
+    SignatureCache(const fs::path& path, size_t points, size_t size)
+        : cachePath(path), samplePoints(points), sampleSize(size) {}
+
+    const fs::path& path() const {
+        return cachePath;
+    }
+
+    size_t size() const {
+        return records.size();
+    }
+
+    // 默认缓存位置: %LOCALAPPDATA%\AFD 或 $XDG_CACHE_HOME/afd (~/.cache/afd)
+    static fs::path defaultPath() {
+        fs::path base;
+#ifdef _WIN32
+        if (const char* localAppData = std::getenv("LOCALAPPDATA")) {
+            base = fs::path(localAppData) / "AFD";
+        }
+#else
+        if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+            base = fs::path(xdg) / "afd";
+        } else if (const char* home = std::getenv("HOME")) {
+            base = fs::path(home) / ".cache" / "afd";
+        }
+#endif
+        if (base.empty()) {
+            base = fs::temp_directory_path() / "afd";
+        }
+        return base / "signature_cache.bin";
+    }
+
+    // 加载缓存；文件不存在或格式不符时从空缓存开始
+    // 抽样参数变化时只保留全文摘要，抽样签名全部作废
+    bool load() {
+        std::error_code ec;
+        if (!fs::exists(cachePath, ec)) {
+            return false;
+        }
+
+        try {
+            auto reader = openFileReader(cachePath, IoBackend::Mmap, AccessPattern::Sequential);
+            if (reader->size() < sizeof(Header)) {
+                return false;
+            }
+
+            std::vector<unsigned char> scratch;
+            Header header;
+            std::memcpy(&header, reader->fetch(0, sizeof(header), scratch), sizeof(header));
+            if (header.magic != kMagic || header.version != kVersion ||
+                reader->size() < sizeof(Header) + header.recordCount * sizeof(Record)) {
+                return false;
+            }
+
+            bool sameParams = header.samplePoints == samplePoints && header.sampleSize == sampleSize;
+            size_t count = static_cast<size_t>(header.recordCount);
+            const unsigned char* data = reader->fetch(sizeof(Header), count * sizeof(Record), scratch);
+
+            records.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                Record record;
+                std::memcpy(&record, data + i * sizeof(Record), sizeof(Record));
+                if (!sameParams) {
+                    record.rounds = 0;
+                }
+                if (record.flags != 0 || record.rounds != 0) {
+                    records[{record.volume, {record.fileId[0], record.fileId[1]}}] = record;
+                }
+            }
+        } catch (const std::exception&) {
+            records.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void save() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!dirty) {
+            return;
+        }
+
+        std::error_code ec;
+        if (cachePath.has_parent_path()) {
+            fs::create_directories(cachePath.parent_path(), ec);
+        }
+
+        fs::path tempPath = cachePath;
+        tempPath += ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                throw std::runtime_error("无法写入签名缓存: " + tempPath.string());
+            }
+            Header header = {kMagic, kVersion, samplePoints, sampleSize, records.size()};
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            for (const auto& entry : records) {
+                out.write(reinterpret_cast<const char*>(&entry.second), sizeof(Record));
+            }
+            if (!out) {
+                throw std::runtime_error("无法写入签名缓存: " + tempPath.string());
+            }
+        }
+        fs::rename(tempPath, cachePath);
+        dirty = false;
+    }
+
+    // 每个文件保存它到达过的每一轮的签名，再次运行时每一轮都能命中
+    bool lookupSignature(const FileMeta& meta, uint32_t round, FileSignature& signature) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Record* record = findValid(meta);
+        if (record && round >= 1 && round <= kCachedRounds && (record->rounds & (1u << (round - 1)))) {
+            const RoundSignature& cached = record->signatures[round - 1];
+            signature.size = record->size;
+            signature.flags = cached.flags;
+            signature.sampleCount = cached.sampleCount;
+            signature.samples = cached.samples;
+            ++signatureHits;
+            PhaseProfiler::countCacheHit();
+            return true;
+        }
+        ++misses;
+        return false;
+    }
+
+    void storeSignature(const FileMeta& meta, const FileSignature& signature) {
+        uint32_t round = signature.round();
+        if (round < 1 || round > kCachedRounds) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        Record& record = upsert(meta);
+        record.signatures[round - 1] = {signature.flags, signature.sampleCount, signature.samples};
+        record.rounds |= 1u << (round - 1);
+        dirty = true;
+    }
+
+    bool lookupContentDigest(const FileMeta& meta, Digest128& digest) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Record* record = findValid(meta);
+        if (record && (record->flags & kHasContentDigest)) {
+            digest = record->contentDigest;
+            ++contentHits;
+            PhaseProfiler::countCacheHit();
+            return true;
+        }
+        return false;
+    }
+
+    void storeContentDigest(const FileMeta& meta, const Digest128& digest) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Record& record = upsert(meta);
+        record.contentDigest = digest;
+        record.flags |= kHasContentDigest;
+        dirty = true;
+    }
+};
+
+// 目录扫描结果：目录路径 + 直接包含的普通文件（元数据来自枚举本身）
+struct ScannedFile {
+    fs::path::string_type name;
+    FileMeta meta;
+};
+
+struct ScannedDirectory {
+    fs::path path;
+    std::vector<ScannedFile> files;
+};
+
+// 快速目录枚举引擎
+// Windows: GetFileInformationByHandleEx(FileIdBothDirectoryInfo)，即 NtQueryDirectoryFile 的批量接口，
+//          一次调用取回一批目录项的名称、大小、修改时间和文件 ID；
+//          文件系统不支持时退回 FindFirstFileExW(FindExInfoBasic, FIND_FIRST_EX_LARGE_FETCH)
+// Linux:   getdents64 批量读取目录项，statx 只请求类型/大小/修改时间/inode
+// 其他 POSIX: readdir + fstatat
+// 多个线程共享待扫描目录队列并行遍历；符号链接和目录联接点不跟随
+class DirectoryScanner {
+public:
+    using ErrorHandler = std::function<void(const fs::path&, const std::string&)>;
+    using DirectoryHandler = std::function<void(const ScannedDirectory&)>;
+    using DirectorySink = std::function<void(ScannedDirectory&&)>;
+
+private:
+    size_t threadCount;
+    bool recursive;
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::vector<fs::path> pending;
+    size_t activeWorkers = 0;
+
+    std::mutex resultMutex;
+    std::vector<ScannedDirectory> results;
+
+#ifdef _WIN32
+    static bool listWithFindFirstFile(const fs::path& dir, ScannedDirectory& out, std::vector<fs::path>& subdirs,
+                                      std::string& error) {
+        WIN32_FIND_DATAW data;
+        HANDLE find = FindFirstFileExW((dir / L"*").c_str(), FindExInfoBasic, &data,
+                                       FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE) {
+            error = "无法打开目录";
+            return false;
+        }
+        PhaseProfiler::countOpen();
+
+        do {
+            std::wstring name = data.cFileName;
+            if (name == L"." || name == L"..") {
+                continue;
+            }
+            DWORD attrs = data.dwFileAttributes;
+            bool reparse = (attrs & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+            if (attrs & FILE_ATTRIBUTE_DIRECTORY) {
+                if (!reparse) {
+                    subdirs.push_back(dir / name);
+                }
+            } else if (!(reparse && data.dwReserved0 == IO_REPARSE_TAG_SYMLINK)) {
+                ScannedFile file;
+                file.name = name;
+                file.meta.size = (static_cast<uintmax_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+                file.meta.mtimeNs = fileTimeToUnixNs(data.ftLastWriteTime);
+                out.files.push_back(std::move(file));
+            }
+        } while (FindNextFileW(find, &data));
+
+        FindClose(find);
+        return true;
+    }
+
+    static bool listDirectory(const fs::path& dir, ScannedDirectory& out, std::vector<fs::path>& subdirs,
+                              std::string& error) {
+        HANDLE handle = CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return listWithFindFirstFile(dir, out, subdirs, error);
+        }
+
+        PhaseProfiler::countOpen();
+        BY_HANDLE_FILE_INFORMATION volumeInfo;
+        uint64_t volume = GetFileInformationByHandle(handle, &volumeInfo) ? volumeInfo.dwVolumeSerialNumber : 0;
+
+        std::vector<uint64_t> buffer(64 * 1024 / sizeof(uint64_t));
+        FILE_INFO_BY_HANDLE_CLASS infoClass = FileIdBothDirectoryRestartInfo;
+        bool receivedAny = false;
+
+        while (GetFileInformationByHandleEx(handle, infoClass, buffer.data(),
+                                            static_cast<DWORD>(buffer.size() * sizeof(uint64_t)))) {
+            infoClass = FileIdBothDirectoryInfo;
+            receivedAny = true;
+            PhaseProfiler::countRead(0);
+
+            auto* entry = reinterpret_cast<FILE_ID_BOTH_DIR_INFO*>(buffer.data());
+            for (;;) {
+                std::wstring name(entry->FileName, entry->FileNameLength / sizeof(WCHAR));
+                if (name != L"." && name != L"..") {
+                    DWORD attrs = entry->FileAttributes;
+                    bool reparse = (attrs & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+                    if (attrs & FILE_ATTRIBUTE_DIRECTORY) {
+                        if (!reparse) {
+                            subdirs.push_back(dir / name);
+                        }
+                    } else if (!(reparse && entry->EaSize == IO_REPARSE_TAG_SYMLINK)) {
+                        // 设置了重解析属性时 EaSize 字段存放的是重解析标记
+                        ScannedFile file;
+                        file.name = std::move(name);
+                        file.meta.volume = volume;
+                        file.meta.fileId[0] = static_cast<uint64_t>(entry->FileId.QuadPart);
+                        file.meta.size = static_cast<uintmax_t>(entry->EndOfFile.QuadPart);
+                        file.meta.mtimeNs = (entry->LastWriteTime.QuadPart - 116444736000000000LL) * 100;
+                        out.files.push_back(std::move(file));
+                    }
+                }
+                if (entry->NextEntryOffset == 0) {
+                    break;
+                }
+                entry = reinterpret_cast<FILE_ID_BOTH_DIR_INFO*>(reinterpret_cast<char*>(entry) + entry->NextEntryOffset);
+            }
+        }
+
+        DWORD lastError = GetLastError();
+        CloseHandle(handle);
+
+        if (lastError == ERROR_NO_MORE_FILES) {
+            return true;
+        }
+        if (!receivedAny) {
+            // 部分文件系统/网络重定向器不支持该信息类，改用 FindFirstFileExW
+            return listWithFindFirstFile(dir, out, subdirs, error);
+        }
+        error = "读取目录失败 (错误码 " + std::to_string(lastError) + ")";
+        return false;
+    }
+#else
+    static void fillMeta(FileMeta& meta, const struct stat& st) {
+        meta.volume = static_cast<uint64_t>(st.st_dev);
+        meta.fileId[0] = static_cast<uint64_t>(st.st_ino);
+        meta.size = static_cast<uintmax_t>(st.st_size);
+#if defined(__APPLE__)
+        meta.mtimeNs = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+        meta.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    }
+
+    enum class EntryKind { Skip, File, Directory };
+
+    // 根据目录项类型决定是否需要 stat；普通文件需要大小和时间，类型未知的项需要确认类型
+    static EntryKind statEntry(int dirFd, const char* name, unsigned char type, FileMeta& meta) {
+        if (type == DT_DIR) {
+            return EntryKind::Directory;
+        }
+        if (type != DT_REG && type != DT_UNKNOWN) {
+            return EntryKind::Skip;
+        }
+
+#if defined(__linux__) && defined(STATX_SIZE)
+        struct statx stx;
+        if (statx(dirFd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+                  STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO, &stx) != 0) {
+            return EntryKind::Skip;
+        }
+        if (S_ISDIR(stx.stx_mode)) {
+            return EntryKind::Directory;
+        }
+        if (!S_ISREG(stx.stx_mode)) {
+            return EntryKind::Skip;
+        }
+        meta.volume = static_cast<uint64_t>(makedev(stx.stx_dev_major, stx.stx_dev_minor));
+        meta.fileId[0] = stx.stx_ino;
+        meta.size = static_cast<uintmax_t>(stx.stx_size);
+        meta.mtimeNs = static_cast<int64_t>(stx.stx_mtime.tv_sec) * 1000000000LL + stx.stx_mtime.tv_nsec;
+#else
+        struct stat st;
+        if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            return EntryKind::Skip;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            return EntryKind::Directory;
+        }
+        if (!S_ISREG(st.st_mode)) {
+            return EntryKind::Skip;
+        }
+        fillMeta(meta, st);
+#endif
+        return EntryKind::File;
+    }
+
+    static void addEntry(const fs::path& dir, int dirFd, const char* name, unsigned char type, ScannedDirectory& out,
+                         std::vector<fs::path>& subdirs) {
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            return;
+        }
+        ScannedFile file;
+        switch (statEntry(dirFd, name, type, file.meta)) {
+            case EntryKind::Directory:
+                subdirs.push_back(dir / name);
+                break;
+            case EntryKind::File:
+                file.name = name;
+                out.files.push_back(std::move(file));
+                break;
+            default:
+                break;
+        }
+    }
+
+    static bool listDirectory(const fs::path& dir, ScannedDirectory& out, std::vector<fs::path>& subdirs,
+                              std::string& error) {
+        int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirFd < 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        PhaseProfiler::countOpen();
+
+#if defined(__linux__) && defined(SYS_getdents64)
+        struct LinuxDirent64 {
+            uint64_t d_ino;
+            int64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[1];
+        };
+
+        alignas(8) char buffer[64 * 1024];
+        for (;;) {
+            long bytes = syscall(SYS_getdents64, dirFd, buffer, sizeof(buffer));
+            PhaseProfiler::countRead(0);
+            if (bytes < 0) {
+                error = std::strerror(errno);
+                ::close(dirFd);
+                return false;
+            }
+            if (bytes == 0) {
+                break;
+            }
+            for (long offset = 0; offset < bytes;) {
+                auto* entry = reinterpret_cast<LinuxDirent64*>(buffer + offset);
+                addEntry(dir, dirFd, entry->d_name, entry->d_type, out, subdirs);
+                offset += entry->d_reclen;
+            }
+        }
+        ::close(dirFd);
+#else
+        DIR* stream = fdopendir(dirFd);
+        if (!stream) {
+            error = std::strerror(errno);
+            ::close(dirFd);
+            return false;
+        }
+        while (struct dirent* entry = readdir(stream)) {
+            addEntry(dir, dirFd, entry->d_name, entry->d_type, out, subdirs);
+        }
+        closedir(stream);
+#endif
+        return true;
+    }
+#endif
+
+    void worker(const ErrorHandler& onError, const DirectorySink& sink) {
+        PhaseScope scope(Phase::Enumeration);
+        for (;;) {
+            fs::path dir;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueReady.wait(lock, [&] { return !pending.empty() || activeWorkers == 0; });
+                if (pending.empty()) {
+                    return;
+                }
+                dir = std::move(pending.back());
+                pending.pop_back();
+                ++activeWorkers;
+                ProgressCounters::setQueueDepth(Phase::Enumeration, pending.size());
+            }
+
+            ScannedDirectory scanned;
+            scanned.path = dir;
+            std::vector<fs::path> subdirs;
+            std::string error;
+            if (!listDirectory(dir, scanned, subdirs, error) && onError) {
+                onError(dir, error);
+            }
+
+            std::sort(scanned.files.begin(), scanned.files.end(),
+                      [](const ScannedFile& a, const ScannedFile& b) { return a.name < b.name; });
+            ProgressCounters::advance(Phase::Enumeration, scanned.files.size());
+            {
+                // 子目录在交出本目录之后才入队，父目录总是先于子目录到达
+                std::lock_guard<std::mutex> lock(resultMutex);
+                sink(std::move(scanned));
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (recursive) {
+                    for (auto& subdir : subdirs) {
+                        pending.push_back(std::move(subdir));
+                    }
+                    ProgressCounters::setQueueDepth(Phase::Enumeration, pending.size());
+                }
+                --activeWorkers;
+            }
+            queueReady.notify_all();
+        }
+    }
+
+public:
+    DirectoryScanner(size_t threads, bool recursive)
+        : threadCount(threads == 0 ? 1 : threads), recursive(recursive) {}
+
+    // 扫描 root，每列完一个目录就交给 sink，不保留结果；sink 的调用互斥，顺序取决于线程调度
+    void stream(const fs::path& root, const ErrorHandler& onError, const DirectorySink& sink) {
+        pending.assign(1, root);
+        activeWorkers = 0;
+
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threadCount; ++t) {
+            pool.emplace_back([&] { worker(onError, sink); });
+        }
+        worker(onError, sink);
+        for (auto& th : pool) {
+            th.join();
+        }
+    }
+
+    // 扫描 root，返回按路径排序的目录列表（含 root 本身），结果与线程数无关
+    std::vector<ScannedDirectory> scan(const fs::path& root, const ErrorHandler& onError = nullptr,
+                                       const DirectoryHandler& onDirectory = nullptr) {
+        results.clear();
+        stream(root, onError, [&](ScannedDirectory&& directory) {
+            if (onDirectory) {
+                onDirectory(directory);
+            }
+            results.push_back(std::move(directory));
+        });
+
+        std::sort(results.begin(), results.end(),
+                  [](const ScannedDirectory& a, const ScannedDirectory& b) { return a.path < b.path; });
+        return std::move(results);
+    }
+};
+
+// 有界工作线程池：任务按下标从共享计数器动态领取，
+// 先完成的线程自动接手剩余任务，避免大组拖慢整体进度
+class WorkerPool {
+private:
+    size_t threadCount;
+
+public:
+    explicit WorkerPool(size_t threads) : threadCount(threads == 0 ? 1 : threads) {}
+
+    size_t size() const {
+        return threadCount;
+    }
+
+    // 并行执行 fn(index)，index 取值 [0, count)，返回时所有任务均已完成
+    template <typename Fn>
+    void parallelFor(size_t count, Fn&& fn) {
+        size_t workers = std::min(threadCount, count);
+        if (workers <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                fn(i);
+            }
+            return;
+        }
+
+        std::atomic<size_t> next{0};
+        std::exception_ptr firstError;
+        std::mutex errorMutex;
+        Phase phase = PhaseProfiler::currentPhase();
+
+        auto worker = [&]() {
+            PhaseScope scope(phase);
+            size_t index;
+            while ((index = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+                try {
+                    fn(index);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!firstError) {
+                        firstError = std::current_exception();
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(workers - 1);
+        for (size_t t = 1; t < workers; ++t) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (auto& th : pool) {
+            th.join();
+        }
+
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+};
+
+// 有界阻塞队列：流水线各阶段之间传递任务，队列满时生产者等待，限制在途任务占用的内存
+template <typename T>
+class BoundedQueue {
+private:
+    size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity == 0 ? 1 : capacity) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    // 队列已关闭且取空时返回 false
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+    // 不再有新任务，等待中的消费者取完剩余任务后退出
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+};
+
+inline unsigned long currentProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<unsigned long>(getpid());
+#endif
+}
+
+// 外部排序：定长记录先在内存缓冲区中累积，缓冲区满时排序写成临时顺串；
+// finish() 后对各顺串做 k 路归并，next() 按序逐条取出。顺串过多时先分批归并，
+// 使同时打开的顺串数和各自的读缓冲都在内存上限内。没有溢出时全部在内存中完成
+template <typename Record>
+class ExternalSorter {
+private:
+    static_assert(std::is_trivially_copyable<Record>::value, "外部排序的记录必须是定长 POD");
+    static constexpr size_t kReadBlockBytes = 64 * 1024;
+
+    struct Run {
+        fs::path path;
+        uint64_t count;
+    };
+
+    class RunReader {
+    private:
+        std::ifstream in;
+        std::vector<Record> block;
+        size_t position = 0;
+        size_t filled = 0;
+        uint64_t remaining;
+
+    public:
+        RunReader(const Run& run, size_t blockRecords)
+            : in(run.path, std::ios::binary), block(std::max<size_t>(blockRecords, 1)), remaining(run.count) {
+            if (!in) {
+                throw std::runtime_error("无法打开临时文件: " + run.path.string());
+            }
+        }
+
+        bool next(Record& record) {
+            if (position == filled) {
+                if (remaining == 0) {
+                    return false;
+                }
+                filled = static_cast<size_t>(std::min<uint64_t>(block.size(), remaining));
+                if (!in.read(reinterpret_cast<char*>(block.data()), filled * sizeof(Record))) {
+                    throw std::runtime_error("读取临时文件失败");
+                }
+                remaining -= filled;
+                position = 0;
+            }
+            record = block[position++];
+            return true;
+        }
+    };
+
+    class Merger {
+    private:
+        using Item = std::pair<Record, size_t>;
+        std::vector<std::unique_ptr<RunReader>> readers;
+        std::vector<Item> heap;
+
+        static bool later(const Item& a, const Item& b) {
+            return b.first < a.first;
+        }
+
+    public:
+        Merger(const std::vector<Run>& runs, size_t blockRecords) {
+            for (const auto& run : runs) {
+                readers.push_back(std::make_unique<RunReader>(run, blockRecords));
+                Item item;
+                item.second = readers.size() - 1;
+                if (readers.back()->next(item.first)) {
+                    heap.push_back(item);
+                }
+            }
+            std::make_heap(heap.begin(), heap.end(), later);
+        }
+
+        bool pop(Record& record) {
+            if (heap.empty()) {
+                return false;
+            }
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Item& top = heap.back();
+            record = top.first;
+            if (readers[top.second]->next(top.first)) {
+                std::push_heap(heap.begin(), heap.end(), later);
+            } else {
+                heap.pop_back();
+            }
+            return true;
+        }
+    };
+
+    size_t memoryBytes;
+    fs::path baseDirectory;
+    fs::path directory;  // 首次溢出时创建，析构时删除
+    size_t bufferLimit;
+    std::vector<Record> buffer;
+    size_t bufferPosition = 0;
+    std::vector<Run> runs;
+    size_t nextRunId = 0;
+    size_t spilledRuns = 0;
+    std::unique_ptr<Merger> merger;
+
+    fs::path newRunPath() {
+        if (directory.empty()) {
+            static std::atomic<uint64_t> serial{0};
+            directory = baseDirectory / ("afd_sort_" + std::to_string(currentProcessId()) + "_" +
+                                         std::to_string(serial++));
+            fs::create_directories(directory);
+        }
+        return directory / ("run_" + std::to_string(nextRunId++) + ".bin");
+    }
+
+    // 顺串文件依次写入调用者提供的记录，produce 返回 false 表示结束
+    template <typename Produce>
+    Run writeRun(Produce produce) {
+        Run run = {newRunPath(), 0};
+        std::ofstream out(run.path, std::ios::binary | std::ios::trunc);
+        std::vector<Record> block;
+        block.reserve(kReadBlockBytes / sizeof(Record) + 1);
+        Record record;
+        auto flush = [&]() {
+            if (!block.empty() &&
+                !out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(Record))) {
+                throw std::runtime_error("写入临时文件失败: " + run.path.string());
+            }
+            run.count += block.size();
+            block.clear();
+        };
+        while (produce(record)) {
+            block.push_back(record);
+            if (block.size() * sizeof(Record) >= kReadBlockBytes) {
+                flush();
+            }
+        }
+        flush();
+        if (!out) {
+            throw std::runtime_error("写入临时文件失败: " + run.path.string());
+        }
+        ++spilledRuns;
+        return run;
+    }
+
+    void spill() {
+        std::sort(buffer.begin(), buffer.end());
+        size_t position = 0;
+        runs.push_back(writeRun([&](Record& record) {
+            if (position == buffer.size()) {
+                return false;
+            }
+            record = buffer[position++];
+            return true;
+        }));
+        buffer.clear();
+    }
+
+    size_t fanIn() const {
+        return std::max<size_t>(2, memoryBytes / kReadBlockBytes);
+    }
+
+    size_t blockRecords(size_t runCount) const {
+        return memoryBytes / std::max<size_t>(runCount, 1) / sizeof(Record);
+    }
+
+public:
+    ExternalSorter(size_t memoryBytes, const fs::path& baseDirectory)
+        : memoryBytes(std::max<size_t>(memoryBytes, kReadBlockBytes * 2)), baseDirectory(baseDirectory),
+          bufferLimit(this->memoryBytes / sizeof(Record)) {}
+
+    ExternalSorter(const ExternalSorter&) = delete;
+    ExternalSorter& operator=(const ExternalSorter&) = delete;
+
+    ~ExternalSorter() {
+        merger.reset();
+        if (!directory.empty()) {
+            std::error_code ec;
+            fs::remove_all(directory, ec);
+        }
+    }
+
+    // 缓冲区在首次写入时按上限一次预留，避免逐次扩容使容量 (和重新分配时的峰值) 超出上限
+    void push(const Record& record) {
+        if (buffer.capacity() < bufferLimit) {
+            buffer.reserve(bufferLimit);
+        }
+        buffer.push_back(record);
+        if (buffer.size() >= bufferLimit) {
+            spill();
+        }
+    }
+
+    // 写入结束，准备按序读取
+    void finish() {
+        if (runs.empty()) {
+            std::sort(buffer.begin(), buffer.end());
+            return;
+        }
+        if (!buffer.empty()) {
+            spill();
+        }
+        buffer = std::vector<Record>();
+
+        while (runs.size() > fanIn()) {
+            std::vector<Run> merged;
+            for (size_t begin = 0; begin < runs.size(); begin += fanIn()) {
+                std::vector<Run> inputs(runs.begin() + begin, runs.begin() + std::min(runs.size(), begin + fanIn()));
+                if (inputs.size() == 1) {
+                    merged.push_back(inputs[0]);
+                    continue;
+                }
+                {
+                    Merger pass(inputs, blockRecords(inputs.size()));
+                    merged.push_back(writeRun([&](Record& record) { return pass.pop(record); }));
+                }
+                for (const auto& input : inputs) {
+                    std::error_code ec;
+                    fs::remove(input.path, ec);
+                }
+            }
+            runs = std::move(merged);
+        }
+        merger = std::make_unique<Merger>(runs, blockRecords(runs.size()));
+    }
+
+    bool next(Record& record) {
+        if (merger) {
+            return merger->pop(record);
+        }
+        if (bufferPosition == buffer.size()) {
+            return false;
+        }
+        record = buffer[bufferPosition++];
+        return true;
+    }
+
+    // 写出过的临时顺串数（含中间归并），0 表示全部在内存中完成
+    size_t spilledRunCount() const {
+        return spilledRuns;
+    }
+};
+
+#ifdef _WIN32
+// NTFS 主文件表扫描
+// 用 FSCTL_ENUM_USN_DATA 直接枚举 MFT 得到 (文件引用号, 父目录, 名称, 属性)，
+// 在内存中重建扫描根目录下的目录树；大小和修改时间通过 FSCTL_GET_NTFS_FILE_RECORD
+// 读取文件记录中的 $STANDARD_INFORMATION / $DATA 属性获得，不需要打开文件。
+// 增量模式保存整卷快照和 USN 日志位置，下次只用 FSCTL_READ_USN_JOURNAL 读取变化的文件。
+// 需要管理员权限打开卷句柄
+class NtfsMftScanner {
+private:
+    static constexpr uint32_t kSnapshotMagic = 0x55444641;  // "AFDU"
+    static constexpr uint32_t kSnapshotVersion = 1;
+
+    struct Node {
+        uint64_t parent = 0;
+        uint32_t attributes = 0;
+        bool metaKnown = false;
+        uintmax_t size = 0;
+        int64_t mtimeNs = 0;
+        std::wstring name;
+    };
+
+    size_t threadCount;
+    fs::path snapshotPath;
+    HANDLE volume = INVALID_HANDLE_VALUE;
+    DWORD volumeSerial = 0;
+    DWORD bytesPerRecord = 1024;
+    std::unordered_map<uint64_t, Node> nodes;
+
+    // 只比较引用号的低 48 位 (MFT 记录号)，高 16 位是序列号
+    static uint64_t recordNumber(uint64_t frn) {
+        return frn & 0x0000FFFFFFFFFFFFULL;
+    }
+
+    static std::wstring volumeDevicePath(const fs::path& root, std::wstring& mountPoint) {
+        wchar_t mount[MAX_PATH + 1];
+        if (!GetVolumePathNameW(root.c_str(), mount, MAX_PATH)) {
+            return L"";
+        }
+        mountPoint = mount;
+        wchar_t volumeName[MAX_PATH + 1];
+        if (!GetVolumeNameForVolumeMountPointW(mount, volumeName, MAX_PATH)) {
+            return L"";
+        }
+        std::wstring device = volumeName;
+        if (!device.empty() && device.back() == L'\\') {
+            device.pop_back();  // CreateFile 打开卷时不能带结尾反斜杠
+        }
+        return device;
+    }
+
+    void addUsnRecord(const USN_RECORD_V2* record) {
+        Node& node = nodes[record->FileReferenceNumber];
+        node.parent = record->ParentFileReferenceNumber;
+        node.attributes = record->FileAttributes;
+        node.name.assign(reinterpret_cast<const wchar_t*>(reinterpret_cast<const char*>(record) + record->FileNameOffset),
+                         record->FileNameLength / sizeof(wchar_t));
+    }
+
+    bool enumerateMft(USN highUsn, std::string& error) {
+        MFT_ENUM_DATA_V0 enumData = {};
+        enumData.StartFileReferenceNumber = 0;
+        enumData.LowUsn = 0;
+        enumData.HighUsn = highUsn;
+
+        std::vector<uint64_t> buffer(1024 * 1024 / sizeof(uint64_t));
+        DWORD bytes = 0;
+        while (DeviceIoControl(volume, FSCTL_ENUM_USN_DATA, &enumData, sizeof(enumData),
+                               buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(uint64_t)), &bytes, nullptr)) {
+            PhaseProfiler::countRead(bytes);
+            const char* data = reinterpret_cast<const char*>(buffer.data());
+            DWORD offset = sizeof(USN);
+            while (offset < bytes) {
+                auto* record = reinterpret_cast<const USN_RECORD_V2*>(data + offset);
+                if (record->MajorVersion == 2) {
+                    addUsnRecord(record);
+                }
+                offset += record->RecordLength;
+            }
+            enumData.StartFileReferenceNumber = *reinterpret_cast<const DWORDLONG*>(data);
+        }
+
+        DWORD lastError = GetLastError();
+        if (lastError != ERROR_HANDLE_EOF) {
+            error = "FSCTL_ENUM_USN_DATA 失败 (错误码 " + std::to_string(lastError) + ")";
+            return false;
+        }
+        return true;
+    }
+
+    // 读取原始文件记录，解析 $STANDARD_INFORMATION 的修改时间和无名 $DATA 流的大小
+    bool readFileRecord(uint64_t frn, uintmax_t& size, int64_t& mtimeNs) {
+        NTFS_FILE_RECORD_INPUT_BUFFER input;
+        input.FileReferenceNumber.QuadPart = static_cast<LONGLONG>(frn);
+        std::vector<unsigned char> output(sizeof(NTFS_FILE_RECORD_OUTPUT_BUFFER) + bytesPerRecord);
+        DWORD bytes = 0;
+        if (!DeviceIoControl(volume, FSCTL_GET_NTFS_FILE_RECORD, &input, sizeof(input),
+                             output.data(), static_cast<DWORD>(output.size()), &bytes, nullptr)) {
+            return false;
+        }
+
+        auto* result = reinterpret_cast<NTFS_FILE_RECORD_OUTPUT_BUFFER*>(output.data());
+        // 请求的记录未使用时会返回编号更小的记录
+        if (recordNumber(static_cast<uint64_t>(result->FileReferenceNumber.QuadPart)) != recordNumber(frn)) {
+            return false;
+        }
+
+        unsigned char* rec = result->FileRecordBuffer;
+        size_t length = std::min<size_t>(result->FileRecordLength, bytesPerRecord);
+        if (length < 0x30 || std::memcmp(rec, "FILE", 4) != 0) {
+            return false;
+        }
+
+        // 更新序列修正：每个扇区最后两个字节被替换成序列号，原值保存在更新序列数组中
+        uint16_t usaOffset, usaCount;
+        std::memcpy(&usaOffset, rec + 0x04, 2);
+        std::memcpy(&usaCount, rec + 0x06, 2);
+        if (usaOffset + usaCount * 2u <= length) {
+            for (uint16_t i = 1; i < usaCount; ++i) {
+                size_t sectorEnd = static_cast<size_t>(i) * 512 - 2;
+                if (sectorEnd + 2 > length) {
+                    break;
+                }
+                if (std::memcmp(rec + sectorEnd, rec + usaOffset, 2) == 0) {
+                    std::memcpy(rec + sectorEnd, rec + usaOffset + i * 2, 2);
+                }
+            }
+        }
+
+        uint16_t attrOffset;
+        std::memcpy(&attrOffset, rec + 0x14, 2);
+        bool haveSize = false, haveTime = false;
+
+        while (attrOffset + 16u <= length) {
+            uint32_t type, attrLength;
+            std::memcpy(&type, rec + attrOffset, 4);
+            std::memcpy(&attrLength, rec + attrOffset + 4, 4);
+            if (type == 0xFFFFFFFF || attrLength == 0 || attrOffset + attrLength > length) {
+                break;
+            }
+            const unsigned char* attr = rec + attrOffset;
+            bool nonResident = attr[8] != 0;
+            uint8_t nameLength = attr[9];
+
+            if (type == 0x10 && !nonResident) {
+                uint16_t valueOffset;
+                std::memcpy(&valueOffset, attr + 0x14, 2);
+                if (valueOffset + 16u <= attrLength) {
+                    FILETIME ft;
+                    std::memcpy(&ft, attr + valueOffset + 8, sizeof(ft));
+                    mtimeNs = fileTimeToUnixNs(ft);
+                    haveTime = true;
+                }
+            } else if (type == 0x80 && nameLength == 0) {
+                if (nonResident) {
+                    uint64_t lowestVcn, dataSize;
+                    std::memcpy(&lowestVcn, attr + 0x10, 8);
+                    std::memcpy(&dataSize, attr + 0x30, 8);
+                    if (lowestVcn == 0) {
+                        size = dataSize;
+                        haveSize = true;
+                    }
+                } else {
+                    uint32_t valueLength;
+                    std::memcpy(&valueLength, attr + 0x10, 4);
+                    size = valueLength;
+                    haveSize = true;
+                }
+            }
+            attrOffset += attrLength;
+        }
+
+        return haveSize && haveTime;
+    }
+
+    // $DATA 在属性列表扩展记录中 (高度碎片化的大文件) 时按文件 ID 打开读取
+    bool queryById(uint64_t frn, uintmax_t& size, int64_t& mtimeNs) {
+        FILE_ID_DESCRIPTOR descriptor = {};
+        descriptor.dwSize = sizeof(descriptor);
+        descriptor.Type = FileIdType;
+        descriptor.FileId.QuadPart = static_cast<LONGLONG>(frn);
+        HANDLE handle = OpenFileById(volume, &descriptor, FILE_READ_ATTRIBUTES,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                     nullptr, FILE_FLAG_BACKUP_SEMANTICS);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        BY_HANDLE_FILE_INFORMATION info;
+        BOOL ok = GetFileInformationByHandle(handle, &info);
+        CloseHandle(handle);
+        if (!ok) {
+            return false;
+        }
+        size = (static_cast<uintmax_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+        mtimeNs = fileTimeToUnixNs(info.ftLastWriteTime);
+        return true;
+    }
+
+    void refreshMeta(const std::vector<uint64_t>& frns) {
+        WorkerPool pool(threadCount);
+        std::vector<Node*> targets;
+        targets.reserve(frns.size());
+        for (uint64_t frn : frns) {
+            targets.push_back(&nodes[frn]);
+        }
+        pool.parallelFor(frns.size(), [&](size_t i) {
+            Node& node = *targets[i];
+            node.metaKnown = readFileRecord(frns[i], node.size, node.mtimeNs) ||
+                             queryById(frns[i], node.size, node.mtimeNs);
+        });
+    }
+
+    bool loadSnapshot(USN& nextUsn, DWORDLONG journalId) {
+        std::ifstream in(snapshotPath, std::ios::binary);
+        if (!in) {
+            return false;
+        }
+        uint32_t magic = 0, version = 0, serial = 0;
+        uint64_t savedJournal = 0, count = 0;
+        int64_t savedUsn = 0;
+        in.read(reinterpret_cast<char*>(&magic), 4);
+        in.read(reinterpret_cast<char*>(&version), 4);
+        in.read(reinterpret_cast<char*>(&serial), 4);
+        in.read(reinterpret_cast<char*>(&savedJournal), 8);
+        in.read(reinterpret_cast<char*>(&savedUsn), 8);
+        in.read(reinterpret_cast<char*>(&count), 8);
+        if (!in || magic != kSnapshotMagic || version != kSnapshotVersion ||
+            serial != volumeSerial || savedJournal != journalId) {
+            return false;
+        }
+
+        nodes.reserve(static_cast<size_t>(count));
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t frn;
+            Node node;
+            uint8_t known;
+            uint32_t nameLength;
+            in.read(reinterpret_cast<char*>(&frn), 8);
+            in.read(reinterpret_cast<char*>(&node.parent), 8);
+            in.read(reinterpret_cast<char*>(&node.attributes), 4);
+            in.read(reinterpret_cast<char*>(&known), 1);
+            in.read(reinterpret_cast<char*>(&node.size), sizeof(node.size));
+            in.read(reinterpret_cast<char*>(&node.mtimeNs), 8);
+            in.read(reinterpret_cast<char*>(&nameLength), 4);
+            node.name.resize(nameLength);
+            in.read(reinterpret_cast<char*>(&node.name[0]), nameLength * sizeof(wchar_t));
+            if (!in) {
+                nodes.clear();
+                return false;
+            }
+            node.metaKnown = known != 0;
+            nodes.emplace(frn, std::move(node));
+        }
+        nextUsn = savedUsn;
+        return true;
+    }
+
+    void saveSnapshot(DWORDLONG journalId, USN nextUsn) {
+        std::error_code ec;
+        fs::create_directories(snapshotPath.parent_path(), ec);
+        fs::path tempPath = snapshotPath;
+        tempPath += ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            uint64_t count = nodes.size();
+            uint32_t serial = volumeSerial;
+            uint64_t journal = journalId;
+            int64_t usn = nextUsn;
+            out.write(reinterpret_cast<const char*>(&kSnapshotMagic), 4);
+            out.write(reinterpret_cast<const char*>(&kSnapshotVersion), 4);
+            out.write(reinterpret_cast<const char*>(&serial), 4);
+            out.write(reinterpret_cast<const char*>(&journal), 8);
+            out.write(reinterpret_cast<const char*>(&usn), 8);
+            out.write(reinterpret_cast<const char*>(&count), 8);
+            for (const auto& entry : nodes) {
+                const Node& node = entry.second;
+                uint8_t known = node.metaKnown ? 1 : 0;
+                uint32_t nameLength = static_cast<uint32_t>(node.name.size());
+                out.write(reinterpret_cast<const char*>(&entry.first), 8);
+                out.write(reinterpret_cast<const char*>(&node.parent), 8);
+                out.write(reinterpret_cast<const char*>(&node.attributes), 4);
+                out.write(reinterpret_cast<const char*>(&known), 1);
+                out.write(reinterpret_cast<const char*>(&node.size), sizeof(node.size));
+                out.write(reinterpret_cast<const char*>(&node.mtimeNs), 8);
+                out.write(reinterpret_cast<const char*>(&nameLength), 4);
+                out.write(reinterpret_cast<const char*>(node.name.data()), nameLength * sizeof(wchar_t));
+            }
+            if (!out) {
+                return;
+            }
+        }
+        fs::rename(tempPath, snapshotPath, ec);
+    }
+
+    // 读取上次快照之后的 USN 日志，更新节点；返回需要重新读取元数据的文件
+    bool applyJournal(DWORDLONG journalId, USN startUsn, USN& nextUsn, std::vector<uint64_t>& changed) {
+        READ_USN_JOURNAL_DATA_V0 readData = {};
+        readData.StartUsn = startUsn;
+        readData.ReasonMask = 0xFFFFFFFF;
+        readData.UsnJournalID = journalId;
+
+        std::unordered_map<uint64_t, bool> touched;
+        std::vector<uint64_t> buffer(1024 * 1024 / sizeof(uint64_t));
+        for (;;) {
+            DWORD bytes = 0;
+            if (!DeviceIoControl(volume, FSCTL_READ_USN_JOURNAL, &readData, sizeof(readData),
+                                 buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(uint64_t)), &bytes, nullptr)) {
+                return false;  // 日志被截断或重建，需要全量扫描
+            }
+            const char* data = reinterpret_cast<const char*>(buffer.data());
+            USN next = *reinterpret_cast<const USN*>(data);
+            if (bytes <= sizeof(USN)) {
+                nextUsn = next;
+                break;
+            }
+
+            for (DWORD offset = sizeof(USN); offset < bytes;) {
+                auto* record = reinterpret_cast<const USN_RECORD_V2*>(data + offset);
+                offset += record->RecordLength;
+                if (record->MajorVersion != 2) {
+                    continue;
+                }
+                uint64_t frn = record->FileReferenceNumber;
+                if (record->Reason & USN_REASON_FILE_DELETE) {
+                    nodes.erase(frn);
+                    touched.erase(frn);
+                } else if (!(record->Reason & USN_REASON_RENAME_OLD_NAME)) {
+                    addUsnRecord(record);
+                    touched[frn] = true;
+                }
+            }
+            readData.StartUsn = next;
+        }
+
+        for (const auto& entry : touched) {
+            changed.push_back(entry.first);
+        }
+        return true;
+    }
+
+    // 从节点表重建 root 下的目录树
+    std::vector<ScannedDirectory> buildTree(const fs::path& root, uint64_t rootFrn) {
+        // 0 = 未知, 1 = 在根目录下, 2 = 不在
+        std::unordered_map<uint64_t, std::pair<int, size_t>> dirState;
+        std::vector<ScannedDirectory> directories;
+        dirState[rootFrn] = {1, 0};
+        directories.push_back({root, {}});
+
+        std::function<std::pair<int, size_t>(uint64_t)> resolve = [&](uint64_t frn) -> std::pair<int, size_t> {
+            auto known = dirState.find(frn);
+            if (known != dirState.end()) {
+                return known->second;
+            }
+            auto it = nodes.find(frn);
+            if (it == nodes.end() || it->second.parent == frn ||
+                (it->second.attributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                return dirState[frn] = {2, 0};
+            }
+            dirState[frn] = {2, 0};  // 防止损坏的父链形成环
+            auto parent = resolve(it->second.parent);
+            if (parent.first != 1) {
+                return dirState[frn] = {2, 0};
+            }
+            directories.push_back({directories[parent.second].path / it->second.name, {}});
+            return dirState[frn] = {1, directories.size() - 1};
+        };
+
+        std::vector<uint64_t> missing;
+        for (const auto& entry : nodes) {
+            const Node& node = entry.second;
+            // USN 记录不含重解析标记，无法区分符号链接，带重解析属性的文件一律跳过
+            if (node.attributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT)) {
+                continue;
+            }
+            if (resolve(node.parent).first == 1 && !node.metaKnown) {
+                missing.push_back(entry.first);
+            }
+        }
+        refreshMeta(missing);
+
+        for (const auto& entry : nodes) {
+            const Node& node = entry.second;
+            if (node.attributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT) || !node.metaKnown) {
+                continue;
+            }
+            auto parent = resolve(node.parent);
+            if (parent.first != 1) {
+                continue;
+            }
+            ScannedFile file;
+            file.name = node.name;
+            file.meta.volume = volumeSerial;
+            file.meta.fileId[0] = entry.first;
+            file.meta.size = node.size;
+            file.meta.mtimeNs = node.mtimeNs;
+            directories[parent.second].files.push_back(std::move(file));
+        }
+
+        for (auto& directory : directories) {
+            std::sort(directory.files.begin(), directory.files.end(),
+                      [](const ScannedFile& a, const ScannedFile& b) { return a.name < b.name; });
+        }
+        std::sort(directories.begin(), directories.end(),
+                  [](const ScannedDirectory& a, const ScannedDirectory& b) { return a.path < b.path; });
+        return directories;
+    }
+
+public:
+    NtfsMftScanner(size_t threads, const fs::path& stateDirectory)
+        : threadCount(threads), snapshotPath(stateDirectory) {}
+
+    ~NtfsMftScanner() {
+        if (volume != INVALID_HANDLE_VALUE) {
+            CloseHandle(volume);
+        }
+    }
+
+    NtfsMftScanner(const NtfsMftScanner&) = delete;
+    NtfsMftScanner& operator=(const NtfsMftScanner&) = delete;
+
+    bool scan(const fs::path& folder, bool incremental, std::vector<ScannedDirectory>& directories,
+              std::string& error, std::string& summary) {
+        fs::path root = fs::absolute(folder);
+        std::wstring mountPoint;
+        std::wstring device = volumeDevicePath(root, mountPoint);
+        if (device.empty()) {
+            error = "无法确定所在卷";
+            return false;
+        }
+
+        wchar_t fsName[MAX_PATH + 1] = {};
+        if (!GetVolumeInformationW(mountPoint.c_str(), nullptr, 0, &volumeSerial, nullptr, nullptr, fsName, MAX_PATH) ||
+            std::wstring(fsName) != L"NTFS") {
+            error = "不是 NTFS 卷";
+            return false;
+        }
+
+        volume = CreateFileW(device.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             nullptr, OPEN_EXISTING, 0, nullptr);
+        if (volume == INVALID_HANDLE_VALUE) {
+            error = "无法打开卷 (需要管理员权限)";
+            return false;
+        }
+
+        NTFS_VOLUME_DATA_BUFFER volumeData;
+        DWORD bytes = 0;
+        if (DeviceIoControl(volume, FSCTL_GET_NTFS_VOLUME_DATA, nullptr, 0, &volumeData, sizeof(volumeData), &bytes, nullptr)) {
+            bytesPerRecord = volumeData.BytesPerFileRecordSegment;
+        }
+
+        USN_JOURNAL_DATA_V0 journal = {};
+        bool haveJournal = DeviceIoControl(volume, FSCTL_QUERY_USN_JOURNAL, nullptr, 0,
+                                           &journal, sizeof(journal), &bytes, nullptr) != 0;
+
+        HANDLE rootHandle = CreateFileW(root.c_str(), FILE_READ_ATTRIBUTES,
+                                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                        nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+        BY_HANDLE_FILE_INFORMATION rootInfo;
+        if (rootHandle == INVALID_HANDLE_VALUE || !GetFileInformationByHandle(rootHandle, &rootInfo)) {
+            if (rootHandle != INVALID_HANDLE_VALUE) {
+                CloseHandle(rootHandle);
+            }
+            error = "无法读取根目录信息";
+            return false;
+        }
+        CloseHandle(rootHandle);
+        uint64_t rootFrn = (static_cast<uint64_t>(rootInfo.nFileIndexHigh) << 32) | rootInfo.nFileIndexLow;
+
+        std::ostringstream snapshotName;
+        snapshotName << "usn_snapshot_" << std::hex << std::uppercase << volumeSerial << ".bin";
+        snapshotPath /= snapshotName.str();
+
+        USN nextUsn = haveJournal ? journal.NextUsn : 0;
+        bool usedIncremental = false;
+        if (incremental && haveJournal) {
+            USN savedUsn = 0;
+            std::vector<uint64_t> changed;
+            if (loadSnapshot(savedUsn, journal.UsnJournalID) &&
+                applyJournal(journal.UsnJournalID, savedUsn, nextUsn, changed)) {
+                for (uint64_t frn : changed) {
+                    nodes[frn].metaKnown = false;
+                }
+                summary = "增量扫描: USN 日志中有 " + std::to_string(changed.size()) + " 个文件发生变化";
+                usedIncremental = true;
+            } else {
+                nodes.clear();
+            }
+        }
+
+        if (!usedIncremental) {
+            if (!enumerateMft(haveJournal ? journal.NextUsn : MAXLONGLONG, error)) {
+                return false;
+            }
+            summary = "MFT 枚举: " + std::to_string(nodes.size()) + " 条记录";
+            if (incremental && !haveJournal) {
+                summary += " (卷未启用 USN 日志，无法增量扫描)";
+            }
+        }
+
+        directories = buildTree(root, rootFrn);
+
+        if (incremental && haveJournal) {
+            saveSnapshot(journal.UsnJournalID, nextUsn);
+        }
+        return true;
+    }
+};
+#endif
+
+// 分布式协议的消息负载和断点日志记录的编码与解码；字符串和列表都以 u32 长度开头
+class WireWriter {
+public:
+    std::string data;
+
+    template <typename T>
+    void put(T value) {
+        static_assert(std::is_trivially_copyable<T>::value, "只能直接写入平凡类型");
+        data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void putString(const std::string& text) {
+        put(static_cast<uint32_t>(text.size()));
+        data += text;
+    }
+
+    void putRefs(const std::vector<uint32_t>& refs) {
+        put(static_cast<uint32_t>(refs.size()));
+        data.append(reinterpret_cast<const char*>(refs.data()), refs.size() * sizeof(uint32_t));
+    }
+
+    // 平凡类型的数组，以 u64 元素数开头
+    template <typename T>
+    void putArray(const T* items, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "只能直接写入平凡类型");
+        put(static_cast<uint64_t>(count));
+        data.append(reinterpret_cast<const char*>(items), count * sizeof(T));
+    }
+};
+
+class WireReader {
+private:
+    const std::string& data;
+    size_t position = 0;
+
+    void require(size_t length) const {
+        if (data.size() - position < length) {
+            throw std::runtime_error("消息格式错误");
+        }
+    }
+
+public:
+    explicit WireReader(const std::string& payload) : data(payload) {}
+
+    template <typename T>
+    T get() {
+        require(sizeof(T));
+        T value;
+        std::memcpy(&value, data.data() + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    std::string getString() {
+        uint32_t length = get<uint32_t>();
+        require(length);
+        std::string text = data.substr(position, length);
+        position += length;
+        return text;
+    }
+
+    std::vector<uint32_t> getRefs() {
+        uint32_t count = get<uint32_t>();
+        require(static_cast<size_t>(count) * sizeof(uint32_t));
+        std::vector<uint32_t> refs(count);
+        std::memcpy(refs.data(), data.data() + position, refs.size() * sizeof(uint32_t));
+        position += refs.size() * sizeof(uint32_t);
+        return refs;
+    }
+
+    template <typename T>
+    std::vector<T> getArray() {
+        uint64_t count = get<uint64_t>();
+        if (count > (data.size() - position) / sizeof(T)) {
+            throw std::runtime_error("消息格式错误");
+        }
+        std::vector<T> items(static_cast<size_t>(count));
+        std::memcpy(items.data(), data.data() + position, items.size() * sizeof(T));
+        position += items.size() * sizeof(T);
+        return items;
+    }
+
+    bool done() const {
+        return position == data.size();
+    }
+};
+
+// 文件表：扫描结果的紧凑存储
+// 目录以 (父目录下标, 名称片段) 组成的节点数组保存，文件的名称、大小、时间、文件 ID 按列存放，
+// 所有名称首尾相接放在一块字符缓冲区中；各阶段的分组只保存 32 位文件下标，
+// 完整路径只在打开文件、显示和删除时临时拼出
+class FileTable {
+private:
+    using string_type = fs::path::string_type;
+    static constexpr uint32_t kNoParent = std::numeric_limits<uint32_t>::max();
+
+    struct NameSlice {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    string_type names;
+    std::vector<uint32_t> directoryParents;
+    std::vector<NameSlice> directoryNames;
+    std::vector<uint32_t> directoryFileBegins;  // 每个目录的文件在文件列中连续存放
+
+    std::vector<uint32_t> fileDirectories;
+    std::vector<NameSlice> fileNames;
+    std::vector<uintmax_t> fileSizes;
+    std::vector<int64_t> fileMtimes;
+    std::vector<uint64_t> fileVolumes;
+    std::vector<uint64_t> fileIds;  // 每个文件两个字
+
+    // 追加期间的目录路径 -> 下标，用于查找父目录
+    std::unordered_map<string_type, uint32_t> directoryLookup;
+
+    NameSlice intern(const string_type& name) {
+        if (names.size() + name.size() > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("文件表名称区超过 4G 字符");
+        }
+        NameSlice slice = {static_cast<uint32_t>(names.size()), static_cast<uint32_t>(name.size())};
+        names.append(name);
+        return slice;
+    }
+
+    string_type sliceText(NameSlice slice) const {
+        return names.substr(slice.offset, slice.length);
+    }
+
+public:
+    // 追加一个目录的扫描结果并释放原始数据，父目录必须先于子目录追加；
+    // 返回该目录第一个文件的下标
+    uint32_t appendDirectory(ScannedDirectory&& directory) {
+        if (directoryParents.size() >= kNoParent || fileSizes.size() + directory.files.size() >= kNoParent) {
+            throw std::length_error("文件数超过文件表上限");
+        }
+
+        // 找不到父目录时（扫描根目录）以完整路径作为名称
+        uint32_t parent = kNoParent;
+        auto found = directoryLookup.find(directory.path.parent_path().native());
+        if (found != directoryLookup.end() && directory.path.has_filename()) {
+            parent = found->second;
+        }
+        uint32_t index = static_cast<uint32_t>(directoryParents.size());
+        directoryParents.push_back(parent);
+        directoryNames.push_back(intern(parent == kNoParent ? directory.path.native()
+                                                            : directory.path.filename().native()));
+        directoryLookup.emplace(directory.path.native(), index);
+
+        uint32_t first = static_cast<uint32_t>(fileSizes.size());
+        directoryFileBegins.push_back(first);
+        for (const auto& file : directory.files) {
+            fileDirectories.push_back(index);
+            fileNames.push_back(intern(file.name));
+            fileSizes.push_back(file.meta.size);
+            fileMtimes.push_back(file.meta.mtimeNs);
+            fileVolumes.push_back(file.meta.volume);
+            fileIds.push_back(file.meta.fileId[0]);
+            fileIds.push_back(file.meta.fileId[1]);
+        }
+        directory.files = std::vector<ScannedFile>();
+        return first;
+    }
+
+    // 追加结束，释放目录查找表
+    void finishAppend() {
+        directoryLookup = std::unordered_map<string_type, uint32_t>();
+    }
+
+    // 追加目录扫描结果（目录按路径排序，父目录总在子目录之前）；
+    // 逐个目录转入文件表并立即释放原始数据
+    void append(std::vector<ScannedDirectory>&& directories) {
+        for (auto& directory : directories) {
+            appendDirectory(std::move(directory));
+        }
+        directories = std::vector<ScannedDirectory>();
+        finishAppend();
+    }
+
+    size_t fileCount() const {
+        return fileSizes.size();
+    }
+
+    size_t directoryCount() const {
+        return directoryParents.size();
+    }
+
+    // 目录直接包含的文件下标范围 [first, second)
+    std::pair<uint32_t, uint32_t> directoryFiles(uint32_t directory) const {
+        uint32_t end = directory + 1 < directoryFileBegins.size() ? directoryFileBegins[directory + 1]
+                                                                  : static_cast<uint32_t>(fileSizes.size());
+        return {directoryFileBegins[directory], end};
+    }
+
+    uintmax_t size(uint32_t file) const {
+        return fileSizes[file];
+    }
+
+    // 枚举时记录的最后修改时间，自 1970-01-01 起的纳秒数
+    int64_t mtime(uint32_t file) const {
+        return fileMtimes[file];
+    }
+
+    FileMeta meta(uint32_t file) const {
+        FileMeta meta;
+        meta.volume = fileVolumes[file];
+        meta.fileId[0] = fileIds[file * 2];
+        meta.fileId[1] = fileIds[file * 2 + 1];
+        meta.size = fileSizes[file];
+        meta.mtimeNs = fileMtimes[file];
+        return meta;
+    }
+
+    fs::path directoryPath(uint32_t directory) const {
+        std::vector<uint32_t> chain;
+        for (uint32_t node = directory; node != kNoParent; node = directoryParents[node]) {
+            chain.push_back(node);
+        }
+        fs::path path;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            path /= sliceText(directoryNames[*it]);
+        }
+        return path;
+    }
+
+    fs::path path(uint32_t file) const {
+        return directoryPath(fileDirectories[file]) / sliceText(fileNames[file]);
+    }
+
+    // 按 (目录路径, 文件名) 比较，与按路径排序的扫描结果中的下标顺序一致
+    bool pathLess(uint32_t a, uint32_t b) const {
+        if (fileDirectories[a] != fileDirectories[b]) {
+            return directoryPath(fileDirectories[a]) < directoryPath(fileDirectories[b]);
+        }
+        return sliceText(fileNames[a]) < sliceText(fileNames[b]);
+    }
+
+    // 大小与其他文件相同的文件下标，按 (大小, 下标) 排序；
+    // 抽样签名以大小开头，后续按签名分区时各大小组自然分开
+    std::vector<uint32_t> sharedSizeCandidates() const {
+        return sharedSizeCandidates(0, static_cast<uint32_t>(fileSizes.size()));
+    }
+
+    // 只在下标范围 [begin, end) 内分组，例如单个目录的文件
+    std::vector<uint32_t> sharedSizeCandidates(uint32_t begin, uint32_t end) const {
+        std::vector<uint32_t> order(end - begin);
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            order[i] = begin + i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return fileSizes[a] < fileSizes[b];
+        });
+
+        std::vector<uint32_t> candidates;
+        for (size_t run = 0; run < order.size();) {
+            size_t runEnd = run + 1;
+            while (runEnd < order.size() && fileSizes[order[runEnd]] == fileSizes[order[run]]) {
+                ++runEnd;
+            }
+            if (runEnd - run > 1) {
+                candidates.insert(candidates.end(), order.begin() + run, order.begin() + runEnd);
+            }
+            run = runEnd;
+        }
+        return candidates;
+    }
+
+    // 断点日志中的文件表：各列原样写出，名称为本平台的路径字符单元，日志不跨平台使用
+    void save(WireWriter& out) const {
+        out.putArray(names.data(), names.size());
+        out.putArray(directoryParents.data(), directoryParents.size());
+        out.putArray(directoryNames.data(), directoryNames.size());
+        out.putArray(directoryFileBegins.data(), directoryFileBegins.size());
+        out.putArray(fileDirectories.data(), fileDirectories.size());
+        out.putArray(fileNames.data(), fileNames.size());
+        out.putArray(fileSizes.data(), fileSizes.size());
+        out.putArray(fileMtimes.data(), fileMtimes.size());
+        out.putArray(fileVolumes.data(), fileVolumes.size());
+        out.putArray(fileIds.data(), fileIds.size());
+    }
+
+    // 列长度不一致或下标越界时抛出异常，文件表保持为空
+    void load(WireReader& in) {
+        FileTable table;
+        auto text = in.getArray<string_type::value_type>();
+        table.names.assign(text.begin(), text.end());
+        table.directoryParents = in.getArray<uint32_t>();
+        table.directoryNames = in.getArray<NameSlice>();
+        table.directoryFileBegins = in.getArray<uint32_t>();
+        table.fileDirectories = in.getArray<uint32_t>();
+        table.fileNames = in.getArray<NameSlice>();
+        table.fileSizes = in.getArray<uintmax_t>();
+        table.fileMtimes = in.getArray<int64_t>();
+        table.fileVolumes = in.getArray<uint64_t>();
+        table.fileIds = in.getArray<uint64_t>();
+
+        size_t directories = table.directoryParents.size();
+        size_t count = table.fileSizes.size();
+        bool consistent = table.directoryNames.size() == directories && table.directoryFileBegins.size() == directories &&
+                          table.fileDirectories.size() == count && table.fileNames.size() == count &&
+                          table.fileMtimes.size() == count && table.fileVolumes.size() == count &&
+                          table.fileIds.size() == count * 2;
+        auto sliceValid = [&](NameSlice slice) {
+            return static_cast<size_t>(slice.offset) + slice.length <= table.names.size();
+        };
+        for (size_t i = 0; consistent && i < directories; ++i) {
+            consistent = (table.directoryParents[i] == kNoParent || table.directoryParents[i] < i) &&
+                         table.directoryFileBegins[i] <= count && sliceValid(table.directoryNames[i]);
+        }
+        for (size_t i = 0; consistent && i < count; ++i) {
+            consistent = table.fileDirectories[i] < directories && sliceValid(table.fileNames[i]);
+        }
+        if (!consistent) {
+            throw std::runtime_error("文件表记录不一致");
+        }
+        *this = std::move(table);
+    }
+
+    // 文件表自身占用的内存（字节）
+    size_t memoryBytes() const {
+        return names.capacity() * sizeof(string_type::value_type) +
+               directoryParents.capacity() * sizeof(uint32_t) + directoryNames.capacity() * sizeof(NameSlice) +
+               directoryFileBegins.capacity() * sizeof(uint32_t) +
+               fileDirectories.capacity() * sizeof(uint32_t) + fileNames.capacity() * sizeof(NameSlice) +
+               fileSizes.capacity() * sizeof(uintmax_t) + fileMtimes.capacity() * sizeof(int64_t) +
+               fileVolumes.capacity() * sizeof(uint64_t) + fileIds.capacity() * sizeof(uint64_t);
+    }
+};
+
+// 文件组：文件表中的下标
+using FileGroup = std::vector<uint32_t>;
+
+// 不保留的重复文件的处理方式
+enum class DuplicateAction {
+    Delete,    // 删除
+    Hardlink,  // 替换为指向保留文件的硬链接
+    Reflink,   // 替换为与保留文件共享数据块的克隆 (ReFS / Btrfs / XFS / APFS)
+    Symlink    // 替换为指向保留文件的符号链接
+};
+
+inline const char* duplicateActionName(DuplicateAction action) {
+    switch (action) {
+        case DuplicateAction::Hardlink: return "hardlink";
+        case DuplicateAction::Reflink: return "reflink";
+        case DuplicateAction::Symlink: return "symlink";
+        default: return "delete";
+    }
+}
+
+inline bool parseDuplicateAction(const std::string& name, DuplicateAction& action) {
+    if (name == "delete") {
+        action = DuplicateAction::Delete;
+    } else if (name == "hardlink") {
+        action = DuplicateAction::Hardlink;
+    } else if (name == "reflink") {
+        action = DuplicateAction::Reflink;
+    } else if (name == "symlink") {
+        action = DuplicateAction::Symlink;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// 块克隆：target 为新建文件，与 source 共享数据块，之后任一方写入时才各自复制
+// Windows (ReFS) 用 FSCTL_DUPLICATE_EXTENTS_TO_FILE，Linux (Btrfs / XFS) 用 FICLONE，macOS (APFS) 用 clonefile；
+// 失败时删除 target 并抛出异常
+inline void cloneFile(const fs::path& source, const fs::path& target) {
+#if defined(_WIN32) && defined(FSCTL_DUPLICATE_EXTENTS_TO_FILE)
+    static constexpr uint64_t kCloneChunk = 1ULL << 30;  // 每次克隆的范围，须为簇大小的整数倍
+
+    HANDLE src = openReadHandle(source, 0);
+    HANDLE dst = CreateFileW(target.c_str(), GENERIC_READ | GENERIC_WRITE | DELETE, 0, nullptr,
+                             CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (dst == INVALID_HANDLE_VALUE) {
+        CloseHandle(src);
+        throw std::runtime_error("无法创建文件: " + target.string());
+    }
+
+    uintmax_t size = handleFileSize(src);
+    uint64_t clusterSize = volumeClusterSize(target);
+    bool ok = clusterSize != 0;
+
+    // 稀疏源文件要求目标也是稀疏文件；目标须先设好长度
+    BY_HANDLE_FILE_INFORMATION info;
+    DWORD bytes = 0;
+    if (ok && GetFileInformationByHandle(src, &info) && (info.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE)) {
+        ok = DeviceIoControl(dst, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytes, nullptr) != 0;
+    }
+    FILE_END_OF_FILE_INFO endOfFile;
+    endOfFile.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+    ok = ok && SetFileInformationByHandle(dst, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+
+    // 克隆范围按簇对齐，末尾不足一簇的部分向上取整
+    for (uint64_t offset = 0; ok && offset < size; offset += kCloneChunk) {
+        uint64_t length = std::min<uint64_t>(kCloneChunk, size - offset);
+        DUPLICATE_EXTENTS_DATA extents;
+        extents.FileHandle = src;
+        extents.SourceFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+        extents.TargetFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+        extents.ByteCount.QuadPart = static_cast<LONGLONG>((length + clusterSize - 1) / clusterSize * clusterSize);
+        ok = DeviceIoControl(dst, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &extents, sizeof(extents),
+                             nullptr, 0, &bytes, nullptr) != 0;
+    }
+    DWORD error = ok ? 0 : GetLastError();
+    CloseHandle(dst);
+    CloseHandle(src);
+    if (!ok) {
+        DeleteFileW(target.c_str());
+        throw std::runtime_error("块克隆失败 (错误码 " + std::to_string(error) + ")，卷可能不支持块克隆");
+    }
+#elif defined(__APPLE__)
+    if (clonefile(source.c_str(), target.c_str(), 0) != 0) {
+        throw std::runtime_error(std::string("块克隆失败: ") + std::strerror(errno));
+    }
+#elif defined(__linux__) && defined(FICLONE)
+    int src = openReadDescriptor(source, 0);
+    int dst = ::open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (dst < 0) {
+        ::close(src);
+        throw std::runtime_error("无法创建文件: " + target.string());
+    }
+    int result = ioctl(dst, FICLONE, src);
+    int error = errno;
+    ::close(dst);
+    ::close(src);
+    if (result != 0) {
+        ::unlink(target.c_str());
+        throw std::runtime_error(std::string("块克隆失败: ") + std::strerror(error));
+    }
+#else
+    (void)source;
+    (void)target;
+    throw std::runtime_error("此平台不支持块克隆");
+#endif
+}
+
+// 用指向 source 的硬链接 / 符号链接 / 克隆原子替换 target：先在 target 所在目录创建临时项，
+// 再重命名覆盖 target (rename / MoveFileExW 替换已有文件)，任一步失败时 target 保持原样
+inline void replaceWithLink(const fs::path& source, const fs::path& target, DuplicateAction action) {
+    fs::path temp = target;
+    temp += ".afd-" + std::to_string(currentProcessId()) + ".tmp";
+
+    switch (action) {
+        case DuplicateAction::Hardlink:
+            fs::create_hard_link(source, temp);
+            break;
+        case DuplicateAction::Symlink:
+            fs::create_symlink(fs::absolute(source), temp);
+            break;
+        case DuplicateAction::Reflink: {
+            cloneFile(source, temp);
+            // 克隆是新文件，沿用被替换文件的权限和修改时间
+            std::error_code ignored;
+            fs::permissions(temp, fs::status(target).permissions(), ignored);
+            fs::last_write_time(temp, fs::last_write_time(target), ignored);
+            break;
+        }
+        default:
+            throw std::logic_error("不支持的替换方式");
+    }
+
+    std::error_code ec;
+    fs::rename(temp, target, ec);
+    if (ec) {
+        std::error_code ignored;
+        fs::remove(temp, ignored);
+        throw fs::filesystem_error("替换文件失败", temp, target, ec);
+    }
+}
+
+// 机器可读的重复组报告格式
+enum class ReportFormat {
+    None,
+    Jsonl,  // 每组一行 JSON
+    Csv,    // 每个文件一行
+    Binary  // 定长字段加路径的二进制记录
+};
+
+inline const char* reportFormatName(ReportFormat format) {
+    switch (format) {
+        case ReportFormat::Jsonl: return "jsonl";
+        case ReportFormat::Csv: return "csv";
+        case ReportFormat::Binary: return "bin";
+        default: return "none";
+    }
+}
+
+inline bool parseReportFormat(const std::string& name, ReportFormat& format) {
+    if (name == "jsonl") {
+        format = ReportFormat::Jsonl;
+    } else if (name == "csv") {
+        format = ReportFormat::Csv;
+    } else if (name == "bin") {
+        format = ReportFormat::Binary;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// 分块索引：收集各文件的分块指纹，扫描结束后统计共享大量分块的文件对和块级去重可节省的空间。
+// 内容完全相同的文件只索引一份 (它们已由精确比较处理)，同一分块出现在太多文件中时 (如全零块)
+// 只计入唯一数据量，不展开成文件对
+class ChunkIndex {
+public:
+    // 共享分块的文件对，sharedBytes 为两者共有的分块总长 (各分块按一次计)
+    struct SharedPair {
+        uint32_t first;
+        uint32_t second;
+        uint64_t sharedBytes;
+    };
+
+    struct Summary {
+        uint64_t files = 0;        // 参与分析的不同内容的文件数
+        uint64_t copies = 0;       // 与已索引文件内容完全相同、未重复计入的文件数
+        uint64_t bytes = 0;        // 参与分析的文件总大小
+        uint64_t chunks = 0;
+        uint64_t uniqueBytes = 0;  // 去掉重复分块后的数据量
+        std::vector<SharedPair> pairs;
+    };
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint32_t file;
+        uint32_t length;
+    };
+
+    static constexpr size_t kMaxPairFanout = 32;
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+    std::unordered_map<uint32_t, uint64_t> fileSizes;  // 已读取的文件 (含内容相同的)
+    std::map<std::tuple<uint64_t, uint64_t, uint64_t>, uint32_t> contents;
+    uint64_t copies = 0;
+
+public:
+    void add(uint32_t file, uint64_t size, const Digest128& digest, const std::vector<ContentChunker::Chunk>& chunks) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fileSizes.emplace(file, size).second) {
+            return;
+        }
+        if (!contents.emplace(std::make_tuple(size, digest.hi, digest.lo), file).second) {
+            copies++;
+            return;
+        }
+        for (const auto& chunk : chunks) {
+            entries.push_back({chunk.hash, file, chunk.length});
+        }
+    }
+
+    bool contains(uint32_t file) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return fileSizes.count(file) > 0;
+    }
+
+    // 共享分块总长不少于较小文件一半的文件对按共享量从大到小返回；分析后释放索引
+    Summary analyze() {
+        std::lock_guard<std::mutex> lock(mutex);
+        Summary summary;
+        summary.files = contents.size();
+        summary.copies = copies;
+        for (const auto& content : contents) {
+            summary.bytes += std::get<0>(content.first);
+        }
+        summary.chunks = entries.size();
+
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return std::tie(a.hash, a.file) < std::tie(b.hash, b.file);
+        });
+        std::unordered_map<uint64_t, uint64_t> shared;
+        std::vector<uint32_t> holders;
+        for (size_t begin = 0; begin < entries.size();) {
+            size_t end = begin + 1;
+            while (end < entries.size() && entries[end].hash == entries[begin].hash) {
+                ++end;
+            }
+            summary.uniqueBytes += entries[begin].length;
+            holders.clear();
+            for (size_t k = begin; k < end; ++k) {
+                if (holders.empty() || holders.back() != entries[k].file) {
+                    holders.push_back(entries[k].file);
+                }
+            }
+            if (holders.size() > 1 && holders.size() <= kMaxPairFanout) {
+                for (size_t a = 0; a < holders.size(); ++a) {
+                    for (size_t b = a + 1; b < holders.size(); ++b) {
+                        shared[(static_cast<uint64_t>(holders[a]) << 32) | holders[b]] += entries[begin].length;
+                    }
+                }
+            }
+            begin = end;
+        }
+        entries = std::vector<Entry>();
+
+        for (const auto& pair : shared) {
+            uint32_t first = static_cast<uint32_t>(pair.first >> 32);
+            uint32_t second = static_cast<uint32_t>(pair.first);
+            if (pair.second * 2 >= std::min(fileSizes[first], fileSizes[second])) {
+                summary.pairs.push_back({first, second, pair.second});
+            }
+        }
+        std::sort(summary.pairs.begin(), summary.pairs.end(), [](const SharedPair& a, const SharedPair& b) {
+            if (a.sharedBytes != b.sharedBytes) return a.sharedBytes > b.sharedBytes;
+            return std::tie(a.first, a.second) < std::tie(b.first, b.second);
+        });
+        return summary;
+    }
+};
+
+// 报告中的路径一律为 UTF-8
+inline std::string pathToUtf8(const fs::path& path) {
+#ifdef __cpp_char8_t
+    auto text = path.u8string();
+    return std::string(text.begin(), text.end());
+#else
+    return path.u8string();
+#endif
+}
+
+inline fs::path utf8ToPath(const std::string& text) {
+#ifdef __cpp_char8_t
+    return fs::path(std::u8string(text.begin(), text.end()));
+#else
+    return fs::u8path(text);
+#endif
+}
+
+// 文件身份的文本形式：16 位十六进制卷号、'-'、32 位十六进制文件 ID；没有身份时为空
+inline std::string formatFileId(const FileMeta& meta) {
+    if (!meta.hasIdentity()) {
+        return std::string();
+    }
+    char text[50];
+    std::snprintf(text, sizeof(text), "%016llx-%016llx%016llx", static_cast<unsigned long long>(meta.volume),
+                  static_cast<unsigned long long>(meta.fileId[1]), static_cast<unsigned long long>(meta.fileId[0]));
+    return text;
+}
+
+inline bool parseFileId(const std::string& text, FileMeta& meta) {
+    if (text.size() != 49 || text[16] != '-') {
+        return false;
+    }
+    try {
+        size_t consumed = 0;
+        meta.volume = std::stoull(text.substr(0, 16), &consumed, 16);
+        meta.fileId[1] = std::stoull(text.substr(17, 16), &consumed, 16);
+        meta.fileId[0] = std::stoull(text.substr(33, 16), &consumed, 16);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+// 重复组报告：每确认一组就追加到缓冲区，缓冲区超过 kFlushBytes 或结束时才写入文件，
+// 可由多个比较线程同时调用；组号按写入顺序从 1 开始。
+// bin 格式为 "AFDR" 文件头 (magic, version) 后接各组记录，整数均为小端：
+//   u32 文件数, u32 标志 (1 = 有内容摘要), u64 文件大小, u64 摘要低位, u64 摘要高位，
+//   之后每个文件 u32 文件下标, u32 路径字节数, i64 修改时间 (纳秒), u64 卷号, u64 文件 ID 低位,
+//   u64 文件 ID 高位 (没有身份时均为 0), UTF-8 路径
+// 分布式模式的报告给每个文件加上所在节点：jsonl 的 "node" 字段、csv 的 node 列；bin 格式不支持。
+// 只按全文摘要确认、没有逐字节比较的组 (跨节点的组) 在 jsonl 中带 "verified":"hash"，csv 的 verified 列为 hash
+class DuplicateReportWriter {
+private:
+    static constexpr uint32_t kMagic = 0x52444641;  // "AFDR"
+    static constexpr uint32_t kVersion = 2;
+    static constexpr uint32_t kHasDigest = 1;
+    static constexpr size_t kFlushBytes = 1 << 20;
+
+    ReportFormat format;
+    fs::path reportPath;
+    std::vector<std::string> nodeNames;  // 非空时为分布式报告
+    std::ofstream out;
+    std::string buffer;
+    std::mutex mutex;
+    uint64_t groups = 0;
+    uint64_t files = 0;
+    uint64_t reclaimable = 0;
+
+    template <typename T>
+    void appendRaw(const T& value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void appendJsonString(const std::string& text) {
+        buffer += '"';
+        for (unsigned char ch : text) {
+            if (ch == '"' || ch == '\\') {
+                buffer += '\\';
+                buffer += static_cast<char>(ch);
+            } else if (ch < 0x20) {
+                char escaped[7];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+                buffer += escaped;
+            } else {
+                buffer += static_cast<char>(ch);
+            }
+        }
+        buffer += '"';
+    }
+
+    void appendCsvField(const std::string& text) {
+        buffer += '"';
+        for (char ch : text) {
+            if (ch == '"') {
+                buffer += '"';
+            }
+            buffer += ch;
+        }
+        buffer += '"';
+    }
+
+    void flushLocked() {
+        if (!buffer.empty() && !out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+            throw std::runtime_error("写入报告失败: " + reportPath.string());
+        }
+        buffer.clear();
+    }
+
+public:
+    // 报告中的一个文件；本机报告的 node 不使用
+    struct ReportedFile {
+        uint32_t node;
+        uint32_t index;
+        std::string path;
+        FileMeta meta;
+    };
+
+    DuplicateReportWriter(ReportFormat format, const fs::path& path, std::vector<std::string> nodes = {})
+        : format(format), reportPath(path), nodeNames(std::move(nodes)),
+          out(path, std::ios::binary | std::ios::trunc) {
+        if (!out) {
+            throw std::runtime_error("无法创建报告文件: " + path.string());
+        }
+        if (format == ReportFormat::Binary && !nodeNames.empty()) {
+            throw std::invalid_argument("分布式模式的报告不支持 bin 格式");
+        }
+        buffer.reserve(kFlushBytes + kFlushBytes / 4);
+        if (format == ReportFormat::Csv) {
+            buffer += nodeNames.empty() ? "group,index,size,mtime_ns,hash,file_id,path\n"
+                                        : "group,node,index,size,mtime_ns,hash,verified,file_id,path\n";
+        } else if (format == ReportFormat::Binary) {
+            appendRaw(kMagic);
+            appendRaw(kVersion);
+        }
+    }
+
+    ~DuplicateReportWriter() {
+        try {
+            finish();
+        } catch (const std::exception&) {
+            // 析构时无法报告错误，正常流程由 finish() 报告
+        }
+    }
+
+    DuplicateReportWriter(const DuplicateReportWriter&) = delete;
+    DuplicateReportWriter& operator=(const DuplicateReportWriter&) = delete;
+
+    // 写入一个确认的重复组；digest 为空表示比较方式没有计算全文摘要 (如 pairwise)。
+    // 路径写成绝对路径，报告可以在其他目录下交给 --apply
+    void write(const FileTable& table, const FileGroup& group, const std::optional<Digest128>& digest) {
+        std::vector<ReportedFile> reported;
+        reported.reserve(group.size());
+        for (uint32_t file : group) {
+            reported.push_back({0, file, pathToUtf8(fs::absolute(table.path(file))), table.meta(file)});
+        }
+        write(table.size(group[0]), reported, digest);
+    }
+
+    // 写入一个由各文件的路径和元数据给出的重复组，分布式模式下文件不在本机的文件表中；
+    // hashOnly 表示该组只按全文摘要确认
+    void write(uintmax_t size, const std::vector<ReportedFile>& group, const std::optional<Digest128>& digest,
+               bool hashOnly = false) {
+        std::string hash = digest ? digest->toHex() : std::string();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t id = ++groups;
+        files += group.size();
+        reclaimable += size * (group.size() - 1);
+
+        if (format == ReportFormat::Jsonl) {
+            buffer += "{\"group\":" + std::to_string(id) + ",\"size\":" + std::to_string(size) + ",\"hash\":";
+            buffer += digest ? "\"" + hash + "\"" : std::string("null");
+            if (hashOnly) {
+                buffer += ",\"verified\":\"hash\"";
+            }
+            buffer += ",\"files\":[";
+            for (size_t i = 0; i < group.size(); ++i) {
+                const ReportedFile& file = group[i];
+                buffer += i ? ",{" : "{";
+                if (!nodeNames.empty()) {
+                    buffer += "\"node\":";
+                    appendJsonString(nodeNames[file.node]);
+                    buffer += ',';
+                }
+                buffer += "\"index\":" + std::to_string(file.index) + ",\"mtime\":" + std::to_string(file.meta.mtimeNs);
+                std::string fileId = formatFileId(file.meta);
+                if (!fileId.empty()) {
+                    buffer += ",\"fileId\":\"" + fileId + '"';
+                }
+                buffer += ",\"path\":";
+                appendJsonString(file.path);
+                buffer += '}';
+            }
+            buffer += "]}\n";
+        } else if (format == ReportFormat::Csv) {
+            for (const ReportedFile& file : group) {
+                buffer += std::to_string(id) + ',';
+                if (!nodeNames.empty()) {
+                    appendCsvField(nodeNames[file.node]);
+                    buffer += ',';
+                }
+                buffer += std::to_string(file.index) + ',' + std::to_string(size) + ',' +
+                          std::to_string(file.meta.mtimeNs) + ',' + hash + ',';
+                if (!nodeNames.empty()) {
+                    buffer += hashOnly ? "hash," : "bytes,";
+                }
+                buffer += formatFileId(file.meta) + ',';
+                appendCsvField(file.path);
+                buffer += '\n';
+            }
+        } else {
+            Digest128 value = digest ? *digest : Digest128();
+            appendRaw(static_cast<uint32_t>(group.size()));
+            appendRaw(digest ? kHasDigest : uint32_t(0));
+            appendRaw(static_cast<uint64_t>(size));
+            appendRaw(value.lo);
+            appendRaw(value.hi);
+            for (const ReportedFile& file : group) {
+                appendRaw(file.index);
+                appendRaw(static_cast<uint32_t>(file.path.size()));
+                appendRaw(file.meta.mtimeNs);
+                appendRaw(file.meta.volume);
+                appendRaw(file.meta.fileId[0]);
+                appendRaw(file.meta.fileId[1]);
+                buffer += file.path;
+            }
+        }
+
+        if (buffer.size() >= kFlushBytes) {
+            flushLocked();
+        }
+    }
+
+    // 写出剩余缓冲并刷新文件，可重复调用
+    void finish() {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushLocked();
+        if (!out.flush()) {
+            throw std::runtime_error("写入报告失败: " + reportPath.string());
+        }
+    }
+
+    const fs::path& path() const { return reportPath; }
+    uint64_t groupCount() const { return groups; }
+    uint64_t fileCount() const { return files; }
+    uint64_t reclaimableBytes() const { return reclaimable; }
+};
+
+// 读取保留方案用的最小 JSON 解析器：数字保留原文，由使用方按需要的类型转换 (纳秒时间戳超出 double 精度)
+struct JsonValue {
+    enum class Type { Null, Boolean, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    std::string text;  // 字符串内容或数字原文
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& member : members) {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class JsonParser {
+private:
+    const std::string& input;
+    size_t position = 0;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error(message + " (第 " + std::to_string(position + 1) + " 个字符)");
+    }
+
+    void skipSpace() {
+        while (position < input.size() && std::isspace(static_cast<unsigned char>(input[position]))) {
+            ++position;
+        }
+    }
+
+    bool consume(char expected) {
+        skipSpace();
+        if (position < input.size() && input[position] == expected) {
+            ++position;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char expected) {
+        if (!consume(expected)) {
+            fail(std::string("应为 '") + expected + "'");
+        }
+    }
+
+    void appendUtf8(uint32_t codepoint, std::string& out) {
+        if (codepoint < 0x80) {
+            out += static_cast<char>(codepoint);
+        } else if (codepoint < 0x800) {
+            out += static_cast<char>(0xC0 | (codepoint >> 6));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else if (codepoint < 0x10000) {
+            out += static_cast<char>(0xE0 | (codepoint >> 12));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (codepoint >> 18));
+            out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        }
+    }
+
+    uint32_t parseHex4() {
+        if (position + 4 > input.size()) {
+            fail("\\u 转义不完整");
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            char ch = input[position++];
+            value <<= 4;
+            if (ch >= '0' && ch <= '9') {
+                value |= ch - '0';
+            } else if (ch >= 'a' && ch <= 'f') {
+                value |= ch - 'a' + 10;
+            } else if (ch >= 'A' && ch <= 'F') {
+                value |= ch - 'A' + 10;
+            } else {
+                fail("无效的 \\u 转义");
+            }
+        }
+        return value;
+    }
+
+    std::string parseString() {
+        expect('"');
+        std::string out;
+        while (position < input.size() && input[position] != '"') {
+            char ch = input[position++];
+            if (ch != '\\') {
+                out += ch;
+                continue;
+            }
+            if (position >= input.size()) {
+                break;
+            }
+            char escape = input[position++];
+            switch (escape) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t codepoint = parseHex4();
+                    if (codepoint >= 0xD800 && codepoint < 0xDC00 && input.compare(position, 2, "\\u") == 0) {
+                        position += 2;
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (parseHex4() - 0xDC00);
+                    }
+                    appendUtf8(codepoint, out);
+                    break;
+                }
+                default: fail("无效的转义字符");
+            }
+        }
+        if (position >= input.size()) {
+            fail("字符串没有结束");
+        }
+        ++position;
+        return out;
+    }
+
+    JsonValue parseValue() {
+        skipSpace();
+        if (position >= input.size()) {
+            fail("内容不完整");
+        }
+        JsonValue value;
+        char ch = input[position];
+        if (ch == '{') {
+            value.type = JsonValue::Type::Object;
+            ++position;
+            if (!consume('}')) {
+                do {
+                    skipSpace();
+                    std::string key = parseString();
+                    expect(':');
+                    value.members.emplace_back(std::move(key), parseValue());
+                } while (consume(','));
+                expect('}');
+            }
+        } else if (ch == '[') {
+            value.type = JsonValue::Type::Array;
+            ++position;
+            if (!consume(']')) {
+                do {
+                    value.items.push_back(parseValue());
+                } while (consume(','));
+                expect(']');
+            }
+        } else if (ch == '"') {
+            value.type = JsonValue::Type::String;
+            value.text = parseString();
+        } else if (input.compare(position, 4, "true") == 0 || input.compare(position, 5, "false") == 0) {
+            value.type = JsonValue::Type::Boolean;
+            value.boolean = ch == 't';
+            position += value.boolean ? 4 : 5;
+        } else if (input.compare(position, 4, "null") == 0) {
+            position += 4;
+        } else if (ch == '-' || std::isdigit(static_cast<unsigned char>(ch))) {
+            value.type = JsonValue::Type::Number;
+            size_t begin = position++;
+            while (position < input.size() && std::strchr("0123456789+-.eE", input[position])) {
+                ++position;
+            }
+            value.text = input.substr(begin, position - begin);
+        } else {
+            fail("无法识别的值");
+        }
+        return value;
+    }
+
+public:
+    explicit JsonParser(const std::string& text) : input(text) {}
+
+    // 解析整个输入，之后只允许空白
+    JsonValue parse() {
+        JsonValue value = parseValue();
+        skipSpace();
+        if (position != input.size()) {
+            fail("值之后有多余内容");
+        }
+        return value;
+    }
+};
+
+// 全局检测的断点日志 (--journal)：只追加的二进制文件，依次记录文件表、各轮抽样签名、小文件的全文摘要和
+// 精确比较的结果。每条记录为 u64 负载长度、u8 类型、负载和负载的 64 位校验，恢复时从第一条不完整或校验不符的
+// 记录起全部丢弃并截掉；记录边检测边写入，每隔 kFlushInterval 以及每轮抽样和每个阶段结束时刷新到文件。
+// --resume 读入已有的记录：文件表直接取自日志，已有签名、摘要或比较结果的文件不再读取；
+// 根目录或抽样参数不同时不恢复，重新开始
+class ScanJournal {
+public:
+    struct Verified {
+        std::vector<FileGroup> groups;
+        std::vector<std::optional<Digest128>> digests;  // 与 groups 对齐，没有报告时不记录摘要
+    };
+
+private:
+    static constexpr uint32_t kMagic = 0x4A444641;  // "AFDJ"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr auto kFlushInterval = std::chrono::seconds(10);
+
+    enum class RecordType : uint8_t {
+        Header = 1,      // u32 版本, 根目录, u64 抽样点数, u64 抽样块大小
+        Table = 2,       // 文件表 (FileTable::save)
+        Signatures = 3,  // u32 轮次, 文件下标数组, 签名数组
+        Digests = 4,     // 文件下标数组, 全文摘要数组
+        Verified = 5     // 候选组下标列表, u32 重复组数, 每组下标列表, u8 是否有摘要, 摘要
+    };
+
+    fs::path path;
+    std::ofstream out;
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point lastFlush = std::chrono::steady_clock::now();
+    bool resumedRun = false;
+    size_t restoredRecords = 0;
+
+    // 恢复的内容在构造后只读，检测线程查询时不加锁
+    std::optional<FileTable> table;
+    std::unordered_map<uint32_t, std::unordered_map<uint32_t, FileSignature>> signatures;  // 轮次 → 文件 → 签名
+    std::unordered_map<uint32_t, Digest128> digests;
+    std::unordered_map<uint32_t, std::pair<FileGroup, Verified>> verified;  // 候选组首个文件 → (候选组, 结果)
+
+    void writeRecord(RecordType type, const std::string& payload) {
+        uint64_t length = payload.size();
+        uint64_t check = hashing::hash128(payload.data(), payload.size()).lo ^ static_cast<uint64_t>(type);
+        char tag = static_cast<char>(type);
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(&tag, 1);
+        out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        out.write(reinterpret_cast<const char*>(&check), sizeof(check));
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastFlush >= kFlushInterval) {
+            out.flush();
+            lastFlush = now;
+        }
+        if (!out) {
+            throw std::runtime_error("写入断点日志失败: " + path.string());
+        }
+    }
+
+    void apply(RecordType type, const std::string& payload) {
+        WireReader in(payload);
+        switch (type) {
+            case RecordType::Table: {
+                FileTable loaded;
+                loaded.load(in);
+                table = std::move(loaded);
+                signatures.clear();
+                digests.clear();
+                verified.clear();
+                break;
+            }
+            case RecordType::Signatures: {
+                uint32_t round = in.get<uint32_t>();
+                auto files = in.getArray<uint32_t>();
+                auto values = in.getArray<FileSignature>();
+                if (files.size() != values.size()) {
+                    throw std::runtime_error("签名记录不一致");
+                }
+                auto& known = signatures[round];
+                for (size_t i = 0; i < files.size(); ++i) {
+                    known[files[i]] = values[i];
+                }
+                break;
+            }
+            case RecordType::Digests: {
+                auto files = in.getArray<uint32_t>();
+                auto values = in.getArray<Digest128>();
+                if (files.size() != values.size()) {
+                    throw std::runtime_error("摘要记录不一致");
+                }
+                for (size_t i = 0; i < files.size(); ++i) {
+                    digests[files[i]] = values[i];
+                }
+                break;
+            }
+            case RecordType::Verified: {
+                FileGroup candidates = in.getRefs();
+                std::set<uint32_t> members(candidates.begin(), candidates.end());
+                Verified result;
+                uint32_t count = in.get<uint32_t>();
+                for (uint32_t g = 0; g < count; ++g) {
+                    result.groups.push_back(in.getRefs());
+                    for (uint32_t file : result.groups.back()) {
+                        if (!members.count(file)) {
+                            throw std::runtime_error("比较结果记录不一致");
+                        }
+                    }
+                    result.digests.push_back(std::nullopt);
+                    if (in.get<uint8_t>()) {
+                        result.digests.back() = in.get<Digest128>();
+                    }
+                }
+                if (candidates.empty()) {
+                    throw std::runtime_error("比较结果记录不一致");
+                }
+                uint32_t first = candidates[0];
+                verified[first] = {std::move(candidates), std::move(result)};
+                break;
+            }
+            default:
+                throw std::runtime_error("未知的日志记录");
+        }
+        if (!in.done()) {
+            throw std::runtime_error("日志记录长度不符");
+        }
+    }
+
+    // 读入已有日志，返回有效内容的长度；不存在、格式不符或头部 (根目录、抽样参数) 不同时返回 0
+    uint64_t restore(const std::string& header) {
+        std::error_code ec;
+        uint64_t fileSize = fs::file_size(path, ec);
+        std::ifstream in(path, std::ios::binary);
+        uint32_t magic = 0;
+        if (ec || !in || !in.read(reinterpret_cast<char*>(&magic), sizeof(magic)) || magic != kMagic) {
+            return 0;
+        }
+
+        uint64_t valid = sizeof(magic);
+        bool headerMatched = false;
+        std::string payload;
+        for (;;) {
+            uint64_t length = 0;
+            uint64_t check = 0;
+            char tag = 0;
+            if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)) || !in.read(&tag, 1) ||
+                length > fileSize - valid) {
+                break;
+            }
+            payload.resize(static_cast<size_t>(length));
+            if (!in.read(&payload[0], static_cast<std::streamsize>(length)) ||
+                !in.read(reinterpret_cast<char*>(&check), sizeof(check)) ||
+                check != (hashing::hash128(payload.data(), payload.size()).lo ^ static_cast<uint8_t>(tag))) {
+                break;
+            }
+            RecordType type = static_cast<RecordType>(static_cast<uint8_t>(tag));
+            if (!headerMatched) {
+                if (type != RecordType::Header || payload != header) {
+                    return 0;
+                }
+                headerMatched = true;
+            } else {
+                try {
+                    apply(type, payload);
+                } catch (const std::exception&) {
+                    break;
+                }
+                ++restoredRecords;
+            }
+            valid += sizeof(length) + 1 + length + sizeof(check);
+        }
+        return headerMatched ? valid : 0;
+    }
+
+public:
+    ScanJournal(const fs::path& journalPath, const fs::path& root, size_t samplePoints, size_t sampleSize, bool resume)
+        : path(journalPath) {
+        WireWriter header;
+        header.put(kVersion);
+        header.putString(pathToUtf8(fs::absolute(root).lexically_normal()));
+        header.put(static_cast<uint64_t>(samplePoints));
+        header.put(static_cast<uint64_t>(sampleSize));
+
+        uint64_t valid = resume ? restore(header.data) : 0;
+        if (valid > 0) {
+            std::error_code ec;
+            fs::resize_file(path, valid, ec);  // 截掉末尾不完整的记录
+            out.open(path, std::ios::binary | std::ios::app);
+            resumedRun = !ec;
+        }
+        if (!resumedRun) {
+            table.reset();
+            signatures.clear();
+            digests.clear();
+            verified.clear();
+            restoredRecords = 0;
+            out.close();
+            out.clear();
+            out.open(path, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&kMagic), sizeof(kMagic));
+            writeRecord(RecordType::Header, header.data);
+            out.flush();
+        }
+        if (!out) {
+            throw std::runtime_error("无法写入断点日志: " + path.string());
+        }
+    }
+
+    bool resumed() const {
+        return resumedRun;
+    }
+
+    size_t restoredRecordCount() const {
+        return restoredRecords;
+    }
+
+    const fs::path& filePath() const {
+        return path;
+    }
+
+    // 取出日志中的文件表；没有记录 (上次在枚举期间中断) 时返回 false
+    bool takeTable(FileTable& files) {
+        if (!table) {
+            return false;
+        }
+        files = std::move(*table);
+        table.reset();
+        return true;
+    }
+
+    // 日志可能是很久以前写的：恢复文件表后重新读取抽样签名、摘要和比较结果涉及的每个文件的元数据，大小、修改时间或
+    // 文件 ID 与文件表不符或已无法访问的文件丢弃其各轮签名和摘要，并从记录的重复组中去掉 (不足 2 个的组整组去掉)，
+    // 之后按普通文件重新读取。返回丢弃的文件数
+    size_t revalidate(const FileTable& files, size_t threadCount) {
+        std::vector<uint32_t> referenced;
+        for (const auto& round : signatures) {
+            for (const auto& entry : round.second) {
+                referenced.push_back(entry.first);
+            }
+        }
+        for (const auto& entry : digests) {
+            referenced.push_back(entry.first);
+        }
+        for (const auto& entry : verified) {
+            for (const auto& group : entry.second.second.groups) {
+                referenced.insert(referenced.end(), group.begin(), group.end());
+            }
+        }
+        std::sort(referenced.begin(), referenced.end());
+        referenced.erase(std::unique(referenced.begin(), referenced.end()), referenced.end());
+
+        std::vector<char> changed(referenced.size(), 0);
+        WorkerPool(threadCount).parallelFor(referenced.size(), [&](size_t i) {
+            uint32_t file = referenced[i];
+            if (file >= files.fileCount()) {
+                changed[i] = 1;
+                return;
+            }
+            try {
+                changed[i] = metaChangeReason(files.meta(file), statFileMeta(files.path(file))) != nullptr;
+            } catch (const std::exception&) {
+                changed[i] = 1;
+            }
+        });
+        std::set<uint32_t> stale;
+        for (size_t i = 0; i < referenced.size(); ++i) {
+            if (changed[i]) {
+                stale.insert(referenced[i]);
+            }
+        }
+        if (stale.empty()) {
+            return 0;
+        }
+
+        for (uint32_t file : stale) {
+            for (auto& round : signatures) {
+                round.second.erase(file);
+            }
+            digests.erase(file);
+        }
+        for (auto& entry : verified) {
+            Verified& result = entry.second.second;
+            Verified kept;
+            for (size_t g = 0; g < result.groups.size(); ++g) {
+                FileGroup group;
+                for (uint32_t file : result.groups[g]) {
+                    if (!stale.count(file)) {
+                        group.push_back(file);
+                    }
+                }
+                if (group.size() > 1) {
+                    kept.groups.push_back(std::move(group));
+                    kept.digests.push_back(result.digests[g]);
+                }
+            }
+            result = std::move(kept);
+        }
+        return stale.size();
+    }
+
+    void recordTable(const FileTable& files) {
+        WireWriter payload;
+        files.save(payload);
+        std::lock_guard<std::mutex> lock(mutex);
+        writeRecord(RecordType::Table, payload.data);
+        out.flush();
+    }
+
+    // 上次运行算出的第 round 轮签名；没有时返回 nullptr
+    const std::unordered_map<uint32_t, FileSignature>* knownSignatures(uint32_t round) const {
+        auto found = signatures.find(round);
+        return found == signatures.end() ? nullptr : &found->second;
+    }
+
+    void recordSignatures(uint32_t round, const std::vector<uint32_t>& files, const std::vector<FileSignature>& values) {
+        if (files.empty()) {
+            return;
+        }
+        WireWriter payload;
+        payload.put(round);
+        payload.putArray(files.data(), files.size());
+        payload.putArray(values.data(), values.size());
+        std::lock_guard<std::mutex> lock(mutex);
+        writeRecord(RecordType::Signatures, payload.data);
+    }
+
+    const Digest128* knownDigest(uint32_t file) const {
+        auto found = digests.find(file);
+        return found == digests.end() ? nullptr : &found->second;
+    }
+
+    void recordDigests(const std::vector<uint32_t>& files, const std::vector<Digest128>& values) {
+        if (files.empty()) {
+            return;
+        }
+        WireWriter payload;
+        payload.putArray(files.data(), files.size());
+        payload.putArray(values.data(), values.size());
+        std::lock_guard<std::mutex> lock(mutex);
+        writeRecord(RecordType::Digests, payload.data);
+    }
+
+    // 成员完全相同的候选组上次的比较结果；没有时返回 nullptr
+    const Verified* knownVerified(const FileGroup& candidates) const {
+        auto found = verified.find(candidates[0]);
+        if (found == verified.end() || found->second.first != candidates) {
+            return nullptr;
+        }
+        return &found->second.second;
+    }
+
+    void recordVerified(const FileGroup& candidates, const Verified& result) {
+        WireWriter payload;
+        payload.putRefs(candidates);
+        payload.put(static_cast<uint32_t>(result.groups.size()));
+        for (size_t g = 0; g < result.groups.size(); ++g) {
+            payload.putRefs(result.groups[g]);
+            bool hasDigest = g < result.digests.size() && result.digests[g];
+            payload.put(static_cast<uint8_t>(hasDigest));
+            if (hasDigest) {
+                payload.put(*result.digests[g]);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        writeRecord(RecordType::Verified, payload.data);
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.flush();
+        lastFlush = std::chrono::steady_clock::now();
+    }
+
+    // 检测正常结束后删除日志，下次运行重新开始
+    void discard() {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.close();
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+};
+
+// 去重器配置，由命令行参数填充
+struct DeduplicatorOptions {
+    bool dryRun = false;
+    bool verbose = false;
+    bool autoConfirm = false;
+    bool skipEmptyFolders = true;
+    size_t samplePoints = 4;
+    size_t sampleSize = 4096;
+    std::string mode = "all";  // 默认全局模式
+    size_t threadCount = 1;
+    std::string verifyMode = "lockstep";
+    IoBackend ioBackend = IoBackend::Stream;
+    std::string cachePath;  // 空表示不使用签名缓存，"auto" 表示默认位置
+    std::string scanMode = "dir";  // dir = 目录遍历，mft = 直接枚举 NTFS 主文件表
+    bool incrementalScan = false;  // MFT 模式下用 USN 日志做增量扫描
+    bool pipeline = false;         // 全局模式下枚举、抽样、精确比较重叠进行
+    size_t memoryLimit = 0;        // 分组排序缓冲的上限（字节），0 表示全部在内存中进行；不限制文件表和候选组
+    std::string ioSchedule = "none";  // none = 按大小组顺序，physical = 按物理位置排序抽样读取
+    size_t queueDepth = 0;             // 同时进行的读取数，0 表示线程调度 4、异步引擎 32
+    DuplicateAction action = DuplicateAction::Delete;
+    bool printStats = false;     // 结束时打印分阶段统计表
+    std::string statsJsonPath;   // 非空时把分阶段统计写成 JSON，"-" 表示标准输出
+    ReportFormat reportFormat = ReportFormat::None;  // 非 None 时确认的重复组写入报告，不展示也不处理
+    std::string reportPath;      // 空表示当前目录下的 duplicates.<格式>
+    bool recheckPlan = false;    // --apply 时重新计算抽样签名核对内容
+    bool chunkIndex = false;     // 全局模式下建立内容定义分块索引，报告部分重复的文件
+    size_t chunkSize = 16 * 1024;  // 分块的平均长度 (2 的幂)
+    size_t minFileSize = 0;        // 小于此大小的文件不参与检测
+    std::string workOrder = "size";  // size = 按大小从小到大，reclaimable = 按可节省空间从大到小
+    size_t readBudget = 0;         // 抽样和精确比较的读取量上限 (字节)，0 表示不限
+    uint64_t timeBudgetMs = 0;     // 总运行时间上限 (毫秒)，0 表示不限
+    bool showProgress = false;     // 显示实时状态行，不再逐批打印已扫描 / 已分析的文件数
+    std::string journalPath;       // 非空时全局检测写入断点日志
+    bool resume = false;           // 从断点日志继续上次中断的检测
+};
+
+class InteractiveFileDeduplicator {
+private:
+    bool dryRun;
+    bool verbose;
+    bool autoConfirm;
+    bool skipEmptyFolders;
+    size_t samplePoints;
+    size_t sampleSize;
+    std::string mode;
+    size_t threadCount;
+    std::string verifyMode;
+    IoBackend ioBackend;
+    std::string scanMode;
+    bool incrementalScan;
+    bool pipeline;
+    size_t memoryLimit;
+    std::string ioSchedule;
+    size_t queueDepth;
+    DuplicateAction action;
+    bool printStats;
+    std::string statsJsonPath;
+    bool recheckPlan;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::unique_ptr<SignatureCache> signatureCache;
+    std::unique_ptr<DuplicateReportWriter> reportWriter;
+    std::unique_ptr<ChunkIndex> chunkIndex;
+    size_t chunkSize;
+    size_t minFileSize;
+    std::string workOrder;
+    size_t readBudget;
+    std::chrono::milliseconds timeBudget;
+    bool budgetStops = false;  // 按预算调度的检测期间为 true，抽样在每批读取前检查预算
+    bool showProgress;
+    std::string journalPath;
+    bool resumeJournal;
+    std::unique_ptr<ScanJournal> journal;
+    std::mutex consoleMutex;
+
+    // 小文件快速路径确认的重复组：按编号排序的全部成员 → 全文摘要，精确比较时直接采用；
+    // 调用 refineBySampling 的一方比较结束后以 clearPrehashedGroups 清空
+    std::map<FileGroup, Digest128> prehashedGroups;
+    std::mutex prehashedMutex;
+
+    // hashSmallFiles 中摘要不是本次读取算出的文件的 valid 标记
+    static constexpr char kDigestRecalled = 2;
+
+    // 同步比较每轮读取的块大小，以及同时打开的文件数上限
+    static constexpr size_t kLockstepChunkSize = 256 * 1024;
+    static constexpr size_t kMaxLockstepFiles = 256;
+
+    // 渐进抽样的最大轮数；单轮读取量超过文件大小的 1/kFullReadFactor 时停止抽样，
+    // 不超过 kFullReadFactor 个抽样块大小的文件直接进入精确比较
+    static constexpr uint32_t kMaxSampleRounds = 6;
+    static_assert(kMaxSampleRounds <= SignatureCache::kCachedRounds, "签名缓存需要保存每一轮的签名");
+    static constexpr uintmax_t kFullReadFactor = 16;
+
+    // 按物理位置调度时每批排序的文件数（同时也是打开文件数的上限）
+    static constexpr size_t kScheduleBatchFiles = 512;
+
+    // 流水线模式各阶段之间队列的长度
+    static constexpr size_t kPipelineQueueLength = 4096;
+
+    // 按可节省空间排序时每批完成抽样和精确比较的文件数；有读取预算时每批只含一个大小组
+    static constexpr size_t kPriorityBatchFiles = 1024;
+
+    // 写断点日志时抽样和小文件整读每批的文件数，每批算完即写入一条记录
+    static constexpr size_t kJournalSliceFiles = 16384;
+
+    // 小文件快速路径每批读入缓冲区的字节数上限
+    static constexpr size_t kSmallBatchBytes = 4 << 20;
+
+    // 删除阶段每批并行处理的文件数
+    static constexpr size_t kDisposalBatchFiles = 1024;
+
+    // 并行单文件夹模式下检测最多领先展示的文件夹数
+    static constexpr size_t kFolderLookahead = 256;
+
+    // 并行检测各文件夹时，文件夹内部的抽样不再开线程
+    bool foldersInParallel = false;
+
+    // 各阶段读取的字节数
+    std::atomic<uint64_t> sampledBytes{0};
+    std::atomic<uint64_t> verifiedBytes{0};
+
+    struct DeduplicationResult {
+    FileTable files;
+    std::vector<FileGroup> duplicateGroups;
+    int totalFiles = 0;
+    uintmax_t totalSize = 0;
+    std::string error;
+    };
+
+    // 单个文件夹的检测结果及耗时，组内为共享文件表中的下标
+    struct FolderScan {
+        std::vector<FileGroup> duplicateGroups;
+        int totalFiles = 0;
+        uintmax_t totalSize = 0;
+        std::string error;
+        long long milliseconds = 0;
+    };
+
+    // 保留方案中的一个文件：方案记录的大小、修改时间和身份，核对通过后换成当前的元数据
+    struct PlannedFile {
+        fs::path path;
+        FileMeta meta;
+        bool keep = false;
+    };
+
+    // --recheck 使用的抽样轮次 (首尾块之外再取 samplePoints 个点)
+    static constexpr uint32_t kRecheckRound = 2;
+
+public:
+    explicit InteractiveFileDeduplicator(const DeduplicatorOptions& options = DeduplicatorOptions())
+        : dryRun(options.dryRun), verbose(options.verbose), autoConfirm(options.autoConfirm),
+          skipEmptyFolders(options.skipEmptyFolders), samplePoints(options.samplePoints),
+          sampleSize(options.sampleSize), mode(options.mode), threadCount(options.threadCount),
+          verifyMode(options.verifyMode), ioBackend(options.ioBackend), scanMode(options.scanMode),
+          incrementalScan(options.incrementalScan), pipeline(options.pipeline), memoryLimit(options.memoryLimit),
+          ioSchedule(options.ioSchedule), queueDepth(options.queueDepth), action(options.action),
+          printStats(options.printStats), statsJsonPath(options.statsJsonPath), recheckPlan(options.recheckPlan),
+          chunkSize(options.chunkSize), minFileSize(options.minFileSize), workOrder(options.workOrder),
+          readBudget(options.readBudget), timeBudget(options.timeBudgetMs), showProgress(options.showProgress),
+          journalPath(options.journalPath), resumeJournal(options.resume) {
+        if (!options.cachePath.empty()) {
+            fs::path path = options.cachePath == "auto" ? SignatureCache::defaultPath() : fs::path(options.cachePath);
+            signatureCache = std::make_unique<SignatureCache>(path, samplePoints, sampleSize);
+            if (signatureCache->load()) {
+                std::cout << "已加载签名缓存: " << path << " (" << signatureCache->size() << " 条记录)" << std::endl;
+            } else {
+                std::cout << "签名缓存不存在或已失效，将新建: " << path << std::endl;
+            }
+        }
+        if (options.reportFormat != ReportFormat::None) {
+            fs::path path = options.reportPath.empty()
+                                ? fs::path(std::string("duplicates.") + reportFormatName(options.reportFormat))
+                                : fs::path(options.reportPath);
+            reportWriter = std::make_unique<DuplicateReportWriter>(options.reportFormat, path);
+        }
+        if (options.chunkIndex) {
+            chunkIndex = std::make_unique<ChunkIndex>();
+        }
+    }
+
+    // 保存签名缓存并输出命中统计
+    void saveSignatureCache() {
+        if (!signatureCache) {
+            return;
+        }
+        std::cout << "签名缓存: 抽样命中 " << signatureCache->signatureHits
+                  << ", 全文命中 " << signatureCache->contentHits
+                  << ", 未命中 " << signatureCache->misses << std::endl;
+        try {
+            signatureCache->save();
+        } catch (const std::exception& e) {
+            std::cerr << "保存签名缓存失败: " << e.what() << std::endl;
+        }
+    }
+
+    // 写完报告并输出汇总
+    void finishReport() {
+        try {
+            reportWriter->finish();
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return;
+        }
+        std::cout << "\n报告已写入: " << reportWriter->path() << std::endl;
+        std::cout << "重复组: " << reportWriter->groupCount() << " 组, " << reportWriter->fileCount()
+                  << " 个文件, 可节省空间: " << formatFileSize(reportWriter->reclaimableBytes()) << std::endl;
+    }
+
+    // --stats 打印各阶段的统计表，--stats-json 写出同样内容的 JSON；总耗时包含等待用户输入的时间
+    void reportStats() {
+        if (!printStats && statsJsonPath.empty()) {
+            return;
+        }
+        double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        uint64_t peakMemory = processPeakMemory();
+        static const char* const labels[kPhaseCount] = {"枚举", "抽样", "精确比较", "删除"};
+
+        if (printStats) {
+            // 按显示宽度对齐，中文字符占两列
+            auto cell = [](const std::string& text, size_t width, bool left = false) {
+                size_t columns = 0;
+                for (unsigned char ch : text) {
+                    if ((ch & 0xC0) != 0x80) {
+                        columns += ch >= 0xE0 ? 2 : 1;
+                    }
+                }
+                std::string padding(columns < width ? width - columns : 0, ' ');
+                return left ? text + padding : padding + text;
+            };
+
+            std::cout << "\n" << std::string(100, '=') << std::endl;
+            std::cout << "性能统计" << std::endl;
+            std::cout << std::string(100, '=') << std::endl;
+            std::cout << cell("阶段", 10, true) << cell("耗时(ms)", 10) << cell("输入文件", 10) << cell("输出文件", 10)
+                      << cell("读取量", 12) << cell("打开", 9) << cell("定位", 9) << cell("读取", 10)
+                      << cell("缓存命中", 10) << cell("峰值内存", 12) << std::endl;
+            for (size_t i = 0; i < kPhaseCount; ++i) {
+                const PhaseProfiler::Counters& c = PhaseProfiler::counters(static_cast<Phase>(i));
+                char wall[32];
+                snprintf(wall, sizeof(wall), "%.1f", c.wallNs / 1e6);
+                std::cout << cell(labels[i], 10, true) << cell(wall, 10) << cell(std::to_string(c.filesIn), 10)
+                          << cell(std::to_string(c.filesOut), 10) << cell(formatFileSize(c.bytesRead), 12)
+                          << cell(std::to_string(c.opens), 9) << cell(std::to_string(c.seeks), 9)
+                          << cell(std::to_string(c.reads), 10) << cell(std::to_string(c.cacheHits), 10)
+                          << cell(formatFileSize(c.peakMemory), 12) << std::endl;
+            }
+            std::cout << std::string(100, '-') << std::endl;
+            char total[32];
+            snprintf(total, sizeof(total), "%.1f", totalMs);
+            std::cout << "总耗时: " << total << " ms, 峰值内存: " << formatFileSize(peakMemory) << std::endl;
+            std::cout << std::string(100, '=') << std::endl;
+        }
+
+        if (!statsJsonPath.empty()) {
+            std::ostringstream json;
+            json << std::fixed << std::setprecision(3);
+            json << "{\"version\":1,\"mode\":\"" << mode << "\",\"threads\":" << threadCount
+                 << ",\"io\":\"" << ioBackendName(ioBackend) << "\",\"verify\":\"" << verifyMode
+                 << "\",\"samplePoints\":" << samplePoints << ",\"sampleSize\":" << sampleSize
+                 << ",\"action\":\"" << duplicateActionName(action) << "\",\"dryRun\":" << (dryRun ? "true" : "false")
+                 << ",\"wallMs\":" << totalMs << ",\"peakMemoryBytes\":" << peakMemory << ",\"phases\":[";
+            for (size_t i = 0; i < kPhaseCount; ++i) {
+                const PhaseProfiler::Counters& c = PhaseProfiler::counters(static_cast<Phase>(i));
+                json << (i ? "," : "") << "{\"name\":\"" << phaseName(static_cast<Phase>(i))
+                     << "\",\"wallMs\":" << c.wallNs / 1e6 << ",\"filesIn\":" << c.filesIn
+                     << ",\"filesOut\":" << c.filesOut << ",\"bytesRead\":" << c.bytesRead
+                     << ",\"opens\":" << c.opens << ",\"seeks\":" << c.seeks << ",\"reads\":" << c.reads
+                     << ",\"cacheHits\":" << c.cacheHits << ",\"peakMemoryBytes\":" << c.peakMemory << "}";
+            }
+            json << "]}\n";
+
+            if (statsJsonPath == "-") {
+                std::cout << json.str() << std::flush;
+            } else {
+                std::ofstream out(statsJsonPath, std::ios::binary | std::ios::trunc);
+                out << json.str();
+                if (!out) {
+                    std::cerr << "写入统计文件失败: " << statsJsonPath << std::endl;
+                } else {
+                    std::cout << "统计已写入: " << statsJsonPath << std::endl;
+                }
+            }
+        }
+    }
+
+    // 获取文件大小
+    uintmax_t getFileSize(const fs::path& filepath) {
+        return fs::file_size(filepath);
+    }
+
+    // 格式化文件大小
+    std::string formatFileSize(uintmax_t size) {
+        const char* units[] = {"B", "KB", "MB", "GB"};
+        int unitIndex = 0;
+        double sizeValue = static_cast<double>(size);
+        
+        while (sizeValue >= 1024.0 && unitIndex < 3) {
+            sizeValue /= 1024.0;
+            unitIndex++;
+        }
+        
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.2f %s", sizeValue, units[unitIndex]);
+        return buffer;
+    }
+
+    // 格式化文件修改时间 (自 1970-01-01 起的纳秒数，取自文件表，不再访问文件)
+    std::string getFileTimeString(int64_t mtimeNs) {
+        int64_t seconds = mtimeNs / 1000000000LL;
+        if (mtimeNs < 0 && seconds * 1000000000LL != mtimeNs) {
+            seconds--;
+        }
+        std::time_t time = static_cast<std::time_t>(seconds);
+        
+        char buffer[64];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", std::localtime(&time));
+        return buffer;
+    }
+
+    // 第 round 轮抽样的读取计划 (偏移, 长度)，返回空表示该大小的文件不再抽样
+    // 第 1 轮只读首尾各一块；第 2 轮在内部均匀取 samplePoints 块；
+    // 之后每轮块数和块大小都翻倍，大文件因此比小文件多走几轮
+    std::vector<std::pair<uintmax_t, size_t>> samplePlan(uintmax_t size, uint32_t round) const {
+        std::vector<std::pair<uintmax_t, size_t>> plan;
+        if (size <= sampleSize * kFullReadFactor || round == 0 || round > kMaxSampleRounds) {
+            return plan;
+        }
+
+        if (round == 1) {
+            plan.emplace_back(0, sampleSize);
+            plan.emplace_back(size - sampleSize, sampleSize);
+            return plan;
+        }
+
+        uint32_t shift = round - 2;
+        uintmax_t points = static_cast<uintmax_t>(samplePoints) << shift;
+        uintmax_t block = static_cast<uintmax_t>(sampleSize) << shift;
+        if (points == 0 || points * block > size / kFullReadFactor) {
+            return plan;
+        }
+
+        for (uintmax_t i = 0; i < points; ++i) {
+            // 第 2 轮沿用原来的等分点，之后各轮取区间中点，与上一轮错开
+            uintmax_t center = round == 2 ? size / (points + 1) * (i + 1) : size / (points * 2) * (i * 2 + 1);
+            uintmax_t offset = std::min(center - std::min(center, block / 2), size - block);
+            plan.emplace_back(offset, static_cast<size_t>(block));
+        }
+        return plan;
+    }
+
+    // 快速抽样比较（启用缓存时，文件未变化则直接使用缓存的签名）
+    // known 为枚举阶段已取得的元数据，可省去一次 stat
+    FileSignature generateFileSignature(const fs::path& filepath, uint32_t round, const FileMeta* known = nullptr) {
+        if (!signatureCache) {
+            return computeFileSignature(filepath, known ? known->size : getFileSize(filepath), round);
+        }
+
+        FileMeta meta = (known && known->hasIdentity()) ? *known : statFileMeta(filepath);
+        if (samplePlan(meta.size, round).empty()) {
+            return computeFileSignature(filepath, meta.size, round);
+        }
+
+        FileSignature signature;
+        if (signatureCache->lookupSignature(meta, round, signature)) {
+            return signature;
+        }
+        signature = computeFileSignature(filepath, meta.size, round);
+        signatureCache->storeSignature(meta, signature);
+        return signature;
+    }
+
+    FileSignature computeFileSignature(const fs::path& filepath, uintmax_t size, uint32_t round) {
+        FileSignature signature;
+        signature.size = size;
+        signature.flags = round << FileSignature::kRoundShift;
+
+        auto plan = samplePlan(size, round);
+        if (plan.empty()) {
+            signature.flags |= FileSignature::kSmall;
+            return signature;
+        }
+
+        auto reader = openFileReader(filepath, ioBackend, AccessPattern::Random);
+
+        std::vector<unsigned char> buffer;
+        std::vector<Digest128> sampleDigests;
+        uint64_t bytesRead = 0;
+        
+        for (const auto& block : plan) {
+            const unsigned char* sample = reader->fetch(block.first, block.second, buffer);
+            sampleDigests.push_back(hashing::hash128(sample, block.second));
+            bytesRead += block.second;
+        }
+        sampledBytes += bytesRead;
+
+        finishSignature(signature, sampleDigests);
+        return signature;
+    }
+
+    // 按读取计划的顺序合并各抽样块摘要，与实际读取顺序无关
+    static void finishSignature(FileSignature& signature, const std::vector<Digest128>& sampleDigests) {
+        hashing::Hasher128 combined;
+        for (const Digest128& sampleDigest : sampleDigests) {
+            combined.update(&sampleDigest, sizeof(sampleDigest));
+        }
+        signature.sampleCount = static_cast<uint32_t>(sampleDigests.size());
+        signature.samples = combined.digest();
+    }
+
+    // 线程调度和异步引擎各自的默认队列深度
+    size_t threadQueueDepth() const {
+        return queueDepth > 0 ? queueDepth : 4;
+    }
+
+    size_t asyncQueueDepth() const {
+        return queueDepth > 0 ? queueDepth : 32;
+    }
+
+    // 分批抽样中的一个文件及其读取计划
+    struct ScheduledFile {
+        fs::path path;
+        FileMeta meta;
+        std::vector<std::pair<uintmax_t, size_t>> plan;
+        std::vector<uint64_t> physical;
+        std::vector<Digest128> sampleDigests;
+        std::unique_ptr<FileReader> reader;
+        std::mutex mutex;
+        size_t remaining = 0;
+        bool pending = false;
+        bool failed = false;
+    };
+
+    // 一次抽样块读取，按 (卷, 物理位置, 文件 ID, 偏移) 排序
+    struct ScheduledRead {
+        uint64_t volume;
+        uint64_t physical;
+        uint64_t fileId;
+        uintmax_t offset;
+        size_t file;
+        size_t block;
+
+        bool operator<(const ScheduledRead& other) const {
+            if (volume != other.volume) return volume < other.volume;
+            if (physical != other.physical) return physical < other.physical;
+            if (fileId != other.fileId) return fileId < other.fileId;
+            return offset < other.offset;
+        }
+    };
+
+    // 用异步引擎按顺序发出一批抽样读取，保持 depth() 个在途，每块在完成时立即计算摘要；
+    // 文件在首块提交前打开，最后一块完成后关闭
+    void readSamplesAsync(AsyncReadEngine& engine, std::vector<ScheduledFile>& batch,
+                          const std::vector<ScheduledRead>& reads) {
+        std::vector<std::unique_ptr<AsyncFile>> handles(batch.size());
+        std::vector<std::vector<unsigned char>> buffers(engine.depth());
+        std::vector<size_t> freeBuffers;
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            freeBuffers.push_back(i);
+        }
+        std::vector<size_t> bufferOf(reads.size());
+        std::vector<AsyncReadEngine::Completion> completions;
+
+        auto finishRead = [&](const ScheduledRead& read) {
+            if (--batch[read.file].remaining == 0) {
+                handles[read.file].reset();
+            }
+        };
+        auto fail = [&](ScheduledFile& file, const std::string& error) {
+            if (!file.failed) {
+                file.failed = true;
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cerr << "生成签名失败: " << file.path << " - " << error << std::endl;
+            }
+        };
+
+        size_t next = 0;
+        while (next < reads.size() || engine.inFlight() > 0) {
+            while (next < reads.size() && engine.inFlight() < engine.depth()) {
+                size_t r = next++;
+                const ScheduledRead& read = reads[r];
+                ScheduledFile& file = batch[read.file];
+                if (file.failed) {
+                    finishRead(read);
+                    continue;
+                }
+                try {
+                    if (!handles[read.file]) {
+                        handles[read.file] = std::make_unique<AsyncFile>(file.path);
+                        engine.attach(*handles[read.file]);
+                    }
+                } catch (const std::exception& e) {
+                    fail(file, e.what());
+                    finishRead(read);
+                    continue;
+                }
+                const auto& block = file.plan[read.block];
+                bufferOf[r] = freeBuffers.back();
+                freeBuffers.pop_back();
+                buffers[bufferOf[r]].resize(block.second);
+                engine.submit(*handles[read.file], block.first, buffers[bufferOf[r]].data(), block.second, r);
+            }
+            ProgressCounters::setQueueDepth(Phase::Sampling, engine.inFlight());
+            if (engine.inFlight() == 0) {
+                continue;
+            }
+
+            completions.clear();
+            engine.wait(completions);
+            for (const auto& completion : completions) {
+                const ScheduledRead& read = reads[completion.tag];
+                ScheduledFile& file = batch[read.file];
+                const auto& block = file.plan[read.block];
+                if (completion.ok) {
+                    file.sampleDigests[read.block] = hashing::hash128(buffers[bufferOf[completion.tag]].data(), block.second);
+                    sampledBytes += block.second;
+                } else {
+                    fail(file, "读取文件失败");
+                }
+                freeBuffers.push_back(bufferOf[completion.tag]);
+                finishRead(read);
+            }
+        }
+    }
+
+    // 分批抽样：每批最多 kScheduleBatchFiles 个文件，先查缓存，再把未命中文件的全部抽样块排成读取序列
+    // --schedule physical 时按 (卷, 物理位置) 排序，磁头基本单向移动，查不到物理位置的块
+    // 排在后面按 (文件 ID, 偏移) 排序；读取由 queueDepth 个线程领取，或交给异步引擎保持多个在途
+    // 每批结束后把得到签名的文件计入 samplingCount，与逐文件路径一样报告进度
+    void computeSignaturesBatched(const FileTable& files, uint32_t round, const std::vector<uint32_t>& tasks,
+                                  std::vector<FileSignature>& signatures, std::vector<char>& signatureValid,
+                                  std::atomic<int>& samplingCount) {
+        bool physicalOrder = ioSchedule == "physical";
+        WorkerPool pool(threadQueueDepth());
+        std::unique_ptr<AsyncReadEngine> engine;
+        if (ioBackend == IoBackend::Async) {
+            engine = createAsyncReadEngine(asyncQueueDepth());
+        }
+
+        for (size_t batchBegin = 0; batchBegin < tasks.size(); batchBegin += kScheduleBatchFiles) {
+            if (samplingStopped()) {
+                break;
+            }
+            size_t batchSize = std::min(kScheduleBatchFiles, tasks.size() - batchBegin);
+            std::vector<ScheduledFile> batch(batchSize);
+
+            // 查缓存和物理位置只涉及元数据，并行进行
+            pool.parallelFor(batchSize, [&](size_t i) {
+                ScheduledFile& file = batch[i];
+                size_t task = batchBegin + i;
+                file.path = files.path(tasks[task]);
+                file.meta = files.meta(tasks[task]);
+                if (signatureCache && file.meta.hasIdentity() &&
+                    signatureCache->lookupSignature(file.meta, round, signatures[task])) {
+                    signatureValid[task] = 1;
+                    return;
+                }
+                file.plan = samplePlan(file.meta.size, round);
+                if (physicalOrder) {
+                    file.physical = queryPhysicalOffsets(file.path, file.plan);
+                }
+                file.sampleDigests.resize(file.plan.size());
+                file.remaining = file.plan.size();
+                file.pending = true;
+            });
+
+            std::vector<ScheduledRead> reads;
+            for (size_t i = 0; i < batchSize; ++i) {
+                const ScheduledFile& file = batch[i];
+                if (!file.pending) {
+                    continue;
+                }
+                for (size_t b = 0; b < file.plan.size(); ++b) {
+                    uint64_t physical = file.physical.empty() ? std::numeric_limits<uint64_t>::max() : file.physical[b];
+                    reads.push_back({file.meta.volume, physical, file.meta.fileId[0], file.plan[b].first, i, b});
+                }
+            }
+            if (physicalOrder) {
+                std::sort(reads.begin(), reads.end());
+            }
+
+            if (engine) {
+                readSamplesAsync(*engine, batch, reads);
+            } else {
+                // 各线程按排序后的顺序领取读取；同一文件的块互斥读取，最后一块读完即关闭文件
+                pool.parallelFor(reads.size(), [&](size_t r) {
+                    const ScheduledRead& read = reads[r];
+                    ScheduledFile& file = batch[read.file];
+                    std::lock_guard<std::mutex> lock(file.mutex);
+                    if (!file.failed) {
+                        try {
+                            if (!file.reader) {
+                                file.reader = openFileReader(file.path, ioBackend, AccessPattern::Random);
+                            }
+                            std::vector<unsigned char> buffer;
+                            const auto& block = file.plan[read.block];
+                            const unsigned char* sample = file.reader->fetch(block.first, block.second, buffer);
+                            file.sampleDigests[read.block] = hashing::hash128(sample, block.second);
+                            sampledBytes += block.second;
+                        } catch (const std::exception& e) {
+                            file.failed = true;
+                            std::lock_guard<std::mutex> consoleLock(consoleMutex);
+                            std::cerr << "生成签名失败: " << file.path << " - " << e.what() << std::endl;
+                        }
+                    }
+                    if (--file.remaining == 0) {
+                        file.reader.reset();
+                    }
+                });
+            }
+
+            for (size_t i = 0; i < batchSize; ++i) {
+                ScheduledFile& file = batch[i];
+                if (!file.pending || file.failed) {
+                    continue;
+                }
+                size_t task = batchBegin + i;
+                FileSignature& signature = signatures[task];
+                signature.size = file.meta.size;
+                signature.flags = round << FileSignature::kRoundShift;
+                finishSignature(signature, file.sampleDigests);
+                signatureValid[task] = 1;
+                if (signatureCache && file.meta.hasIdentity()) {
+                    signatureCache->storeSignature(file.meta, signature);
+                }
+            }
+            ProgressCounters::advance(Phase::Sampling, batchSize);
+
+            int finished = static_cast<int>(std::count(signatureValid.begin() + batchBegin,
+                                                       signatureValid.begin() + batchBegin + batchSize, 1));
+            int analyzed = samplingCount += finished;
+            if (verbose && !showProgress && analyzed / 50 > (analyzed - finished) / 50) {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cout << "已分析 " << analyzed << " 个文件..." << std::endl;
+            }
+        }
+    }
+
+    // 外部排序的临时顺串放在系统临时目录下，每个排序器一个子目录，用完即删
+    static fs::path spillDirectory() {
+        return fs::temp_directory_path();
+    }
+
+    void reportSpill(const std::string& stage, size_t runs) {
+        if (verbose && runs > 0) {
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            std::cout << "  " << stage << "外部排序: 写出 " << runs << " 个临时顺串" << std::endl;
+        }
+    }
+
+    // 与其他文件大小相同的文件下标，按 (大小, 下标) 排序；
+    // 设置了内存上限时 (大小, 下标) 记录经外部排序归并，不在内存中对全部文件排序
+    std::vector<uint32_t> collectSizeCandidates(const FileTable& files) {
+        return collectSizeCandidates(files, 0, static_cast<uint32_t>(files.fileCount()));
+    }
+
+    // 小于 --min-size 的文件不作为候选
+    std::vector<uint32_t> collectSizeCandidates(const FileTable& files, uint32_t begin, uint32_t end) {
+        if (memoryLimit == 0) {
+            std::vector<uint32_t> candidates = files.sharedSizeCandidates(begin, end);
+            if (minFileSize > 0) {
+                auto kept = std::find_if(candidates.begin(), candidates.end(),
+                                         [&](uint32_t file) { return files.size(file) >= minFileSize; });
+                candidates.erase(candidates.begin(), kept);
+            }
+            return candidates;
+        }
+
+        ExternalSorter<SizeEntry> sorter(memoryLimit, spillDirectory());
+        for (uint32_t i = begin; i < end; ++i) {
+            if (files.size(i) >= minFileSize) {
+                sorter.push({files.size(i), i});
+            }
+        }
+        sorter.finish();
+
+        std::vector<uint32_t> candidates;
+        SizeEntry entry;
+        bool hasEntry = sorter.next(entry);
+        while (hasEntry) {
+            uint64_t size = entry.size;
+            uint32_t first = entry.index;
+            size_t count = 1;
+            while ((hasEntry = sorter.next(entry)) && entry.size == size) {
+                if (count++ == 1) {
+                    candidates.push_back(first);
+                }
+                candidates.push_back(entry.index);
+            }
+        }
+        reportSpill("大小分组", sorter.spilledRunCount());
+        return candidates;
+    }
+
+    // 计算 tasks 中各文件第 round 轮的签名，写入与 tasks 对齐的槽位；
+    // 每个文件的签名写入自己的槽位，线程之间不共享容器。
+    // known 为取自断点日志的本轮签名，轮次不符的表示读取失败；primedByFile 为流水线提前算出、
+    // 按文件下标存放的签名，轮次不符的表示没有提前算出。
+    // 写断点日志时每 kJournalSliceFiles 个文件算完即写入一条记录
+    void computeRoundSignatures(const FileTable& files, uint32_t round, const std::vector<uint32_t>& tasks,
+                                const std::unordered_map<uint32_t, FileSignature>* known,
+                                std::vector<FileSignature>& signatures, std::vector<char>& signatureValid,
+                                std::atomic<int>& samplingCount,
+                                const std::vector<FileSignature>* primedByFile = nullptr) {
+        // 已提前算好的签名直接填入，只计算其余文件
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            if (known) {
+                auto found = known->find(tasks[i]);
+                if (found != known->end()) {
+                    signatures[i] = found->second;
+                    signatureValid[i] = found->second.round() == round;
+                    continue;
+                }
+            } else if (primedByFile && tasks[i] < primedByFile->size() && (*primedByFile)[tasks[i]].round() == round) {
+                signatures[i] = (*primedByFile)[tasks[i]];
+                signatureValid[i] = 1;
+                continue;
+            }
+            pending.push_back(i);
+        }
+        ProgressCounters::advance(Phase::Sampling, tasks.size() - pending.size());
+
+        size_t slice = journal ? kJournalSliceFiles : std::max<size_t>(pending.size(), 1);
+        for (size_t sliceBegin = 0; sliceBegin < pending.size(); sliceBegin += slice) {
+            std::vector<size_t> part(pending.begin() + sliceBegin,
+                                     pending.begin() + std::min(pending.size(), sliceBegin + slice));
+            computePendingSignatures(files, round, tasks, part, signatures, signatureValid, samplingCount);
+            if (journal) {
+                std::vector<uint32_t> computedFiles;
+                std::vector<FileSignature> computed;
+                for (size_t i : part) {
+                    if (signatureValid[i]) {
+                        computedFiles.push_back(tasks[i]);
+                        computed.push_back(signatures[i]);
+                    }
+                }
+                journal->recordSignatures(round, computedFiles, computed);
+            }
+        }
+    }
+
+    // 计算 tasks 中 pending 所列位置的文件的签名
+    void computePendingSignatures(const FileTable& files, uint32_t round, const std::vector<uint32_t>& tasks,
+                                  const std::vector<size_t>& pending, std::vector<FileSignature>& signatures,
+                                  std::vector<char>& signatureValid, std::atomic<int>& samplingCount) {
+        WorkerPool pool(foldersInParallel ? 1 : threadCount);
+        if (ioSchedule == "physical" || ioBackend == IoBackend::Async) {
+            std::vector<uint32_t> pendingTasks;
+            for (size_t i : pending) {
+                pendingTasks.push_back(tasks[i]);
+            }
+            std::vector<FileSignature> pendingSignatures(pending.size());
+            std::vector<char> pendingValid(pending.size(), 0);
+            computeSignaturesBatched(files, round, pendingTasks, pendingSignatures, pendingValid, samplingCount);
+            for (size_t i = 0; i < pending.size(); ++i) {
+                signatures[pending[i]] = pendingSignatures[i];
+                signatureValid[pending[i]] = pendingValid[i];
+            }
+        } else {
+            pool.parallelFor(pending.size(), [&](size_t slot) {
+                if (samplingStopped()) {
+                    return;
+                }
+                size_t index = pending[slot];
+                fs::path filepath = files.path(tasks[index]);
+                FileMeta meta = files.meta(tasks[index]);
+                try {
+                    signatures[index] = generateFileSignature(filepath, round, &meta);
+                    signatureValid[index] = 1;
+                    int analyzed = ++samplingCount;
+
+                    if (verbose && !showProgress && analyzed % 50 == 0) {
+                        std::lock_guard<std::mutex> lock(consoleMutex);
+                        std::cout << "已分析 " << analyzed << " 个文件..." << std::endl;
+                    }
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(consoleMutex);
+                    std::cerr << "生成签名失败: " << filepath << " - " << e.what() << std::endl;
+                }
+                ProgressCounters::advance(Phase::Sampling, 1);
+            });
+        }
+    }
+
+    // 同一大小的候选文件中文件身份 (卷 + 文件 ID) 相同的是同一文件的多个硬链接，只留第一个：
+    // 它们不占额外空间，无需抽样和比较。枚举时没有拿到身份的文件在这里补读元数据，读取失败的按不同文件处理
+    FileGroup collapseHardLinks(const FileTable& files, std::vector<uint32_t>::const_iterator begin,
+                                std::vector<uint32_t>::const_iterator end, size_t& linkedCount) {
+        FileGroup group;
+        if (end - begin < 2) {
+            group.assign(begin, end);
+            return group;
+        }
+
+        std::set<std::tuple<uint64_t, uint64_t, uint64_t>> identities;
+        for (auto it = begin; it != end; ++it) {
+            FileMeta meta = files.meta(*it);
+            if (!meta.hasIdentity()) {
+                try {
+                    meta = statFileMeta(files.path(*it));
+                } catch (const std::exception&) {
+                    group.push_back(*it);
+                    continue;
+                }
+            }
+            if (identities.emplace(meta.volume, meta.fileId[0], meta.fileId[1]).second) {
+                group.push_back(*it);
+            } else {
+                linkedCount++;
+            }
+        }
+        return group;
+    }
+
+    // 小文件快速路径：不抽样的小文件成批整读进每个线程复用的缓冲区，在抽样阶段直接算出全文摘要，
+    // 不再逐个打开进行精确比较。每批文件依次打开、读取、关闭，整批读完后统一计算摘要；
+    // 读取失败或大小与枚举时不同的文件 valid 为 0。摘要取自签名缓存的文件 valid 为 kDigestRecalled：
+    // 这类摘要只按大小和修改时间判断是否失效，只用于分组，组内仍要逐字节确认
+    void hashSmallFiles(const FileTable& files, const std::vector<uint32_t>& tasks, std::vector<Digest128>& digests,
+                        std::vector<char>& valid) {
+        std::vector<size_t> batchBegins;
+        size_t batchBytes = kSmallBatchBytes;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            size_t need = static_cast<size_t>(files.size(tasks[i])) + 1;
+            if (batchBytes + need > kSmallBatchBytes) {
+                batchBegins.push_back(i);
+                batchBytes = 0;
+            }
+            batchBytes += need;
+        }
+        batchBegins.push_back(tasks.size());
+
+        WorkerPool pool(foldersInParallel ? 1 : threadCount);
+        pool.parallelFor(batchBegins.size() - 1, [&](size_t batch) {
+            if (samplingStopped()) {
+                return;
+            }
+            thread_local std::vector<unsigned char> arena;
+            size_t begin = batchBegins[batch];
+            size_t end = batchBegins[batch + 1];
+            std::vector<size_t> offsets(end - begin + 1, 0);
+            for (size_t i = begin; i < end; ++i) {
+                offsets[i - begin + 1] = offsets[i - begin] + static_cast<size_t>(files.size(tasks[i])) + 1;
+            }
+            if (arena.size() < offsets.back()) {
+                arena.resize(offsets.back());
+            }
+
+            std::vector<std::optional<FileMeta>> metas(end - begin);
+            std::vector<char> cached(end - begin, 0);
+            uint64_t bytesRead = 0;
+            for (size_t i = begin; i < end; ++i) {
+                size_t size = static_cast<size_t>(files.size(tasks[i]));
+                fs::path filepath = files.path(tasks[i]);
+                try {
+                    if (signatureCache) {
+                        FileMeta meta = files.meta(tasks[i]);
+                        metas[i - begin] = meta.hasIdentity() ? meta : statFileMeta(filepath);
+                        if (signatureCache->lookupContentDigest(*metas[i - begin], digests[i])) {
+                            valid[i] = kDigestRecalled;
+                            cached[i - begin] = 1;
+                            continue;
+                        }
+                    }
+                    size_t got = readWholeFile(filepath, arena.data() + offsets[i - begin], size);
+                    bytesRead += got;
+                    if (got != size) {
+                        throw std::runtime_error("文件大小已变化");
+                    }
+                    valid[i] = 1;
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(consoleMutex);
+                    std::cerr << "读取文件失败: " << filepath << " - " << e.what() << std::endl;
+                }
+            }
+            sampledBytes += bytesRead;
+
+            for (size_t i = begin; i < end; ++i) {
+                if (!valid[i] || cached[i - begin]) {
+                    continue;
+                }
+                const unsigned char* data = arena.data() + offsets[i - begin];
+                size_t size = static_cast<size_t>(files.size(tasks[i]));
+                digests[i] = hashing::hash128(data, size);
+                if (metas[i - begin]) {
+                    signatureCache->storeContentDigest(*metas[i - begin], digests[i]);
+                }
+                if (chunkIndex && size >= chunkSize) {
+                    std::vector<ContentChunker::Chunk> chunks;
+                    ContentChunker chunker(chunkSize, chunks);
+                    chunker.update(data, size);
+                    chunker.finish();
+                    chunkIndex->add(tasks[i], size, digests[i], chunks);
+                }
+            }
+            ProgressCounters::advance(Phase::Sampling, end - begin);
+        });
+    }
+
+    // 写断点日志时的小文件整读：日志中已有摘要的文件直接采用 (与缓存的摘要一样只用于分组)，
+    // 其余每 kJournalSliceFiles 个一批，每批算完即写入一条记录
+    void hashSmallFilesJournaled(const FileTable& files, const std::vector<uint32_t>& tasks,
+                                 std::vector<Digest128>& digests, std::vector<char>& valid) {
+        std::vector<size_t> pending;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            if (const Digest128* known = journal->knownDigest(tasks[i])) {
+                digests[i] = *known;
+                valid[i] = kDigestRecalled;
+            } else {
+                pending.push_back(i);
+            }
+        }
+        ProgressCounters::advance(Phase::Sampling, tasks.size() - pending.size());
+
+        for (size_t sliceBegin = 0; sliceBegin < pending.size(); sliceBegin += kJournalSliceFiles) {
+            size_t sliceEnd = std::min(pending.size(), sliceBegin + kJournalSliceFiles);
+            std::vector<uint32_t> sliceTasks;
+            for (size_t k = sliceBegin; k < sliceEnd; ++k) {
+                sliceTasks.push_back(tasks[pending[k]]);
+            }
+            std::vector<Digest128> sliceDigests(sliceTasks.size());
+            std::vector<char> sliceValid(sliceTasks.size(), 0);
+            hashSmallFiles(files, sliceTasks, sliceDigests, sliceValid);
+
+            std::vector<uint32_t> hashedFiles;
+            std::vector<Digest128> hashed;
+            for (size_t k = 0; k < sliceTasks.size(); ++k) {
+                size_t i = pending[sliceBegin + k];
+                digests[i] = sliceDigests[k];
+                valid[i] = sliceValid[k];
+                if (sliceValid[k]) {
+                    hashedFiles.push_back(sliceTasks[k]);
+                    hashed.push_back(sliceDigests[k]);
+                }
+            }
+            journal->recordDigests(hashedFiles, hashed);
+        }
+        journal->flush();
+    }
+
+    // 把 active 中不抽样的小文件组交给快速路径，按全文摘要拆分后成员数 > 1 的组作为已确认的组结束抽样，
+    // 返回其余需要抽样的组
+    std::vector<FileGroup> hashSmallGroups(const FileTable& files, std::vector<FileGroup>& active, bool reportRounds,
+                                           std::vector<FileGroup>& finished, uint64_t& finishedFiles,
+                                           const std::function<void(FileGroup&&)>& onFinished) {
+        std::vector<FileGroup> sampling;
+        std::vector<FileGroup> small;
+        std::vector<uint32_t> tasks;
+        for (auto& group : active) {
+            if (samplePlan(files.size(group[0]), 1).empty()) {
+                tasks.insert(tasks.end(), group.begin(), group.end());
+                small.push_back(std::move(group));
+            } else {
+                sampling.push_back(std::move(group));
+            }
+        }
+        if (tasks.empty()) {
+            return sampling;
+        }
+
+        uint64_t bytesBefore = sampledBytes;
+        ProgressCounters::expect(Phase::Sampling, tasks.size(), 0);
+        std::vector<Digest128> digests(tasks.size());
+        std::vector<char> valid(tasks.size(), 0);
+        if (journal) {
+            hashSmallFilesJournaled(files, tasks, digests, valid);
+        } else {
+            hashSmallFiles(files, tasks, digests, valid);
+        }
+
+        size_t confirmed = 0;
+        size_t offset = 0;
+        for (const auto& group : small) {
+            std::vector<std::pair<Digest128, size_t>> keyed;
+            for (size_t i = 0; i < group.size(); ++i) {
+                if (valid[offset + i]) {
+                    keyed.emplace_back(digests[offset + i], i);
+                }
+            }
+            size_t groupOffset = offset;
+            offset += group.size();
+            std::sort(keyed.begin(), keyed.end());
+            for (size_t begin = 0; begin < keyed.size();) {
+                size_t end = begin + 1;
+                while (end < keyed.size() && keyed[end].first == keyed[begin].first) {
+                    ++end;
+                }
+                if (end - begin > 1) {
+                    FileGroup part;
+                    bool allRead = true;
+                    for (size_t k = begin; k < end; ++k) {
+                        part.push_back(group[keyed[k].second]);
+                        allRead = allRead && valid[groupOffset + keyed[k].second] == 1;
+                    }
+                    // 有成员的摘要不是本次读取算出的，照常进入精确比较
+                    if (allRead) {
+                        FileGroup members = part;
+                        std::sort(members.begin(), members.end());
+                        std::lock_guard<std::mutex> lock(prehashedMutex);
+                        prehashedGroups[std::move(members)] = keyed[begin].first;
+                    }
+                    confirmed += part.size();
+                    finishedFiles += part.size();
+                    ProgressCounters::expect(Phase::Verification, part.size(), 0);
+                    if (onFinished) {
+                        onFinished(std::move(part));
+                    } else {
+                        finished.push_back(std::move(part));
+                    }
+                }
+                begin = end;
+            }
+        }
+
+        if (reportRounds || verbose) {
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            std::cout << "  小文件整读: " << tasks.size() << " 个文件 -> 重复 " << confirmed << " 个, 读取 "
+                      << formatFileSize(sampledBytes - bytesBefore) << std::endl;
+        }
+        return sampling;
+    }
+
+    // 渐进式抽样：候选文件先按大小分组，每轮只对仍然存活的组追加更多、更大的抽样块，
+    // 签名分歧的文件立即淘汰；不再需要抽样的组按 (大小, 首个文件) 顺序交给精确比较
+    // primed 为按文件下标存放的已提前算好的第 1 轮签名（轮次为 0 表示没有提前算出），第 1 轮结束后释放；
+    // 给出 onFinished 时每个组一结束抽样就交给它，不再汇总返回
+    std::vector<FileGroup> refineBySampling(const FileTable& files, const std::vector<uint32_t>& candidates,
+                                            bool reportRounds,
+                                            std::vector<FileSignature>* primed = nullptr,
+                                            const std::function<void(FileGroup&&)>& onFinished = nullptr) {
+        PhaseTimer timer(Phase::Sampling);
+        std::vector<FileGroup> finished;
+        std::vector<FileGroup> active;
+        size_t linkedCount = 0;
+        uint64_t finishedFiles = 0;
+        for (size_t begin = 0; begin < candidates.size();) {
+            size_t end = begin + 1;
+            while (end < candidates.size() && files.size(candidates[end]) == files.size(candidates[begin])) {
+                ++end;
+            }
+            FileGroup group = collapseHardLinks(files, candidates.begin() + begin, candidates.begin() + end, linkedCount);
+            if (group.size() > 1) {
+                active.push_back(std::move(group));
+            }
+            begin = end;
+        }
+        if (verbose && linkedCount > 0) {
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            std::cout << "跳过 " << linkedCount << " 个指向同组中已有文件的硬链接" << std::endl;
+        }
+
+        if (verifyMode != "pairwise") {
+            active = hashSmallGroups(files, active, reportRounds, finished, finishedFiles, onFinished);
+        }
+
+        std::atomic<int> samplingCount{0};
+
+        for (uint32_t round = 1; !active.empty(); ++round) {
+            if (samplingStopped()) {
+                active.clear();
+                break;
+            }
+            std::vector<uint32_t> tasks;
+            for (auto& group : active) {
+                if (samplePlan(files.size(group[0]), round).empty()) {
+                    finishedFiles += group.size();
+                    ProgressCounters::expect(Phase::Verification, group.size(),
+                                             static_cast<uint64_t>(files.size(group[0])) * group.size());
+                    if (onFinished) {
+                        onFinished(std::move(group));
+                    } else {
+                        finished.push_back(std::move(group));
+                    }
+                } else {
+                    tasks.insert(tasks.end(), group.begin(), group.end());
+                }
+            }
+            active.clear();
+            if (tasks.empty()) {
+                break;
+            }
+            ProgressCounters::expect(Phase::Sampling, tasks.size(), 0);
+
+            // 流水线提前算好的只有第 1 轮签名；断点日志中有本轮签名时改用日志
+            const std::unordered_map<uint32_t, FileSignature>* known = journal ? journal->knownSignatures(round) : nullptr;
+            const std::vector<FileSignature>* primedByFile = round == 1 ? primed : nullptr;
+
+            uint64_t bytesBefore = sampledBytes;
+            auto indexAt = [&](uint32_t index) {
+                return tasks[index];
+            };
+            if (memoryLimit == 0) {
+                std::vector<FileSignature> signatures(tasks.size());
+                std::vector<char> signatureValid(tasks.size(), 0);
+                computeRoundSignatures(files, round, tasks, known, signatures, signatureValid, samplingCount,
+                                       primedByFile);
+
+                std::vector<SignatureEntry> signatureEntries;
+                signatureEntries.reserve(tasks.size());
+                for (size_t i = 0; i < tasks.size(); ++i) {
+                    if (signatureValid[i]) {
+                        signatureEntries.push_back({signatures[i], static_cast<uint32_t>(i)});
+                    }
+                }
+                active = partitionBySignature(signatureEntries, indexAt);
+            } else {
+                // 有内存上限时分块计算签名，签名记录经外部排序后按序分组；排序缓冲和分块各占一半
+                ExternalSorter<SignatureEntry> sorter(memoryLimit / 2, spillDirectory());
+                size_t chunkSize = std::max(kScheduleBatchFiles,
+                                            memoryLimit / 2 / (sizeof(FileSignature) + sizeof(uint32_t) + 1));
+                for (size_t chunkBegin = 0; chunkBegin < tasks.size(); chunkBegin += chunkSize) {
+                    size_t chunkEnd = std::min(tasks.size(), chunkBegin + chunkSize);
+                    std::vector<uint32_t> chunk(tasks.begin() + chunkBegin, tasks.begin() + chunkEnd);
+                    std::vector<FileSignature> signatures(chunk.size());
+                    std::vector<char> signatureValid(chunk.size(), 0);
+                    computeRoundSignatures(files, round, chunk, known, signatures, signatureValid, samplingCount,
+                                           primedByFile);
+                    for (size_t i = 0; i < chunk.size(); ++i) {
+                        if (signatureValid[i]) {
+                            sorter.push({signatures[i], static_cast<uint32_t>(chunkBegin + i)});
+                        }
+                    }
+                }
+                sorter.finish();
+                active = partitionSortedSignatures([&](SignatureEntry& entry) { return sorter.next(entry); }, indexAt);
+                reportSpill("第 " + std::to_string(round) + " 轮签名", sorter.spilledRunCount());
+            }
+            if (journal) {
+                journal->flush();
+            }
+            if (primedByFile) {
+                std::vector<FileSignature>().swap(*primed);
+            }
+
+            if (reportRounds || verbose) {
+                size_t survivors = 0;
+                for (const auto& group : active) {
+                    survivors += group.size();
+                }
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cout << "  第 " << round << " 轮抽样: " << tasks.size() << " 个文件 -> 剩余 " << survivors
+                          << " 个, 读取 " << formatFileSize(sampledBytes - bytesBefore) << std::endl;
+            }
+        }
+        PhaseProfiler::countFiles(Phase::Sampling, candidates.size(), finishedFiles);
+
+        std::sort(finished.begin(), finished.end(), [&](const FileGroup& a, const FileGroup& b) {
+            if (files.size(a[0]) != files.size(b[0])) return files.size(a[0]) < files.size(b[0]);
+            return a[0] < b[0];
+        });
+        return finished;
+    }
+
+    // 按签名有序的记录流分区，返回成员数 > 1 的候选组；next(entry) 取下一条，没有时返回 false
+    template <typename Next, typename IndexAt>
+    std::vector<FileGroup> partitionSortedSignatures(Next next, IndexAt indexAt) {
+        std::vector<FileGroup> groups;
+        SignatureEntry entry;
+        bool hasEntry = next(entry);
+        while (hasEntry) {
+            FileSignature signature = entry.signature;
+            FileGroup group;
+            do {
+                group.push_back(indexAt(entry.index));
+                hasEntry = next(entry);
+            } while (hasEntry && entry.signature == signature);
+
+            if (group.size() > 1) {
+                groups.push_back(std::move(group));
+            }
+        }
+        return groups;
+    }
+
+    // 排序后按签名分区，返回成员数 > 1 的候选组，组内保持候选列表原有顺序
+    template <typename IndexAt>
+    std::vector<FileGroup> partitionBySignature(std::vector<SignatureEntry>& entries, IndexAt indexAt) {
+        std::sort(entries.begin(), entries.end());
+
+        size_t position = 0;
+        return partitionSortedSignatures([&](SignatureEntry& entry) {
+            if (position == entries.size()) {
+                return false;
+            }
+            entry = entries[position++];
+            return true;
+        }, indexAt);
+    }
+
+    // 逐字节比较文件内容
+    bool areFilesIdentical(const fs::path& file1, const fs::path& file2) {
+        uintmax_t size1 = getFileSize(file1);
+        uintmax_t size2 = getFileSize(file2);
+        
+        if (size1 != size2) {
+            return false;
+        }
+        
+        if (size1 == 0) {
+            return true;
+        }
+
+        auto f1 = openFileReader(file1, ioBackend, AccessPattern::Sequential);
+        auto f2 = openFileReader(file2, ioBackend, AccessPattern::Sequential);
+
+        const size_t bufferSize = kLockstepChunkSize;
+        std::vector<unsigned char> buffer1;
+        std::vector<unsigned char> buffer2;
+        
+        uintmax_t totalRead = 0;
+        
+        while (totalRead < size1) {
+            size_t toRead = std::min(bufferSize, static_cast<size_t>(size1 - totalRead));
+            
+            const unsigned char* data1 = f1->fetch(totalRead, toRead, buffer1);
+            const unsigned char* data2 = f2->fetch(totalRead, toRead, buffer2);
+            verifiedBytes += toRead * 2;
+            
+            if (memcmp(data1, data2, toRead) != 0) {
+                return false;
+            }
+            
+            totalRead += toRead;
+        }
+
+        return true;
+    }
+
+    // 用户确认函数
+    bool askForConfirmation(const std::string& question, bool defaultYes = false) {
+        if (autoConfirm) {
+            std::cout << question << " (自动确认: 是)" << std::endl;
+            return true;
+        }
+        
+        StatusLinePause pause;
+        std::cout << question << " [" << (defaultYes ? "Y/n" : "y/N") << "]: ";
+        std::cout.flush();
+        
+        std::string response;
+        std::getline(std::cin, response);
+        
+        if (response.empty()) {
+            return defaultYes;
+        }
+        
+        char firstChar = std::tolower(response[0]);
+        return (firstChar == 'y');
+    }
+
+    // 显示重复文件组（带编号）
+    void displayDuplicateGroupsWithNumbers(const FileTable& files, const std::vector<FileGroup>& duplicateGroups) {
+        std::cout << "\n" << std::string(80, '=') << std::endl;
+        std::cout << "重复文件详细列表 (带编号)" << std::endl;
+        std::cout << std::string(80, '=') << std::endl;
+        
+        for (size_t groupIndex = 0; groupIndex < duplicateGroups.size(); ++groupIndex) {
+            const auto& group = duplicateGroups[groupIndex];
+            uintmax_t groupSize = files.size(group[0]);
+            
+            std::cout << "\n第 " << (groupIndex + 1) << " 组重复文件 (" << group.size() << " 个文件, " 
+                      << formatFileSize(groupSize) << "):" << std::endl;
+            std::cout << std::string(60, '-') << std::endl;
+            
+            for (size_t i = 0; i < group.size(); ++i) {
+                fs::path path = files.path(group[i]);
+                std::cout << "  [" << (i + 1) << "] " 
+                          << (i == 0 ? "✓ 保留: " : "✗ " + std::string(actionVerb()) + ": ") 
+                          << path.filename() << std::endl;
+                std::cout << "      路径: " << path.parent_path() << std::endl;
+                std::cout << "      大小: " << formatFileSize(files.size(group[i])) 
+                          << ", 修改时间: " << getFileTimeString(files.mtime(group[i])) << std::endl;
+            }
+        }
+        
+        std::cout << std::string(80, '=') << std::endl;
+    }
+
+    // 显示单个重复文件组的详细信息
+    void displaySingleGroup(const FileTable& files, const FileGroup& group, int groupIndex) {
+        std::cout << "\n" << std::string(60, '=') << std::endl;
+        std::cout << "第 " << groupIndex << " 组重复文件 (" << group.size() << " 个文件):" << std::endl;
+        std::cout << std::string(60, '=') << std::endl;
+        
+        for (size_t i = 0; i < group.size(); ++i) {
+            fs::path path = files.path(group[i]);
+            std::cout << "  [" << (i + 1) << "] " << path.filename() << std::endl;
+            std::cout << "      路径: " << path << std::endl;
+            std::cout << "      大小: " << formatFileSize(files.size(group[i])) 
+                      << ", 修改时间: " << getFileTimeString(files.mtime(group[i])) << std::endl;
+        }
+        std::cout << std::string(60, '=') << std::endl;
+    }
+
+    // 显示修改后的保留方案
+    void displayModifiedRetention(const FileTable& files, const std::vector<FileGroup>& duplicateGroups,
+                                 const std::vector<std::set<size_t>>& keepFiles) {
+        std::cout << "\n" << std::string(80, '=') << std::endl;
+        std::cout << "修改后的保留方案" << std::endl;
+        std::cout << std::string(80, '=') << std::endl;
+        
+        int totalKept = 0;
+        int totalDeleted = 0;
+        uintmax_t totalSpaceSaved = 0;
+
+        for (size_t groupIndex = 0; groupIndex < duplicateGroups.size(); ++groupIndex) {
+            const auto& group = duplicateGroups[groupIndex];
+            const auto& keepSet = keepFiles[groupIndex];
+            
+            std::cout << "\n第 " << (groupIndex + 1) << " 组重复文件:" << std::endl;
+            std::cout << std::string(60, '-') << std::endl;
+            
+            for (size_t i = 0; i < group.size(); ++i) {
+                bool willKeep = (keepSet.find(i + 1) != keepSet.end());
+                std::cout << "  " << (willKeep ? "✓ 保留" : "✗ " + std::string(actionVerb())) 
+                          << " [" << (i + 1) << "] " << files.path(group[i]).filename() << std::endl;
+                
+                if (!willKeep) {
+                    totalDeleted++;
+                    totalSpaceSaved += files.size(group[i]);
+                } else {
+                    totalKept++;
+                }
+            }
+            
+            std::cout << "  本组保留: " << keepSet.size() << " 个文件" << std::endl;
+        }
+        
+        std::cout << std::string(80, '=') << std::endl;
+        std::cout << "总计: 保留 " << totalKept << " 个文件, " << actionVerb() << " " << totalDeleted 
+                  << " 个文件, 节省 " << formatFileSize(totalSpaceSaved) << std::endl;
+        std::cout << std::string(80, '=') << std::endl;
+    }
+
+    // 自动选择保留文件的策略
+    std::set<size_t> autoSelectKeepFiles(const FileTable& files, const FileGroup& group, const std::string& strategy) {
+        std::set<size_t> keepSet;
+        
+        if (strategy == "newest") {
+            // 保留修改时间最新的文件
+            std::vector<std::pair<int64_t, size_t>> times;
+            for (size_t i = 0; i < group.size(); ++i) {
+                times.emplace_back(files.mtime(group[i]), i + 1);
+            }
+            std::sort(times.begin(), times.end(), std::greater<>());
+            keepSet.insert(times[0].second);
+            
+        } else if (strategy == "oldest") {
+            // 保留修改时间最旧的文件
+            std::vector<std::pair<int64_t, size_t>> times;
+            for (size_t i = 0; i < group.size(); ++i) {
+                times.emplace_back(files.mtime(group[i]), i + 1);
+            }
+            std::sort(times.begin(), times.end());
+            keepSet.insert(times[0].second);
+            
+        } else if (strategy == "longest-name") {
+            // 保留文件名最长的文件
+            size_t maxLength = 0;
+            size_t keepIndex = 1;
+            for (size_t i = 0; i < group.size(); ++i) {
+                size_t length = files.path(group[i]).filename().string().length();
+                if (length > maxLength) {
+                    maxLength = length;
+                    keepIndex = i + 1;
+                }
+            }
+            keepSet.insert(keepIndex);
+            
+        } else if (strategy == "shortest-name") {
+            // 保留文件名最短的文件
+            size_t minLength = std::numeric_limits<size_t>::max();
+            size_t keepIndex = 1;
+            for (size_t i = 0; i < group.size(); ++i) {
+                size_t length = files.path(group[i]).filename().string().length();
+                if (length < minLength) {
+                    minLength = length;
+                    keepIndex = i + 1;
+                }
+            }
+            keepSet.insert(keepIndex);
+        }
+        
+        return keepSet;
+    }
+
+    // 让用户修改保留方案 - 新版本
+    std::vector<std::set<size_t>> letUserModifyRetention(const FileTable& files, const std::vector<FileGroup>& duplicateGroups) {
+        StatusLinePause pause;
+        std::vector<std::set<size_t>> keepFiles(duplicateGroups.size());
+        
+        // 初始化默认保留方案（每个组保留第一个文件）
+        for (size_t i = 0; i < duplicateGroups.size(); ++i) {
+            keepFiles[i] = {1};
+        }
+
+        std::cout << "\n🛠️  自定义保留方案" << std::endl;
+        std::cout << "操作说明:" << std::endl;
+        std::cout << "  - 输入组号 (如: 1) 查看并修改该组的保留文件" << std::endl;
+        std::cout << "  - 输入 'all' 对所有组使用自动选择" << std::endl;
+        std::cout << "  - 输入 'auto' 对当前组使用自动选择" << std::endl;
+        std::cout << "  - 输入 'list' 显示所有重复组" << std::endl;
+        std::cout << "  - 输入 'done' 完成自定义" << std::endl;
+        std::cout << "  - 输入 'view 组号' 查看指定组的详细信息" << std::endl;
+
+        while (true) {
+            std::cout << "\n请输入命令 (组号/all/auto/list/done/view): ";
+            std::cout.flush();
+            
+            std::string input;
+            if (!std::getline(std::cin, input)) {
+                std::cout << "\n输入已结束，使用当前保留方案" << std::endl;
+                break;
+            }
+            
+            if (input.empty()) {
+                continue;
+            }
+            
+            // 转换为小写处理命令
+            std::string command = input;
+            std::transform(command.begin(), command.end(), command.begin(), ::tolower);
+            
+            if (command == "done") {
+                break;
+            }
+            else if (command == "list") {
+                displayDuplicateGroupsWithNumbers(files, duplicateGroups);
+            }
+            else if (command == "all") {
+                // 对所有组使用自动选择
+                std::cout << "请选择自动保留策略:" << std::endl;
+                std::cout << "  1. 保留修改时间最新的文件" << std::endl;
+                std::cout << "  2. 保留修改时间最旧的文件" << std::endl;
+                std::cout << "  3. 保留文件名最长的文件" << std::endl;
+                std::cout << "  4. 保留文件名最短的文件" << std::endl;
+                std::cout << "请输入选择 (1-4): ";
+                
+                std::string strategyInput;
+                std::getline(std::cin, strategyInput);
+                
+                std::string strategy;
+                if (strategyInput == "1") strategy = "newest";
+                else if (strategyInput == "2") strategy = "oldest";
+                else if (strategyInput == "3") strategy = "longest-name";
+                else if (strategyInput == "4") strategy = "shortest-name";
+                else {
+                    std::cout << "无效选择，使用默认策略(最新文件)" << std::endl;
+                    strategy = "newest";
+                }
+                
+                for (size_t i = 0; i < duplicateGroups.size(); ++i) {
+                    keepFiles[i] = autoSelectKeepFiles(files, duplicateGroups[i], strategy);
+                }
+                
+                std::cout << "已对所有组应用自动选择策略: " << strategy << std::endl;
+                displayModifiedRetention(files, duplicateGroups, keepFiles);
+            }
+            else if (command.find("view") == 0) {
+                // 查看指定组的详细信息
+                std::stringstream ss(input);
+                std::string cmd;
+                int groupNum;
+                ss >> cmd >> groupNum;
+                
+                if (groupNum < 1 || static_cast<size_t>(groupNum) > duplicateGroups.size()) {
+                    std::cout << "错误: 组号 " << groupNum << " 超出范围 (1-" << duplicateGroups.size() << ")" << std::endl;
+                } else {
+                    displaySingleGroup(files, duplicateGroups[groupNum - 1], groupNum);
+                }
+            }
+            else if (command == "auto") {
+                std::cout << "请先输入要自动选择的组号: ";
+                std::string groupInput;
+                std::getline(std::cin, groupInput);
+                
+                try {
+                    int groupNum = std::stoi(groupInput);
+                    if (groupNum < 1 || static_cast<size_t>(groupNum) > duplicateGroups.size()) {
+                        std::cout << "错误: 组号 " << groupNum << " 超出范围 (1-" << duplicateGroups.size() << ")" << std::endl;
+                        continue;
+                    }
+                    
+                    std::cout << "请选择自动保留策略:" << std::endl;
+                    std::cout << "  1. 保留修改时间最新的文件" << std::endl;
+                    std::cout << "  2. 保留修改时间最旧的文件" << std::endl;
+                    std::cout << "  3. 保留文件名最长的文件" << std::endl;
+                    std::cout << "  4. 保留文件名最短的文件" << std::endl;
+                    std::cout << "请输入选择 (1-4): ";
+                    
+                    std::string strategyInput;
+                    std::getline(std::cin, strategyInput);
+                    
+                    std::string strategy;
+                    if (strategyInput == "1") strategy = "newest";
+                    else if (strategyInput == "2") strategy = "oldest";
+                    else if (strategyInput == "3") strategy = "longest-name";
+                    else if (strategyInput == "4") strategy = "shortest-name";
+                    else {
+                        std::cout << "无效选择，使用默认策略(最新文件)" << std::endl;
+                        strategy = "newest";
+                    }
+                    
+                    keepFiles[groupNum - 1] = autoSelectKeepFiles(files, duplicateGroups[groupNum - 1], strategy);
+                    std::cout << "已对第 " << groupNum << " 组应用自动选择策略: " << strategy << std::endl;
+                    
+                } catch (const std::exception& e) {
+                    std::cout << "错误: 无效的组号 '" << groupInput << "'" << std::endl;
+                }
+            }
+            else {
+                // 处理组号输入
+                try {
+                    int groupNum = std::stoi(input);
+                    if (groupNum < 1 || static_cast<size_t>(groupNum) > duplicateGroups.size()) {
+                        std::cout << "错误: 组号 " << groupNum << " 超出范围 (1-" << duplicateGroups.size() << ")" << std::endl;
+                        continue;
+                    }
+                    
+                    const auto& group = duplicateGroups[groupNum - 1];
+                    displaySingleGroup(files, group, groupNum);
+                    
+                    std::cout << "当前保留的文件: ";
+                    for (size_t idx : keepFiles[groupNum - 1]) {
+                        std::cout << "[" << idx << "] ";
+                    }
+                    std::cout << std::endl;
+                    
+                    std::cout << "请输入要保留的文件编号 (多个编号直接输入无间隔数字，如: 123): ";
+                    std::string selection;
+                    std::getline(std::cin, selection);
+                    
+                    std::set<size_t> newKeepSet;
+                    bool validInput = true;
+                    
+                    for (char c : selection) {
+                        if (c < '1' || c > '9') {
+                            std::cout << "错误: 包含无效字符 '" << c << "'" << std::endl;
+                            validInput = false;
+                            break;
+                        }
+                        
+                        size_t fileNum = c - '0';
+                        if (fileNum > group.size()) {
+                            std::cout << "错误: 文件编号 " << fileNum << " 超出范围 (1-" << group.size() << ")" << std::endl;
+                            validInput = false;
+                            break;
+                        }
+                        
+                        newKeepSet.insert(fileNum);
+                    }
+                    
+                    if (validInput && !newKeepSet.empty()) {
+                        keepFiles[groupNum - 1] = newKeepSet;
+                        std::cout << "第 " << groupNum << " 组保留方案已更新: ";
+                        for (size_t idx : newKeepSet) {
+                            std::cout << "[" << idx << "] ";
+                        }
+                        std::cout << std::endl;
+                    } else if (newKeepSet.empty()) {
+                        std::cout << "错误: 至少需要保留一个文件" << std::endl;
+                    }
+                    
+                } catch (const std::exception& e) {
+                    std::cout << "错误: 无效输入 '" << input << "'" << std::endl;
+                }
+            }
+        }
+        
+        return keepFiles;
+    }
+
+    // 对候选组进行精确比较；有报告时确认的组连同全文摘要立即写入报告
+    // 断点日志中有同一候选组的结果时直接采用，否则比较后写入日志
+    // 丢弃小文件快速路径留下、未被精确比较取走的结果 (预算停止或跳过的组)
+    void clearPrehashedGroups() {
+        std::lock_guard<std::mutex> lock(prehashedMutex);
+        prehashedGroups.clear();
+    }
+
+    // 只丢弃成员编号在 [first, last) 内的结果；文件夹模式各目录的文件编号连续且互不重叠，
+    // 并行处理的其他目录留下的结果不受影响
+    void clearPrehashedGroups(uint32_t first, uint32_t last) {
+        std::lock_guard<std::mutex> lock(prehashedMutex);
+        for (auto it = prehashedGroups.begin(); it != prehashedGroups.end();) {
+            if (it->first.front() >= first && it->first.front() < last) {
+                it = prehashedGroups.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::vector<FileGroup> findExactDuplicates(const FileTable& files, const FileGroup& candidateGroup) {
+        if (journal) {
+            if (const ScanJournal::Verified* known = journal->knownVerified(candidateGroup)) {
+                ProgressCounters::advance(Phase::Verification, candidateGroup.size());
+                if (reportWriter) {
+                    for (size_t g = 0; g < known->groups.size(); ++g) {
+                        reportWriter->write(files, known->groups[g], known->digests[g]);
+                    }
+                }
+                return known->groups;
+            }
+        }
+
+        std::vector<std::optional<Digest128>> digests;
+        auto duplicateGroups = compareCandidateGroup(files, candidateGroup, reportWriter ? &digests : nullptr);
+        uint64_t confirmedFiles = 0;
+        for (const auto& group : duplicateGroups) {
+            confirmedFiles += group.size();
+        }
+        PhaseProfiler::countFiles(Phase::Verification, candidateGroup.size(), confirmedFiles);
+        ProgressCounters::advance(Phase::Verification, candidateGroup.size());
+
+        std::vector<std::optional<Digest128>> groupDigests(duplicateGroups.size());
+        if (reportWriter && !duplicateGroups.empty()) {
+            std::unordered_map<uint32_t, size_t> position;
+            for (size_t i = 0; i < candidateGroup.size(); ++i) {
+                position.emplace(candidateGroup[i], i);
+            }
+            for (size_t g = 0; g < duplicateGroups.size(); ++g) {
+                groupDigests[g] = digests[position[duplicateGroups[g][0]]];
+                reportWriter->write(files, duplicateGroups[g], groupDigests[g]);
+            }
+        }
+        if (journal) {
+            journal->recordVerified(candidateGroup, {duplicateGroups, groupDigests});
+        }
+        return duplicateGroups;
+    }
+
+    // 有缓存时先查全文摘要，其余的按 --verify 比较；digestsOut 非空时返回各成员的全文摘要 (按候选组位置)
+    std::vector<FileGroup> compareCandidateGroup(const FileTable& files, const FileGroup& candidateGroup,
+                                                 std::vector<std::optional<Digest128>>* digestsOut = nullptr) {
+        // 小文件快速路径已按全文摘要确认的组不再读取
+        {
+            FileGroup members = candidateGroup;
+            std::sort(members.begin(), members.end());
+            std::lock_guard<std::mutex> lock(prehashedMutex);
+            auto found = prehashedGroups.find(members);
+            if (found != prehashedGroups.end()) {
+                Digest128 digest = found->second;
+                prehashedGroups.erase(found);
+                if (digestsOut) {
+                    digestsOut->assign(candidateGroup.size(), digest);
+                }
+                return {candidateGroup};
+            }
+        }
+
+        if (!signatureCache || verifyMode == "pairwise") {
+            if (digestsOut) {
+                digestsOut->assign(candidateGroup.size(), std::nullopt);
+            }
+            return verifyCandidates(files, candidateGroup, digestsOut);
+        }
+
+        // 有缓存时先查全文摘要：命中的文件不必读取即可分组，其余文件读一遍后写回缓存
+        std::vector<std::optional<FileMeta>> metas(candidateGroup.size());
+        std::vector<std::optional<Digest128>> digests(candidateGroup.size());
+        std::vector<char> fromCache(candidateGroup.size(), 0);
+        size_t cachedCount = 0;
+
+        for (size_t i = 0; i < candidateGroup.size(); ++i) {
+            try {
+                FileMeta meta = files.meta(candidateGroup[i]);
+                metas[i] = meta.hasIdentity() ? meta : statFileMeta(files.path(candidateGroup[i]));
+                Digest128 digest;
+                if (signatureCache->lookupContentDigest(*metas[i], digest)) {
+                    digests[i] = digest;
+                    fromCache[i] = 1;
+                    cachedCount++;
+                }
+            } catch (const std::exception&) {
+                // 读取元数据失败的文件照常比较，只是不进入缓存
+            }
+        }
+
+        // 缓存的摘要只按大小和修改时间判断是否失效，只用来分组，分出的组仍逐字节确认 (--verify hash 除外)；
+        // 有成员未命中时先按摘要分组会把这些成员读两遍，直接按 --verify 比较，顺带算出它们的摘要
+        std::vector<FileGroup> duplicateGroups;
+        if (verifyMode == "hash") {
+            duplicateGroups = findExactDuplicatesByHash(files, candidateGroup, &digests);
+        } else if (cachedCount < candidateGroup.size()) {
+            duplicateGroups = verifyCandidates(files, candidateGroup, &digests);
+        } else {
+            duplicateGroups = confirmByLockstep(files, findExactDuplicatesByHash(files, candidateGroup, &digests));
+        }
+
+        for (size_t i = 0; i < candidateGroup.size(); ++i) {
+            if (metas[i] && digests[i] && !fromCache[i]) {
+                signatureCache->storeContentDigest(*metas[i], *digests[i]);
+            }
+        }
+
+        if (digestsOut) {
+            *digestsOut = std::move(digests);
+        }
+        return duplicateGroups;
+    }
+
+    // 按 --verify 选择比较算法；digests 非空时顺带收集读完整个文件的成员的全文摘要
+    std::vector<FileGroup> verifyCandidates(const FileTable& files, const FileGroup& candidateGroup,
+                                            std::vector<std::optional<Digest128>>* digests) {
+        if (verifyMode == "pairwise") {
+            return findExactDuplicatesPairwise(files, candidateGroup);
+        }
+
+        if (verifyMode == "hash") {
+            return findExactDuplicatesByHash(files, candidateGroup, digests);
+        }
+        if (candidateGroup.size() > kMaxLockstepFiles) {
+            if (verbose) {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cout << "  候选组超过 " << kMaxLockstepFiles << " 个文件，先按全文哈希分组再逐字节确认" << std::endl;
+            }
+            return confirmByLockstep(files, findExactDuplicatesByHash(files, candidateGroup, digests));
+        }
+
+        return findExactDuplicatesLockstep(files, candidateGroup, digests);
+    }
+
+    // 逐字节确认按摘要分出的组：每组以第一个文件为参照，其余成员每批最多 kMaxLockstepFiles - 1 个与参照同步比较，
+    // 与参照不同的成员 (摘要碰撞或读取失败) 去掉，剩余不足 2 个的组整组去掉
+    std::vector<FileGroup> confirmByLockstep(const FileTable& files, const std::vector<FileGroup>& groups) {
+        std::vector<FileGroup> confirmed;
+        for (const auto& group : groups) {
+            uint32_t reference = group[0];
+            FileGroup same{reference};
+            for (size_t begin = 1; begin < group.size(); begin += kMaxLockstepFiles - 1) {
+                FileGroup batch{reference};
+                batch.insert(batch.end(), group.begin() + begin,
+                             group.begin() + std::min(group.size(), begin + kMaxLockstepFiles - 1));
+                // 分区按批内位置排序，参照所在的分区以参照开头
+                for (const auto& matched : findExactDuplicatesLockstep(files, batch)) {
+                    if (matched[0] == reference) {
+                        same.insert(same.end(), matched.begin() + 1, matched.end());
+                    }
+                }
+            }
+            if (same.size() > 1) {
+                confirmed.push_back(std::move(same));
+            }
+        }
+        return confirmed;
+    }
+
+    // 同步推进比较：组内所有文件同时按块向前读取，内容出现分歧就拆分分区，
+    // 每个文件只读一遍，单成员分区立即关闭，总 I/O 与组内字节数成线性关系
+    std::vector<FileGroup> findExactDuplicatesLockstep(const FileTable& files, const FileGroup& candidateGroup,
+                                                       std::vector<std::optional<Digest128>>* digests = nullptr) {
+        std::vector<FileGroup> duplicateGroups;
+
+        if (verbose) {
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            std::cout << "  同步比较 " << candidateGroup.size() << " 个候选文件" << std::endl;
+        }
+
+        uintmax_t size = files.size(candidateGroup[0]);
+        if (size == 0) {
+            if (digests) {
+                digests->assign(candidateGroup.size(), hashing::Hasher128().digest());
+            }
+            duplicateGroups.push_back(candidateGroup);
+            return duplicateGroups;
+        }
+
+        // 异步后端下每块的读取由引擎并发发出，摘要在完成时计算
+        std::unique_ptr<AsyncReadEngine> engine;
+        if (ioBackend == IoBackend::Async) {
+            engine = createAsyncReadEngine(asyncQueueDepth());
+        }
+
+        std::vector<std::unique_ptr<FileReader>> readers(candidateGroup.size());
+        std::vector<std::unique_ptr<AsyncFile>> asyncFiles(engine ? candidateGroup.size() : 0);
+        std::vector<size_t> opened;
+        for (size_t i = 0; i < candidateGroup.size(); ++i) {
+            try {
+                if (engine) {
+                    asyncFiles[i] = std::make_unique<AsyncFile>(files.path(candidateGroup[i]));
+                    engine->attach(*asyncFiles[i]);
+                } else {
+                    readers[i] = openFileReader(files.path(candidateGroup[i]), ioBackend, AccessPattern::Sequential);
+                }
+                opened.push_back(i);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cerr << "比较文件失败: " << files.path(candidateGroup[i]) << " - " << e.what() << std::endl;
+            }
+        }
+
+        std::vector<std::vector<size_t>> partitions;
+        if (opened.size() > 1) {
+            partitions.push_back(std::move(opened));
+        }
+
+        const size_t chunkSize = kLockstepChunkSize;
+        std::vector<std::vector<unsigned char>> buffers(candidateGroup.size());
+        std::vector<const unsigned char*> chunks(candidateGroup.size(), nullptr);
+        std::vector<hashing::Hasher128> contentHashers(digests ? candidateGroup.size() : 0);
+        std::vector<Digest128> chunkDigests(engine ? candidateGroup.size() : 0);
+        uintmax_t offset = 0;
+
+        // 一次发出所有存活成员本块的读取，读取失败的成员关闭句柄
+        auto readChunkAsync = [&](size_t toRead) {
+            std::vector<size_t> members;
+            for (const auto& partition : partitions) {
+                members.insert(members.end(), partition.begin(), partition.end());
+            }
+            std::vector<AsyncReadEngine::Completion> completions;
+            size_t next = 0;
+            while (next < members.size() || engine->inFlight() > 0) {
+                while (next < members.size() && engine->inFlight() < engine->depth()) {
+                    size_t member = members[next++];
+                    buffers[member].resize(toRead);
+                    engine->submit(*asyncFiles[member], offset, buffers[member].data(), toRead, member);
+                }
+                completions.clear();
+                engine->wait(completions);
+                for (const auto& completion : completions) {
+                    size_t member = completion.tag;
+                    if (!completion.ok) {
+                        {
+                            std::lock_guard<std::mutex> lock(consoleMutex);
+                            std::cerr << "比较文件失败: " << files.path(candidateGroup[member]) << " - 读取文件失败" << std::endl;
+                        }
+                        asyncFiles[member].reset();
+                        continue;
+                    }
+                    chunks[member] = buffers[member].data();
+                    chunkDigests[member] = hashing::hash128(chunks[member], toRead);
+                    verifiedBytes += toRead;
+                    if (digests) {
+                        contentHashers[member].update(chunks[member], toRead);
+                    }
+                }
+            }
+        };
+
+        while (offset < size && !partitions.empty()) {
+            size_t toRead = static_cast<size_t>(std::min<uintmax_t>(chunkSize, size - offset));
+            std::vector<std::vector<size_t>> nextPartitions;
+            if (engine) {
+                readChunkAsync(toRead);
+            }
+
+            for (auto& partition : partitions) {
+                // 读取本块，并以块摘要分桶；同一桶内再逐字节确认，摘要碰撞也不会误判
+                std::vector<std::pair<Digest128, size_t>> keyed;
+                for (size_t member : partition) {
+                    if (engine) {
+                        if (asyncFiles[member]) {
+                            keyed.emplace_back(chunkDigests[member], member);
+                        }
+                        continue;
+                    }
+                    try {
+                        chunks[member] = readers[member]->fetch(offset, toRead, buffers[member]);
+                        verifiedBytes += toRead;
+                    } catch (const std::exception& e) {
+                        {
+                            std::lock_guard<std::mutex> lock(consoleMutex);
+                            std::cerr << "比较文件失败: " << files.path(candidateGroup[member]) << " - " << e.what() << std::endl;
+                        }
+                        readers[member].reset();
+                        continue;
+                    }
+                    keyed.emplace_back(hashing::hash128(chunks[member], toRead), member);
+                    if (digests) {
+                        contentHashers[member].update(chunks[member], toRead);
+                    }
+                }
+                std::sort(keyed.begin(), keyed.end());
+
+                for (size_t begin = 0; begin < keyed.size();) {
+                    size_t end = begin + 1;
+                    while (end < keyed.size() && keyed[end].first == keyed[begin].first) {
+                        ++end;
+                    }
+
+                    std::vector<std::vector<size_t>> split;
+                    for (size_t k = begin; k < end; ++k) {
+                        size_t member = keyed[k].second;
+                        bool placed = false;
+                        for (auto& part : split) {
+                            if (memcmp(chunks[part[0]], chunks[member], toRead) == 0) {
+                                part.push_back(member);
+                                placed = true;
+                                break;
+                            }
+                        }
+                        if (!placed) {
+                            split.push_back({member});
+                        }
+                    }
+
+                    for (auto& part : split) {
+                        if (part.size() > 1) {
+                            nextPartitions.push_back(std::move(part));
+                        } else {
+                            readers[part[0]].reset();
+                            if (engine) {
+                                asyncFiles[part[0]].reset();
+                            }
+                            buffers[part[0]] = std::vector<unsigned char>();
+                        }
+                    }
+                    begin = end;
+                }
+            }
+
+            partitions = std::move(nextPartitions);
+            offset += toRead;
+        }
+
+        // 按各组首个文件在候选组中的位置输出，组内保持原顺序
+        for (auto& partition : partitions) {
+            std::sort(partition.begin(), partition.end());
+            if (digests) {
+                for (size_t member : partition) {
+                    (*digests)[member] = contentHashers[member].digest();
+                }
+            }
+        }
+        std::sort(partitions.begin(), partitions.end());
+
+        for (const auto& partition : partitions) {
+            FileGroup duplicateGroup;
+            for (size_t member : partition) {
+                duplicateGroup.push_back(candidateGroup[member]);
+            }
+            duplicateGroups.push_back(std::move(duplicateGroup));
+        }
+
+        return duplicateGroups;
+    }
+
+    // 计算整个文件内容的 128 位摘要
+    // chunks 非空时在同一次读取中切分内容定义分块
+    Digest128 hashFileContent(const fs::path& filepath, std::vector<ContentChunker::Chunk>* chunks = nullptr) {
+        auto reader = openFileReader(filepath, ioBackend, AccessPattern::Sequential);
+        uintmax_t size = reader->size();
+
+        hashing::Hasher128 hasher;
+        std::optional<ContentChunker> chunker;
+        if (chunks) {
+            chunker.emplace(chunkSize, *chunks);
+        }
+        std::vector<unsigned char> buffer;
+        for (uintmax_t offset = 0; offset < size; offset += kLockstepChunkSize) {
+            size_t toRead = static_cast<size_t>(std::min<uintmax_t>(kLockstepChunkSize, size - offset));
+            const unsigned char* data = reader->fetch(offset, toRead, buffer);
+            hasher.update(data, toRead);
+            if (chunker) {
+                chunker->update(data, toRead);
+            }
+        }
+        if (chunker) {
+            chunker->finish();
+        }
+        verifiedBytes += size;
+        return hasher.digest();
+    }
+
+    // 读取并索引一个文件的分块
+    void indexFileChunks(const FileTable& files, uint32_t file) {
+        std::vector<ContentChunker::Chunk> chunks;
+        Digest128 digest = hashFileContent(files.path(file), &chunks);
+        chunkIndex->add(file, files.size(file), digest, chunks);
+    }
+
+    // 全文哈希比较：每个文件顺序读一遍，按 128 位内容摘要分组
+    // 不保留文件句柄，适合超大候选组；结果以摘要相等为准
+    // known 中已有摘要的文件（如来自缓存）不再读取，新算出的摘要写回 known
+    std::vector<FileGroup> findExactDuplicatesByHash(const FileTable& files, const FileGroup& candidateGroup,
+                                                     std::vector<std::optional<Digest128>>* known = nullptr) {
+        if (verbose) {
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            std::cout << "  全文哈希比较 " << candidateGroup.size() << " 个候选文件" << std::endl;
+        }
+
+        std::vector<std::pair<Digest128, size_t>> digests;
+        digests.reserve(candidateGroup.size());
+        for (size_t i = 0; i < candidateGroup.size(); ++i) {
+            if (known && (*known)[i]) {
+                digests.emplace_back(*(*known)[i], i);
+                continue;
+            }
+            try {
+                Digest128 digest;
+                if (chunkIndex) {
+                    std::vector<ContentChunker::Chunk> chunks;
+                    digest = hashFileContent(files.path(candidateGroup[i]), &chunks);
+                    chunkIndex->add(candidateGroup[i], files.size(candidateGroup[i]), digest, chunks);
+                } else {
+                    digest = hashFileContent(files.path(candidateGroup[i]));
+                }
+                digests.emplace_back(digest, i);
+                if (known) {
+                    (*known)[i] = digest;
+                }
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cerr << "比较文件失败: " << files.path(candidateGroup[i]) << " - " << e.what() << std::endl;
+            }
+        }
+        std::sort(digests.begin(), digests.end());
+
+        std::vector<std::vector<size_t>> partitions;
+        for (size_t begin = 0; begin < digests.size();) {
+            size_t end = begin + 1;
+            while (end < digests.size() && digests[end].first == digests[begin].first) {
+                ++end;
+            }
+            if (end - begin > 1) {
+                std::vector<size_t> partition;
+                for (size_t k = begin; k < end; ++k) {
+                    partition.push_back(digests[k].second);
+                }
+                std::sort(partition.begin(), partition.end());
+                partitions.push_back(std::move(partition));
+            }
+            begin = end;
+        }
+        std::sort(partitions.begin(), partitions.end());
+
+        std::vector<FileGroup> duplicateGroups;
+        for (const auto& partition : partitions) {
+            FileGroup duplicateGroup;
+            for (size_t member : partition) {
+                duplicateGroup.push_back(candidateGroup[member]);
+            }
+            duplicateGroups.push_back(std::move(duplicateGroup));
+        }
+
+        return duplicateGroups;
+    }
+
+    // 两两逐字节比较（旧算法，组内有 k 种内容时每个文件最多被读取 k 次）
+    std::vector<FileGroup> findExactDuplicatesPairwise(const FileTable& files, const FileGroup& candidateGroup) {
+        std::vector<FileGroup> duplicateGroups;
+        std::vector<bool> processed(candidateGroup.size(), false);
+
+        if (verbose) {
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            std::cout << "  精确比较 " << candidateGroup.size() << " 个候选文件" << std::endl;
+        }
+
+        for (size_t i = 0; i < candidateGroup.size(); ++i) {
+            if (processed[i]) continue;
+
+            FileGroup duplicateGroup;
+            duplicateGroup.push_back(candidateGroup[i]);
+            processed[i] = true;
+
+            for (size_t j = i + 1; j < candidateGroup.size(); ++j) {
+                if (processed[j]) continue;
+
+                try {
+                    if (areFilesIdentical(files.path(candidateGroup[i]), files.path(candidateGroup[j]))) {
+                        duplicateGroup.push_back(candidateGroup[j]);
+                        processed[j] = true;
+                    }
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(consoleMutex);
+                    std::cerr << "比较文件失败: " << files.path(candidateGroup[j]) << " - " << e.what() << std::endl;
+                }
+            }
+
+            if (duplicateGroup.size() > 1) {
+                duplicateGroups.push_back(duplicateGroup);
+            }
+        }
+
+        return duplicateGroups;
+    }
+
+    // 在单个文件夹内查找重复文件
+    DeduplicationResult findDuplicatesInFolder(const fs::path& folder) {
+        DeduplicationResult result;
+        
+        if (!fs::exists(folder) || !fs::is_directory(folder)) {
+            result.error = "目录不存在或不是有效目录";
+            return result;
+        }
+
+        // 第一层：按文件大小分组（大小直接取自目录枚举结果）
+        FileTable& files = result.files;
+        {
+            PhaseTimer timer(Phase::Enumeration);
+            DirectoryScanner scanner(1, false);
+            files.append(scanner.scan(folder, [&](const fs::path& dir, const std::string& error) {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cerr << "遍历目录时出错: " << dir << " - " << error << std::endl;
+            }));
+            PhaseProfiler::countFiles(Phase::Enumeration, 0, files.fileCount());
+        }
+        result.totalFiles = static_cast<int>(files.fileCount());
+        for (uint32_t i = 0; i < files.fileCount(); ++i) {
+            result.totalSize += files.size(i);
+        }
+
+        if (files.directoryCount() > 0) {
+            result.duplicateGroups = findDuplicatesInDirectory(files, 0);
+        }
+        return result;
+    }
+
+    // 在共享文件表中查找某个目录直接包含的重复文件：按 (目录, 大小) 分组，再抽样和逐字节比较
+    std::vector<FileGroup> findDuplicatesInDirectory(const FileTable& files, uint32_t directory) {
+        auto range = files.directoryFiles(directory);
+
+        // 第二层：渐进抽样比较
+        auto signatureGroups = refineBySampling(files, collectSizeCandidates(files, range.first, range.second), false);
+
+        // 第三层：逐字节比较
+        PhaseTimer timer(Phase::Verification);
+        std::vector<FileGroup> duplicates;
+        for (const auto& signatureGroup : signatureGroups) {
+            auto duplicateGroups = findExactDuplicates(files, signatureGroup);
+            if (reportWriter) {
+                continue;  // 已写入报告，不在内存中保留
+            }
+            for (const auto& group : duplicateGroups) {
+                duplicates.push_back(group);
+            }
+        }
+        clearPrehashedGroups(range.first, range.second);
+        return duplicates;
+    }
+
+    FolderScan detectFolder(const FileTable& files, uint32_t directory) {
+        FolderScan scan;
+        auto range = files.directoryFiles(directory);
+        scan.totalFiles = static_cast<int>(range.second - range.first);
+        for (uint32_t i = range.first; i < range.second; ++i) {
+            scan.totalSize += files.size(i);
+        }
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        try {
+            scan.duplicateGroups = findDuplicatesInDirectory(files, directory);
+        } catch (const std::exception& e) {
+            scan.error = e.what();
+        }
+        auto endTime = std::chrono::high_resolution_clock::now();
+        scan.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+        return scan;
+    }
+
+    // 处理单个文件夹（带自定义保留功能）
+    // detected 为已在后台完成的检测结果，为空时在此处检测
+    bool processSingleFolder(const FileTable& files, uint32_t directory, int folderIndex = -1, int totalFolders = -1,
+                             FolderScan* detected = nullptr) {
+        fs::path folder = files.directoryPath(directory);
+        std::string prefix = "";
+        if (folderIndex >= 0 && totalFolders > 0) {
+            prefix = "[" + std::to_string(folderIndex) + "/" + std::to_string(totalFolders) + "] ";
+        }
+        
+        std::cout << "\n" << std::string(60, '-') << std::endl;
+        std::cout << prefix << "处理文件夹: " << folder << std::endl;
+        std::cout << std::string(60, '-') << std::endl;
+
+        FolderScan result = detected ? std::move(*detected) : detectFolder(files, directory);
+
+        if (!result.error.empty()) {
+            std::cerr << "错误: " << result.error << std::endl;
+            return false;
+        }
+
+        // 显示文件夹统计信息
+        std::cout << "文件数: " << result.totalFiles << ", 大小: " << formatFileSize(result.totalSize) 
+                  << ", 重复组: " << result.duplicateGroups.size() 
+                  << ", 耗时: " << result.milliseconds << " ms" << std::endl;
+
+        // 计算可删除的文件数和节省空间
+        int deletableFiles = 0;
+        uintmax_t spaceSavable = 0;
+        for (const auto& group : result.duplicateGroups) {
+            deletableFiles += group.size() - 1;
+            spaceSavable += files.size(group[0]) * (group.size() - 1);
+        }
+
+        std::cout << "可删除文件: " << deletableFiles << " 个, 可节省空间: " << formatFileSize(spaceSavable) << std::endl;
+
+        // 如果没有重复文件且设置了跳过选项
+        if (result.duplicateGroups.empty()) {
+            if (skipEmptyFolders) {
+                std::cout << "⏭️  跳过无重复文件的文件夹" << std::endl;
+                return true;
+            } else {
+                std::cout << "ℹ️  此文件夹无重复文件" << std::endl;
+                return true;
+            }
+        }
+
+        // 显示带编号的重复文件列表
+        displayDuplicateGroupsWithNumbers(files, result.duplicateGroups);
+
+        // 询问是否自定义保留方案（自动确认时直接使用默认方案）
+        bool customizeRetention = !autoConfirm && askForConfirmation("是否要自定义保留哪些文件?", false);
+        std::vector<std::set<size_t>> keepFiles;
+        
+        if (customizeRetention) {
+            keepFiles = letUserModifyRetention(files, result.duplicateGroups);
+            displayModifiedRetention(files, result.duplicateGroups, keepFiles);
+        } else {
+            // 使用默认方案（每个组保留第一个文件）
+            keepFiles.assign(result.duplicateGroups.size(), {1});
+        }
+
+        // 询问是否确认删除
+        bool confirmDelete = askForConfirmation("是否确认按此方案" + actionPhrase("重复文件") + "?", false);
+        if (!confirmDelete) {
+            std::cout << "❌ 跳过此文件夹的" << (action == DuplicateAction::Delete ? "删除" : "替换") << "操作" << std::endl;
+            return true;
+        }
+
+        // 执行删除操作
+        executeDisposal(files, result.duplicateGroups, keepFiles);
+        return true;
+    }
+
+    // 自动确认时各文件夹的检测在多个线程中并行进行，展示和删除仍在主线程按文件夹顺序逐个进行；
+    // 检测最多领先展示 kFolderLookahead 个文件夹，排队的结果不会无限增长
+    void processFoldersInParallel(const FileTable& files, const std::vector<uint32_t>& folders,
+                                  int& processedCount, int& skippedCount) {
+        std::mutex readyMutex;
+        std::condition_variable readyChanged;
+        std::map<size_t, FolderScan> ready;
+        size_t presented = 0;
+        std::atomic<size_t> next{0};
+
+        foldersInParallel = true;
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < std::min(threadCount, folders.size()); ++t) {
+            workers.emplace_back([&] {
+                for (;;) {
+                    size_t index = next++;
+                    if (index >= folders.size()) {
+                        return;
+                    }
+                    {
+                        std::unique_lock<std::mutex> lock(readyMutex);
+                        readyChanged.wait(lock, [&] { return index < presented + kFolderLookahead; });
+                    }
+                    FolderScan scan = detectFolder(files, folders[index]);
+                    {
+                        std::lock_guard<std::mutex> lock(readyMutex);
+                        ready.emplace(index, std::move(scan));
+                    }
+                    readyChanged.notify_all();
+                }
+            });
+        }
+
+        for (size_t i = 0; i < folders.size(); ++i) {
+            FolderScan scan;
+            {
+                std::unique_lock<std::mutex> lock(readyMutex);
+                readyChanged.wait(lock, [&] { return ready.count(i) > 0; });
+                scan = std::move(ready[i]);
+                ready.erase(i);
+            }
+            if (processSingleFolder(files, folders[i], i + 1, folders.size(), &scan)) {
+                processedCount++;
+            } else {
+                skippedCount++;
+            }
+            {
+                std::lock_guard<std::mutex> lock(readyMutex);
+                presented = i + 1;
+            }
+            readyChanged.notify_all();
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        foldersInParallel = false;
+    }
+
+// 收集所有子文件夹：一次遍历同时取得文件夹结构和其中的文件，存入共享文件表；
+// 返回文件夹在表中的下标（含根目录本身），按路径长度排序，父文件夹在前
+std::vector<uint32_t> collectAllSubfolders(const fs::path& rootFolder, FileTable& files) {
+    std::cout << "正在收集子文件夹..." << std::endl;
+
+    {
+        PhaseTimer timer(Phase::Enumeration);
+        DirectoryScanner scanner(threadCount, true);
+        files.append(scanner.scan(rootFolder, [&](const fs::path& dir, const std::string& error) {
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            std::cerr << "遍历目录时出错: " << dir << " - " << error << std::endl;
+        }));
+        PhaseProfiler::countFiles(Phase::Enumeration, 0, files.fileCount());
+    }
+
+    // 扫描结果按路径排序，根目录总是第一个
+    std::vector<uint32_t> folders;
+    std::vector<size_t> pathLengths(files.directoryCount());
+    for (uint32_t directory = 0; directory < files.directoryCount(); ++directory) {
+        fs::path path = files.directoryPath(directory);
+        pathLengths[directory] = path.string().length();
+        folders.push_back(directory);
+        if (verbose && directory > 0) {
+            std::cout << "找到文件夹: " << path << std::endl;
+        }
+    }
+
+    // 按路径长度排序，确保父文件夹在前
+    std::sort(folders.begin(), folders.end(), [&](uint32_t a, uint32_t b) {
+        return pathLengths[a] < pathLengths[b];
+    });
+
+    std::cout << "共找到 " << folders.size() << " 个文件夹, " << files.fileCount() << " 个文件" << std::endl;
+    return folders;
+}
+
+// 主去重处理函数
+void deduplicate(const std::string& directory) {
+    std::cout << "开始处理目录: " << directory << std::endl;
+    
+    if (!fs::exists(directory)) {
+        std::cerr << "错误: 目录不存在: " << directory << std::endl;
+        return;
+    }
+    
+    if (!fs::is_directory(directory)) {
+        std::cerr << "错误: 路径不是目录: " << directory << std::endl;
+        return;
+    }
+
+    std::cout << "🎯 文件去重工具 - 模式: " << (mode == "all" ? "全局去重" : "单文件夹去重") << std::endl;
+    std::cout << "目标目录: " << directory << std::endl;
+    std::cout << "跳过无重复文件夹: " << (skipEmptyFolders ? "是" : "否") << std::endl;
+
+    if (mode == "per-folder" || mode == "folder") {
+        // 单文件夹模式：分别处理每个文件夹
+        std::cout << "使用单文件夹模式..." << std::endl;
+        FileTable files;
+        auto folders = collectAllSubfolders(directory, files);
+        std::cout << "\n找到 " << folders.size() << " 个文件夹需要处理" << std::endl;
+
+        if (reportWriter) {
+            // 报告模式：逐个文件夹检测，确认的重复组已写入报告，不展示也不处理
+            for (uint32_t folder : folders) {
+                FolderScan scan = detectFolder(files, folder);
+                if (!scan.error.empty()) {
+                    std::cerr << "错误: " << files.directoryPath(folder) << " - " << scan.error << std::endl;
+                }
+            }
+            saveSignatureCache();
+            finishReport();
+            return;
+        }
+
+        int processedCount = 0;
+        int skippedCount = 0;
+
+        if (autoConfirm && threadCount > 1 && folders.size() > 1) {
+            std::cout << "自动确认模式: " << threadCount << " 个线程并行检测各文件夹" << std::endl;
+            processFoldersInParallel(files, folders, processedCount, skippedCount);
+        } else {
+            for (size_t i = 0; i < folders.size(); ++i) {
+                bool result = processSingleFolder(files, folders[i], i + 1, folders.size());
+                if (result) {
+                    processedCount++;
+                } else {
+                    skippedCount++;
+                }
+
+                // 如果不是自动确认模式，询问是否继续处理下一个文件夹
+                if (!autoConfirm && i < folders.size() - 1) {
+                    bool continueProcessing = askForConfirmation("\n是否继续处理下一个文件夹?", true);
+                    if (!continueProcessing) {
+                        std::cout << "⏹️  用户中止处理" << std::endl;
+                        break;
+                    }
+                }
+            }
+        }
+
+        saveSignatureCache();
+
+        std::cout << "\n" << std::string(50, '=') << std::endl;
+        std::cout << "处理完成!" << std::endl;
+        std::cout << "已处理: " << processedCount << " 个文件夹" << std::endl;
+        if (skippedCount > 0) {
+            std::cout << "已跳过: " << skippedCount << " 个文件夹" << std::endl;
+        }
+        std::cout << std::string(50, '=') << std::endl;
+
+    } else {
+        // 全局模式：在整个目录树中查找重复文件
+        std::cout << "使用全局模式..." << std::endl;
+        
+        // 修改 findDuplicatesInFolder 以支持递归扫描
+        auto result = findDuplicatesInFolderRecursive(directory);
+        saveSignatureCache();
+        
+        if (!result.error.empty()) {
+            std::cerr << "错误: " << result.error << std::endl;
+            return;
+        }
+
+        if (chunkIndex) {
+            reportChunkIndex(result.files);
+        }
+
+        if (reportWriter) {
+            finishReport();
+            discardJournal();
+            return;
+        }
+
+        std::cout << "\n" << std::string(50, '=') << std::endl;
+        std::cout << "全局扫描完成!" << std::endl;
+        std::cout << std::string(50, '=') << std::endl;
+        std::cout << "总文件数: " << result.totalFiles << std::endl;
+        std::cout << "总大小: " << formatFileSize(result.totalSize) << std::endl;
+        std::cout << "发现重复组: " << result.duplicateGroups.size() << " 组" << std::endl;
+        
+        int totalDuplicateFiles = 0;
+        uintmax_t totalSpaceSaved = 0;
+        for (const auto& group : result.duplicateGroups) {
+            totalDuplicateFiles += group.size() - 1;
+            totalSpaceSaved += result.files.size(group[0]) * (group.size() - 1);
+        }
+        
+        std::cout << "重复文件数: " << totalDuplicateFiles << " 个" << std::endl;
+        std::cout << "可节省空间: " << formatFileSize(totalSpaceSaved) << std::endl;
+
+        if (result.duplicateGroups.empty()) {
+            std::cout << "\n🎉 恭喜！没有找到重复文件。" << std::endl;
+            discardJournal();
+            return;
+        }
+
+        // 显示带编号的重复文件列表
+        displayDuplicateGroupsWithNumbers(result.files, result.duplicateGroups);
+
+        // 询问是否自定义保留方案（自动确认时直接使用默认方案）
+        bool customizeRetention = !autoConfirm && askForConfirmation("\n是否要自定义保留哪些文件?", false);
+        std::vector<std::set<size_t>> keepFiles;
+        
+        if (customizeRetention) {
+            keepFiles = letUserModifyRetention(result.files, result.duplicateGroups);
+            displayModifiedRetention(result.files, result.duplicateGroups, keepFiles);
+        } else {
+            // 使用默认方案（每个组保留第一个文件）
+            keepFiles.assign(result.duplicateGroups.size(), {1});
+        }
+
+        // 询问是否确认删除
+        bool confirmDelete = askForConfirmation("\n是否确认按此方案" + actionPhrase("所有重复文件") + "? (此操作不可恢复)", false);
+        if (!confirmDelete) {
+            std::cout << "❌ 操作已取消。" << std::endl;
+            discardJournal();
+            return;
+        }
+
+        // 执行全局删除
+        executeDisposal(result.files, result.duplicateGroups, keepFiles);
+        discardJournal();
+    }
+}
+
+// 全局检测和随后的处理正常结束，断点日志不再需要；中断 (进程被终止) 或出错时保留，可用 --resume 继续
+void discardJournal() {
+    if (journal) {
+        journal->discard();
+        journal.reset();
+    }
+}
+
+// 分块索引：精确比较时已读过的文件不再读取，其余不小于平均分块长度的文件读一遍补充索引，
+// 随后输出共享大量分块的文件对和块级去重可再节省的空间 (不含整文件重复)
+void reportChunkIndex(const FileTable& files) {
+    std::vector<uint32_t> pending;
+    for (uint32_t file = 0; file < files.fileCount(); ++file) {
+        if (files.size(file) >= chunkSize && !chunkIndex->contains(file)) {
+            pending.push_back(file);
+        }
+    }
+
+    std::cout << "\n正在建立分块索引... (补充读取 " << pending.size() << " 个文件)" << std::endl;
+    uint64_t bytesBefore = verifiedBytes;
+    {
+        PhaseTimer timer(Phase::Verification);
+        WorkerPool(threadCount).parallelFor(pending.size(), [&](size_t i) {
+            try {
+                indexFileChunks(files, pending[i]);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cerr << "读取文件失败: " << files.path(pending[i]) << " - " << e.what() << std::endl;
+            }
+        });
+    }
+
+    ChunkIndex::Summary summary = chunkIndex->analyze();
+    std::cout << "分块索引: " << summary.files << " 个不同内容的文件 (另有 " << summary.copies << " 个完全相同), "
+              << formatFileSize(summary.bytes) << ", " << summary.chunks << " 个分块, 补充读取 "
+              << formatFileSize(verifiedBytes - bytesBefore) << std::endl;
+    std::cout << "块级去重可再节省: " << formatFileSize(summary.bytes - summary.uniqueBytes) << std::endl;
+    if (summary.pairs.empty()) {
+        return;
+    }
+
+    constexpr size_t kShownPairs = 20;
+    size_t shown = verbose ? summary.pairs.size() : std::min(summary.pairs.size(), kShownPairs);
+    std::cout << "共享一半以上分块的文件对: " << summary.pairs.size() << " 对" << std::endl;
+    for (size_t i = 0; i < shown; ++i) {
+        const auto& pair = summary.pairs[i];
+        std::cout << "  " << formatFileSize(pair.sharedBytes) << " 相同:" << std::endl;
+        std::cout << "    " << files.path(pair.first) << " (" << formatFileSize(files.size(pair.first)) << ")" << std::endl;
+        std::cout << "    " << files.path(pair.second) << " (" << formatFileSize(files.size(pair.second)) << ")" << std::endl;
+    }
+    if (shown < summary.pairs.size()) {
+        std::cout << "  ... 另有 " << summary.pairs.size() - shown << " 对, 使用 -v 查看全部" << std::endl;
+    }
+}
+
+// --apply：执行报告格式 (jsonl) 的保留方案，不重新扫描。每组中 "keep": true 的文件保留，没有标记时保留第一个；
+// 各组并行核对大小、修改时间和文件 ID，与方案不一致的文件不处理；与其他组共用文件的组整组跳过，
+// 之后直接交给删除 / 替换执行器
+bool applyPlan(const fs::path& planPath) {
+    std::ifstream in(planPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "错误: 无法打开保留方案: " << planPath << std::endl;
+        return false;
+    }
+
+    std::vector<std::vector<PlannedFile>> groups;
+    std::vector<char> hashOnly;  // 方案标为只按全文摘要确认 ("verified":"hash") 的组，执行前逐字节比较
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.find_first_not_of(" \t") == std::string::npos) {
+            continue;
+        }
+        try {
+            JsonValue group = JsonParser(line).parse();
+            const JsonValue* size = group.find("size");
+            const JsonValue* members = group.find("files");
+            if (!size || size->type != JsonValue::Type::Number || !members ||
+                members->type != JsonValue::Type::Array) {
+                throw std::runtime_error("缺少 size 或 files");
+            }
+            std::vector<PlannedFile> planned;
+            for (const auto& member : members->items) {
+                const JsonValue* path = member.find("path");
+                if (!path || path->type != JsonValue::Type::String) {
+                    throw std::runtime_error("文件缺少 path");
+                }
+                PlannedFile file;
+                file.path = utf8ToPath(path->text);
+                file.meta.size = std::stoull(size->text);
+                const JsonValue* mtime = member.find("mtime");
+                if (mtime && mtime->type == JsonValue::Type::Number) {
+                    file.meta.mtimeNs = std::stoll(mtime->text);
+                }
+                const JsonValue* fileId = member.find("fileId");
+                if (fileId && fileId->type == JsonValue::Type::String && !parseFileId(fileId->text, file.meta)) {
+                    throw std::runtime_error("无效的 fileId: " + fileId->text);
+                }
+                const JsonValue* keep = member.find("keep");
+                file.keep = keep && keep->type == JsonValue::Type::Boolean && keep->boolean;
+                planned.push_back(std::move(file));
+            }
+            if (planned.size() > 1) {
+                const JsonValue* verified = group.find("verified");
+                hashOnly.push_back(verified && verified->type == JsonValue::Type::String && verified->text == "hash");
+                groups.push_back(std::move(planned));
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "错误: 保留方案第 " << lineNumber << " 行无效 - " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    std::cout << "保留方案: " << groups.size() << " 组, 正在核对文件"
+              << (recheckPlan ? " (含抽样签名)" : "") << "..." << std::endl;
+    std::vector<std::string> logs(groups.size());
+    {
+        PhaseTimer timer(Phase::Verification);
+        WorkerPool(threadCount).parallelFor(groups.size(), [&](size_t g) {
+            logs[g] = checkPlannedGroup(groups[g], hashOnly[g] != 0);
+        });
+    }
+    skipSharedPlannedGroups(groups, logs);
+    size_t skippedGroups = 0;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        if (!logs[g].empty()) {
+            std::cout << "第 " << g + 1 << " 组:\n" << logs[g];
+        }
+        if (groups[g].empty()) {
+            skippedGroups++;
+        }
+    }
+    std::cout << std::flush;
+
+    // 通过核对的文件按所在目录放入文件表，组内下标和保留位置与方案一致
+    std::map<fs::path::string_type, ScannedDirectory> directories;
+    std::vector<std::vector<std::pair<ScannedDirectory*, size_t>>> placements(groups.size());
+    for (size_t g = 0; g < groups.size(); ++g) {
+        for (const auto& file : groups[g]) {
+            ScannedDirectory& directory = directories[file.path.parent_path().native()];
+            directory.path = file.path.parent_path();
+            placements[g].emplace_back(&directory, directory.files.size());
+            directory.files.push_back({file.path.filename().native(), file.meta});
+        }
+    }
+    FileTable files;
+    std::unordered_map<const ScannedDirectory*, uint32_t> firstFile;
+    for (auto& entry : directories) {
+        firstFile[&entry.second] = files.appendDirectory(std::move(entry.second));
+    }
+    files.finishAppend();
+
+    std::vector<FileGroup> duplicateGroups;
+    std::vector<std::set<size_t>> keepFiles;
+    size_t disposals = 0;
+    uintmax_t reclaimable = 0;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        if (groups[g].empty()) {
+            continue;
+        }
+        FileGroup group;
+        std::set<size_t> keepSet;
+        for (size_t i = 0; i < groups[g].size(); ++i) {
+            group.push_back(firstFile[placements[g][i].first] + static_cast<uint32_t>(placements[g][i].second));
+            if (groups[g][i].keep) {
+                keepSet.insert(i + 1);
+            } else {
+                disposals++;
+                reclaimable += groups[g][i].meta.size;
+            }
+        }
+        duplicateGroups.push_back(std::move(group));
+        keepFiles.push_back(std::move(keepSet));
+    }
+
+    std::cout << "核对完成: " << duplicateGroups.size() << " 组可执行";
+    if (skippedGroups > 0) {
+        std::cout << ", " << skippedGroups << " 组跳过";
+    }
+    std::cout << "; 待处理文件: " << disposals << " 个, 可节省空间: " << formatFileSize(reclaimable) << std::endl;
+    if (duplicateGroups.empty()) {
+        return true;
+    }
+
+    if (!askForConfirmation("是否确认按此方案" + actionPhrase(" " + std::to_string(disposals) + " 个文件") + "?", false)) {
+        std::cout << "❌ 操作已取消。" << std::endl;
+        return true;
+    }
+    executeDisposal(files, duplicateGroups, keepFiles);
+    return true;
+}
+
+// 添加全局模式的支持方法
+DeduplicationResult findDuplicatesInFolderRecursive(const fs::path& folder) {
+    DeduplicationResult result;
+    
+    if (!fs::exists(folder) || !fs::is_directory(folder)) {
+        result.error = "目录不存在或不是有效目录";
+        return result;
+    }
+
+    if (!journalPath.empty()) {
+        journal = std::make_unique<ScanJournal>(journalPath, folder, samplePoints, sampleSize, resumeJournal);
+        if (journal->resumed()) {
+            std::cout << "从断点日志继续: " << journalPath << " (" << journal->restoredRecordCount() << " 条记录)"
+                      << std::endl;
+        } else if (resumeJournal) {
+            std::cout << "断点日志不存在或与本次的目录 / 抽样参数不符, 重新开始: " << journalPath << std::endl;
+        }
+    }
+
+    // 日志中已有文件表时不再枚举
+    FileTable& files = result.files;
+    bool restored = journal && journal->takeTable(files);
+    if (restored) {
+        std::cout << "已从断点日志恢复文件表，跳过目录扫描" << std::endl;
+        if (size_t stale = journal->revalidate(files, threadCount)) {
+            std::cout << "  " << stale << " 个文件在上次运行后已变化或不存在, 丢弃其摘要和比较结果" << std::endl;
+        }
+    } else {
+        std::cout << "正在递归扫描目录: " << folder << std::endl;
+        if (pipeline && scanMode != "mft") {
+            return findDuplicatesPipelined(folder);
+        }
+
+        // 第一层：按文件大小分组（多线程递归扫描，大小和时间直接取自枚举结果）
+        PhaseTimer enumerationTimer(Phase::Enumeration);
+        std::vector<ScannedDirectory> directories;
+        bool scanned = false;
+#ifdef _WIN32
+        if (scanMode == "mft") {
+            // 快照与签名缓存放在同一目录
+            NtfsMftScanner mftScanner(threadCount, SignatureCache::defaultPath().parent_path());
+            std::string error, summary;
+            if (mftScanner.scan(folder, incrementalScan, directories, error, summary)) {
+                std::cout << summary << std::endl;
+                scanned = true;
+            } else {
+                std::cerr << "MFT 扫描失败: " << error << "，改用目录遍历" << std::endl;
+                directories.clear();
+            }
+        }
+#endif
+
+        if (!scanned) {
+            DirectoryScanner scanner(threadCount, true);
+            size_t scannedFiles = 0;
+            size_t nextReport = 100;
+            directories = scanner.scan(folder, [&](const fs::path& dir, const std::string& error) {
+                std::lock_guard<std::mutex> lock(consoleMutex);
+                std::cerr << "遍历目录时出错: " << dir << " - " << error << std::endl;
+            }, [&](const ScannedDirectory& directory) {
+                scannedFiles += directory.files.size();
+                if (verbose && !showProgress && scannedFiles >= nextReport) {
+                    std::lock_guard<std::mutex> lock(consoleMutex);
+                    std::cout << "已扫描 " << scannedFiles << " 个文件..." << std::endl;
+                    nextReport = (scannedFiles / 100 + 1) * 100;
+                }
+            });
+        }
+
+        files.append(std::move(directories));
+        PhaseProfiler::countFiles(Phase::Enumeration, 0, files.fileCount());
+        if (journal) {
+            journal->recordTable(files);
+        }
+    }
+    result.totalFiles = static_cast<int>(files.fileCount());
+    for (uint32_t i = 0; i < files.fileCount(); ++i) {
+        result.totalSize += files.size(i);
+    }
+
+    std::cout << "扫描完成，共找到 " << result.totalFiles << " 个文件" << std::endl;
+    if (verbose) {
+        std::cout << "文件表占用内存: " << formatFileSize(files.memoryBytes()) << std::endl;
+    }
+
+    // 第二层：渐进抽样比较（多线程）
+    std::vector<uint32_t> samplingTasks = collectSizeCandidates(files);
+    std::cout << "正在分析文件内容... (" << samplingTasks.size() << " 个候选文件, "
+              << WorkerPool(threadCount).size() << " 个线程)" << std::endl;
+    if (workOrder == "reclaimable" || hasBudget()) {
+        detectInPriorityOrder(files, samplingTasks, result.duplicateGroups);
+        if (journal) {
+            journal->flush();
+        }
+        std::cout << "读取量: 抽样 " << formatFileSize(sampledBytes) << ", 精确比较 "
+                  << formatFileSize(verifiedBytes) << std::endl;
+        return result;
+    }
+    auto signatureGroups = refineBySampling(files, samplingTasks, true);
+
+    // 第三层：逐字节比较
+    std::cout << "正在确认重复文件..." << std::endl;
+    {
+        PhaseTimer timer(Phase::Verification);
+        for (const auto& signatureGroup : signatureGroups) {
+            auto duplicateGroups = findExactDuplicates(files, signatureGroup);
+            if (reportWriter) {
+                continue;  // 已写入报告，不在内存中保留
+            }
+            for (const auto& group : duplicateGroups) {
+                result.duplicateGroups.push_back(group);
+            }
+        }
+    }
+    clearPrehashedGroups();
+    if (journal) {
+        journal->flush();
+    }
+
+    std::cout << "读取量: 抽样 " << formatFileSize(sampledBytes) << ", 精确比较 "
+              << formatFileSize(verifiedBytes) << std::endl;
+
+    return result;
+}
+
+bool hasBudget() const {
+    return readBudget > 0 || timeBudget.count() > 0;
+}
+
+// 读取量或运行时间已到达预算
+bool budgetExhausted() const {
+    if (readBudget > 0 && sampledBytes + verifiedBytes >= readBudget) {
+        return true;
+    }
+    return timeBudget.count() > 0 && std::chrono::steady_clock::now() - startTime >= timeBudget;
+}
+
+// 抽样中途是否因预算停止：每一轮、每批读取和每个文件开始前检查，停止后未读的文件没有签名 / 摘要，
+// 不进入任何候选组
+bool samplingStopped() const {
+    return budgetStops && budgetExhausted();
+}
+
+// 按预算调度的检测：大小组按 --order 排列 (reclaimable 时按 大小 × (文件数 − 1) 从大到小)，
+// 每批约 kPriorityBatchFiles 个文件依次完成抽样和精确比较，批内的签名组也按同样的顺序比较，
+// 可节省空间大的重复组最先确认。每批和每组开始前检查预算，批内的抽样在每轮和每批读取前也检查，
+// 一个很大的大小组不会让检测越过预算太多；到达后停止，已确认的组照常展示和处理。
+// 有读取预算时每批只含一个大小组：同一批内小文件组先于其他组的抽样整组读取，批内不保持顺序。
+// 剩余预算连两个文件都比较不完的大小组不抽样，整组读完会超出剩余预算的候选组不比较，
+// 都跳过后继续尝试更小的组
+void detectInPriorityOrder(const FileTable& files, const std::vector<uint32_t>& candidates,
+                           std::vector<FileGroup>& duplicateGroups) {
+    struct SizeRun {
+        size_t begin;
+        size_t end;
+        uint64_t reclaimable;
+    };
+    std::vector<SizeRun> runs;
+    for (size_t begin = 0; begin < candidates.size();) {
+        size_t end = begin + 1;
+        while (end < candidates.size() && files.size(candidates[end]) == files.size(candidates[begin])) {
+            ++end;
+        }
+        runs.push_back({begin, end, static_cast<uint64_t>(files.size(candidates[begin])) * (end - begin - 1)});
+        begin = end;
+    }
+    bool byReclaimable = workOrder == "reclaimable";
+    auto groupReclaimable = [&](const FileGroup& group) {
+        return static_cast<uint64_t>(files.size(group[0])) * (group.size() - 1);
+    };
+    if (byReclaimable) {
+        std::stable_sort(runs.begin(), runs.end(), [](const SizeRun& a, const SizeRun& b) {
+            return a.reclaimable > b.reclaimable;
+        });
+    }
+
+    size_t skippedGroups = 0;
+    size_t unfinishedRuns = 0;
+    bool exhausted = false;
+    budgetStops = true;
+    for (size_t next = 0; next < runs.size();) {
+        if (budgetExhausted()) {
+            exhausted = true;
+            unfinishedRuns = runs.size() - next;
+            break;
+        }
+        size_t batchFirst = next;
+        std::vector<uint32_t> batch;
+        if (readBudget > 0) {
+            uint64_t remaining = readBudget - (sampledBytes + verifiedBytes);
+            if (static_cast<uint64_t>(files.size(candidates[runs[next].begin])) * 2 > remaining) {
+                skippedGroups++;
+                ++next;
+                continue;
+            }
+            batch.assign(candidates.begin() + runs[next].begin, candidates.begin() + runs[next].end);
+            ++next;
+        }
+        while (next < runs.size() && (batch.empty() || (readBudget == 0 && batch.size() < kPriorityBatchFiles))) {
+            batch.insert(batch.end(), candidates.begin() + runs[next].begin, candidates.begin() + runs[next].end);
+            ++next;
+        }
+
+        auto signatureGroups = refineBySampling(files, batch, false);
+        if (budgetExhausted()) {
+            // 批内的抽样已因预算中途停止，本批的大小组都没有检查完
+            exhausted = true;
+            unfinishedRuns = runs.size() - batchFirst;
+            break;
+        }
+        if (byReclaimable) {
+            std::stable_sort(signatureGroups.begin(), signatureGroups.end(), [&](const FileGroup& a, const FileGroup& b) {
+                return groupReclaimable(a) > groupReclaimable(b);
+            });
+        }
+
+        PhaseTimer timer(Phase::Verification);
+        for (size_t g = 0; g < signatureGroups.size(); ++g) {
+            if (budgetExhausted()) {
+                exhausted = true;
+                skippedGroups += signatureGroups.size() - g;
+                break;
+            }
+            const FileGroup& signatureGroup = signatureGroups[g];
+            uint64_t groupBytes = static_cast<uint64_t>(files.size(signatureGroup[0])) * signatureGroup.size();
+            if (readBudget > 0 && sampledBytes + verifiedBytes + groupBytes > readBudget) {
+                skippedGroups++;
+                continue;
+            }
+            for (auto& group : findExactDuplicates(files, signatureGroup)) {
+                if (!reportWriter) {
+                    duplicateGroups.push_back(std::move(group));
+                }
+            }
+        }
+        if (exhausted) {
+            unfinishedRuns = runs.size() - next;
+            break;
+        }
+    }
+    budgetStops = false;
+    clearPrehashedGroups();
+
+    if (exhausted) {
+        std::cout << "已到达预算, 检测提前结束: 跳过 " << skippedGroups << " 个候选组, 另有 " << unfinishedRuns
+                  << " 个大小组未检查" << std::endl;
+    } else if (skippedGroups > 0) {
+        std::cout << "剩余读取预算不足以确认 " << skippedGroups << " 个候选组, 已跳过" << std::endl;
+    }
+}
+
+// 流水线模式：枚举、抽样、精确比较三个阶段重叠进行，不保留完整的目录扫描结果
+// 枚举线程每列完一个目录就追加进文件表；某个大小第二次出现后，该大小的文件经有界队列交给
+// 抽样线程计算第 1 轮签名（共享大小的文件都要做这一轮，提前做不会多读）。
+// 任何大小在枚举结束前都可能再出现新文件，所以后续轮次在枚举结束后进行；
+// 每个结束抽样的组立即交给比较线程，确认的重复组当场输出，最终结果按常规模式的顺序整理。
+// 文件表仍然容纳整棵目录树，内存占用随文件数增长
+DeduplicationResult findDuplicatesPipelined(const fs::path& folder) {
+    DeduplicationResult result;
+    FileTable& files = result.files;
+
+    struct SampleTask {
+        uint32_t index;
+        fs::path path;
+        FileMeta meta;
+    };
+
+    // 按物理位置调度和异步读取需要成批排序，第 1 轮不提前进行
+    bool overlapSampling = ioSchedule != "physical" && ioBackend != IoBackend::Async;
+    BoundedQueue<SampleTask> sampleQueue(kPipelineQueueLength);
+    // 提前算出的第 1 轮签名按文件下标存放，随文件表增长；读取失败的留空，第 1 轮时重新读取
+    std::vector<FileSignature> primed;
+    size_t primedCount = 0;
+    std::mutex primedMutex;
+
+    std::vector<std::thread> samplers;
+    if (overlapSampling) {
+        for (size_t t = 0; t < WorkerPool(threadCount).size(); ++t) {
+            samplers.emplace_back([&] {
+                PhaseScope scope(Phase::Sampling);
+                SampleTask task;
+                while (sampleQueue.pop(task)) {
+                    ProgressCounters::setQueueDepth(Phase::Sampling, sampleQueue.size());
+                    FileSignature signature;
+                    try {
+                        signature = generateFileSignature(task.path, 1, &task.meta);
+                    } catch (const std::exception& e) {
+                        std::lock_guard<std::mutex> lock(consoleMutex);
+                        std::cerr << "生成签名失败: " << task.path << " - " << e.what() << std::endl;
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> lock(primedMutex);
+                    primed[task.index] = signature;
+                    primedCount++;
+                }
+            });
+        }
+    }
+
+    // 各大小第一次出现的文件下标，第二次出现后改为 kSharedSize
+    constexpr uint32_t kSharedSize = std::numeric_limits<uint32_t>::max();
+    std::unordered_map<uintmax_t, uint32_t> firstOfSize;
+    auto enqueue = [&](uint32_t index) {
+        FileMeta meta = files.meta(index);
+        if (overlapSampling && !samplePlan(meta.size, 1).empty()) {
+            sampleQueue.push({index, files.path(index), meta});
+            ProgressCounters::setQueueDepth(Phase::Sampling, sampleQueue.size());
+        }
+    };
+
+    // sink 的调用互斥，文件表和大小索引只在这里修改；抽样线程只使用队列中的路径
+    std::optional<PhaseTimer> enumerationTimer(std::in_place, Phase::Enumeration);
+    DirectoryScanner scanner(threadCount, true);
+    size_t nextReport = 100;
+    scanner.stream(folder, [&](const fs::path& dir, const std::string& error) {
+        std::lock_guard<std::mutex> lock(consoleMutex);
+        std::cerr << "遍历目录时出错: " << dir << " - " << error << std::endl;
+    }, [&](ScannedDirectory&& directory) {
+        uint32_t first = files.appendDirectory(std::move(directory));
+        if (overlapSampling) {
+            std::lock_guard<std::mutex> lock(primedMutex);
+            primed.resize(files.fileCount());
+        }
+        for (uint32_t index = first; index < files.fileCount(); ++index) {
+            if (files.size(index) < minFileSize) {
+                continue;
+            }
+            auto inserted = firstOfSize.emplace(files.size(index), index);
+            if (inserted.second) {
+                continue;
+            }
+            if (inserted.first->second != kSharedSize) {
+                enqueue(inserted.first->second);
+                inserted.first->second = kSharedSize;
+            }
+            enqueue(index);
+        }
+        if (verbose && !showProgress && files.fileCount() >= nextReport) {
+            std::lock_guard<std::mutex> lock(consoleMutex);
+            std::cout << "已扫描 " << files.fileCount() << " 个文件..." << std::endl;
+            nextReport = (files.fileCount() / 100 + 1) * 100;
+        }
+    });
+    files.finishAppend();
+    PhaseProfiler::countFiles(Phase::Enumeration, 0, files.fileCount());
+    enumerationTimer.reset();
+    firstOfSize = std::unordered_map<uintmax_t, uint32_t>();
+    sampleQueue.close();
+    for (auto& th : samplers) {
+        th.join();
+    }
+
+    result.totalFiles = static_cast<int>(files.fileCount());
+    for (uint32_t i = 0; i < files.fileCount(); ++i) {
+        result.totalSize += files.size(i);
+    }
+
+    std::cout << "扫描完成，共找到 " << result.totalFiles << " 个文件" << std::endl;
+    if (verbose) {
+        std::cout << "文件表占用内存: " << formatFileSize(files.memoryBytes()) << std::endl;
+    }
+
+    // 抽样结束的组立即进入比较线程，与剩余轮次的抽样并行
+    std::vector<uint32_t> samplingTasks = collectSizeCandidates(files);
+    std::cout << "正在分析文件内容... (" << samplingTasks.size() << " 个候选文件, "
+              << WorkerPool(threadCount).size() << " 个线程, 扫描期间已抽样 " << primedCount << " 个)" << std::endl;
+
+    // 候选组内先按路径排序，使比较结果与常规模式一致；确认的组记下所属候选组和组内序号以便最后排序
+    struct ConfirmedGroup {
+        uint32_t candidate;
+        size_t ordinal;
+        FileGroup group;
+    };
+    std::vector<ConfirmedGroup> confirmed;
+
+    BoundedQueue<FileGroup> verifyQueue(kPipelineQueueLength);
+    std::thread verifier([&] {
+        PhaseTimer timer(Phase::Verification);
+        FileGroup candidateGroup;
+        while (verifyQueue.pop(candidateGroup)) {
+            ProgressCounters::setQueueDepth(Phase::Verification, verifyQueue.size());
+            std::sort(candidateGroup.begin(), candidateGroup.end(), [&](uint32_t a, uint32_t b) {
+                return files.pathLess(a, b);
+            });
+            auto groups = findExactDuplicates(files, candidateGroup);
+            for (size_t k = 0; k < groups.size(); ++k) {
+                {
+                    std::lock_guard<std::mutex> lock(consoleMutex);
+                    std::cout << "  确认重复: " << groups[k].size() << " 个文件, 每个 "
+                              << formatFileSize(files.size(groups[k][0])) << " - " << files.path(groups[k][0]) << std::endl;
+                }
+                if (!reportWriter) {
+                    confirmed.push_back({candidateGroup[0], k, std::move(groups[k])});
+                }
+            }
+        }
+    });
+    refineBySampling(files, samplingTasks, true, &primed, [&](FileGroup&& group) {
+        verifyQueue.push(std::move(group));
+        ProgressCounters::setQueueDepth(Phase::Verification, verifyQueue.size());
+    });
+    verifyQueue.close();
+    verifier.join();
+    clearPrehashedGroups();
+
+    std::sort(confirmed.begin(), confirmed.end(), [&](const ConfirmedGroup& a, const ConfirmedGroup& b) {
+        if (a.candidate != b.candidate) {
+            if (files.size(a.candidate) != files.size(b.candidate)) return files.size(a.candidate) < files.size(b.candidate);
+            return files.pathLess(a.candidate, b.candidate);
+        }
+        return a.ordinal < b.ordinal;
+    });
+    for (auto& entry : confirmed) {
+        result.duplicateGroups.push_back(std::move(entry.group));
+    }
+
+    std::cout << "读取量: 抽样 " << formatFileSize(sampledBytes) << ", 精确比较 "
+              << formatFileSize(verifiedBytes) << std::endl;
+
+    return result;
+}
+
+private:
+
+    // 重复文件处理方式在提示信息中的说法
+    const char* actionVerb() const {
+        switch (action) {
+            case DuplicateAction::Hardlink: return "替换为硬链接";
+            case DuplicateAction::Reflink: return "替换为克隆";
+            case DuplicateAction::Symlink: return "替换为符号链接";
+            default: return "删除";
+        }
+    }
+
+    // "删除<对象>" 或 "将<对象>替换为..."
+    std::string actionPhrase(const std::string& object) const {
+        if (action == DuplicateAction::Delete) {
+            return "删除" + object;
+        }
+        return "将" + object + actionVerb();
+    }
+
+    // 保留的文件在一批处理前的重新检查结果
+    struct KeptCheck {
+        uint32_t source;
+        FileMeta meta;
+        std::string error;   // 空表示扫描后未变
+    };
+
+    // 重新读取保留文件的元数据，在扫描后被修改过或已不存在时记下原因：保留的文件变了，
+    // 删除会丢掉最后一份内容，替换会链接到不同的内容
+    KeptCheck checkKeptFile(const FileTable& files, uint32_t source) {
+        KeptCheck check{source, {}, {}};
+        fs::path sourcePath = files.path(source);
+        try {
+            check.meta = statFileMeta(sourcePath);
+            if (const char* reason = metaChangeReason(files.meta(source), check.meta)) {
+                check.error = std::string("保留的文件在扫描后") + reason + ": " + sourcePath.string();
+            }
+        } catch (const std::exception& e) {
+            check.error = e.what();
+        }
+        return check;
+    }
+
+    // 处理一个不保留的重复文件，返回回收的字节数
+    // 处理前重新读取该文件的元数据，扫描后被修改过或已不存在时不处理；保留的文件未通过 kept
+    // 的检查时也不处理。两者已经是同一个文件时跳过
+    uintmax_t disposeDuplicate(const FileTable& files, const KeptCheck& kept, uint32_t target) {
+        fs::path targetPath = files.path(target);
+        FileMeta current = statFileMeta(targetPath);
+        if (const char* reason = metaChangeReason(files.meta(target), current)) {
+            throw std::runtime_error(std::string("文件在扫描后") + reason);
+        }
+        if (!kept.error.empty()) {
+            throw std::runtime_error(kept.error);
+        }
+        if (sameFileIdentity(kept.meta, current)) {
+            return 0;
+        }
+
+        if (action == DuplicateAction::Delete) {
+            fs::remove(targetPath);
+        } else {
+            replaceWithLink(files.path(kept.source), targetPath, action);
+        }
+        return current.size;
+    }
+
+    // 按保留方案处理所有不保留的文件：每批 kDisposalBatchFiles 个在工作线程上并行删除 / 替换，
+    // 批内结果按组内顺序写入缓冲，每批输出一次。每个文件处理前重新读取自身的元数据，
+    // 保留的文件每批只读取一次，供它的所有重复文件共用
+    void executeDisposal(const FileTable& files, const std::vector<FileGroup>& duplicateGroups,
+                         const std::vector<std::set<size_t>>& keepFiles) {
+        PhaseTimer timer(Phase::Deletion);
+        std::cout << "\n开始" << actionPhrase("重复文件") << "..." << std::endl;
+
+        struct Disposal {
+            uint32_t source;     // 组内第一个保留的文件，链接方式的目标
+            uint32_t target;
+            size_t position;     // 在组内的序号，从 1 开始
+            uintmax_t reclaimed;
+            std::string error;   // 空表示成功
+        };
+        std::vector<Disposal> disposals;
+        for (size_t groupIndex = 0; groupIndex < duplicateGroups.size(); ++groupIndex) {
+            const auto& group = duplicateGroups[groupIndex];
+            const auto& keepSet = keepFiles[groupIndex];
+
+            for (size_t i = 0; i < group.size(); ++i) {
+                // 如果文件不在保留列表中，则删除 (或替换为指向第一个保留文件的链接)
+                if (keepSet.find(i + 1) == keepSet.end()) {
+                    disposals.push_back({group[*keepSet.begin() - 1], group[i], i + 1, files.size(group[i]), {}});
+                }
+            }
+        }
+
+        int successfullyDeleted = 0;
+        int failedToDelete = 0;
+        uintmax_t actualSpaceSaved = 0;
+        WorkerPool pool(threadCount);
+        ProgressCounters::expect(Phase::Deletion, disposals.size(), 0);
+
+        for (size_t batchBegin = 0; batchBegin < disposals.size(); batchBegin += kDisposalBatchFiles) {
+            size_t batchEnd = std::min(disposals.size(), batchBegin + kDisposalBatchFiles);
+            if (!dryRun) {
+                std::vector<uint32_t> sources;
+                for (size_t k = batchBegin; k < batchEnd; ++k) {
+                    sources.push_back(disposals[k].source);
+                }
+                std::sort(sources.begin(), sources.end());
+                sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+                std::vector<KeptCheck> keptChecks(sources.size());
+                pool.parallelFor(sources.size(), [&](size_t k) {
+                    keptChecks[k] = checkKeptFile(files, sources[k]);
+                });
+
+                pool.parallelFor(batchEnd - batchBegin, [&](size_t k) {
+                    Disposal& disposal = disposals[batchBegin + k];
+                    size_t keptIndex = std::lower_bound(sources.begin(), sources.end(), disposal.source) - sources.begin();
+                    try {
+                        disposal.reclaimed = disposeDuplicate(files, keptChecks[keptIndex], disposal.target);
+                    } catch (const std::exception& e) {
+                        disposal.error = e.what();
+                    }
+                });
+            }
+
+            // 失败信息写 stderr 前先输出已缓冲的内容，保持两者的先后顺序
+            std::ostringstream buffered;
+            for (size_t k = batchBegin; k < batchEnd; ++k) {
+                const Disposal& disposal = disposals[k];
+                fs::path path = files.path(disposal.target);
+                if (disposal.error.empty()) {
+                    buffered << (dryRun ? "✓ [模拟] 将" : "✓ 已") << actionVerb() << ": [" << disposal.position << "] "
+                             << path.filename() << '\n';
+                    successfullyDeleted++;
+                    actualSpaceSaved += disposal.reclaimed;
+                } else {
+                    std::cout << buffered.str() << std::flush;
+                    buffered.str("");
+                    std::cerr << "✗ " << actionVerb() << "失败: [" << disposal.position << "] " << path
+                              << " - " << disposal.error << std::endl;
+                    failedToDelete++;
+                }
+            }
+            std::cout << buffered.str() << std::flush;
+            ProgressCounters::advance(Phase::Deletion, batchEnd - batchBegin);
+        }
+        PhaseProfiler::countFiles(Phase::Deletion, disposals.size(), successfullyDeleted);
+
+        std::cout << "\n" << std::string(50, '=') << std::endl;
+        std::cout << actionVerb() << "操作完成!" << std::endl;
+        std::cout << std::string(50, '=') << std::endl;
+        std::cout << "成功" << actionVerb() << ": " << successfullyDeleted << " 个文件" << std::endl;
+
+        if (failedToDelete > 0) {
+            std::cout << actionVerb() << "失败: " << failedToDelete << " 个文件" << std::endl;
+        }
+
+        std::cout << "实际节省: " << formatFileSize(actualSpaceSaved) << std::endl;
+
+        if (dryRun) {
+            std::cout << "注意: 这是模拟运行，没有实际" << (action == DuplicateAction::Delete ? "删除" : "修改") << "文件" << std::endl;
+        }
+    }
+
+    // 跨组核对：规范化后的路径或文件身份 (卷 + 文件 ID) 出现在多个组中的组全部跳过。
+    // 执行器在每批开始前核对保留的文件，一个组保留的文件若是另一组的待处理文件，
+    // 两组可能在同一批内互相删除对方保留的那一份
+    void skipSharedPlannedGroups(std::vector<std::vector<PlannedFile>>& groups, std::vector<std::string>& logs) {
+        std::map<fs::path, size_t> pathOwner;
+        std::map<std::tuple<uint64_t, uint64_t, uint64_t>, size_t> identityOwner;
+        std::vector<char> shared(groups.size(), 0);
+        auto claim = [&](auto& owners, const auto& key, size_t g, const fs::path& path) {
+            auto inserted = owners.emplace(key, g);
+            size_t other = inserted.first->second;
+            if (!inserted.second && other != g) {
+                for (size_t h : {g, other}) {
+                    if (!shared[h]) {
+                        logs[h] += "  跳过整组: 与其他组共用文件 " + path.string() + '\n';
+                    }
+                    shared[h] = 1;
+                }
+            }
+        };
+        for (size_t g = 0; g < groups.size(); ++g) {
+            for (const auto& file : groups[g]) {
+                claim(pathOwner, fs::absolute(file.path).lexically_normal(), g, file.path);
+                if (file.meta.hasIdentity()) {
+                    claim(identityOwner, std::make_tuple(file.meta.volume, file.meta.fileId[0], file.meta.fileId[1]), g,
+                          file.path);
+                }
+            }
+        }
+        for (size_t g = 0; g < groups.size(); ++g) {
+            if (shared[g]) {
+                groups[g].clear();
+            }
+        }
+    }
+
+    // 核对保留方案中的一组：去掉已不存在、与方案记录不一致或与某个保留文件是同一个文件的文件，
+    // --recheck 时再去掉内容与保留文件不同的 (compareBytes 时逐字节比较)；组内有重复路径时整组跳过；
+    // 没有保留的文件或没有待处理的文件时清空整组。返回需要输出的说明，全部通过时为空
+    std::string checkPlannedGroup(std::vector<PlannedFile>& group, bool compareBytes) {
+        std::ostringstream log;
+        if (std::none_of(group.begin(), group.end(), [](const PlannedFile& file) { return file.keep; })) {
+            group[0].keep = true;
+        }
+
+        // 同一路径 (规范化后) 在组内出现多次时无法确定哪一份保留，整组跳过
+        std::set<fs::path> seen;
+        for (const auto& file : group) {
+            if (!seen.insert(fs::absolute(file.path).lexically_normal()).second) {
+                log << "  跳过整组: 路径重复出现 " << file.path << '\n';
+                group.clear();
+                return log.str();
+            }
+        }
+
+        std::vector<PlannedFile> checked;
+        for (auto& file : group) {
+            std::string reason;
+            try {
+                FileMeta current = statFileMeta(file.path);
+                if (const char* changed = metaChangeReason(file.meta, current)) {
+                    reason = changed;
+                } else {
+                    file.meta = current;
+                }
+            } catch (const std::exception& e) {
+                reason = e.what();
+            }
+            if (reason.empty()) {
+                checked.push_back(std::move(file));
+            } else {
+                log << "  跳过 " << file.path << ": " << reason << '\n';
+            }
+        }
+
+        // 经由 ./、符号链接的上级目录或硬链接指向某个保留文件的待处理文件就是保留的数据本身，不能处理
+        std::vector<PlannedFile> distinct;
+        for (auto& file : checked) {
+            bool aliasOfKept = !file.keep && std::any_of(checked.begin(), checked.end(), [&](const PlannedFile& kept) {
+                return kept.keep && sameFileIdentity(kept.meta, file.meta);
+            });
+            if (aliasOfKept) {
+                log << "  跳过 " << file.path << ": 与保留的文件是同一个文件\n";
+            } else {
+                distinct.push_back(std::move(file));
+            }
+        }
+        checked = std::move(distinct);
+
+        auto reference = std::find_if(checked.begin(), checked.end(), [](const PlannedFile& file) { return file.keep; });
+        if ((recheckPlan || compareBytes) && reference != checked.end()) {
+            // 只按全文摘要确认的组和不抽样的小文件直接逐字节比较
+            bool small = compareBytes || samplePlan(reference->meta.size, kRecheckRound).empty();
+            fs::path referencePath = reference->path;
+            try {
+                FileSignature expected;
+                if (!small) {
+                    expected = generateFileSignature(referencePath, kRecheckRound, &reference->meta);
+                }
+                std::vector<PlannedFile> matched;
+                for (auto& file : checked) {
+                    std::string reason;
+                    if (!file.keep) {
+                        try {
+                            bool same = small ? areFilesIdentical(referencePath, file.path)
+                                              : generateFileSignature(file.path, kRecheckRound, &file.meta) == expected;
+                            if (!same) {
+                                reason = "内容与保留的文件不同";
+                            }
+                        } catch (const std::exception& e) {
+                            reason = e.what();
+                        }
+                    }
+                    if (reason.empty()) {
+                        matched.push_back(std::move(file));
+                    } else {
+                        log << "  跳过 " << file.path << ": " << reason << '\n';
+                    }
+                }
+                checked = std::move(matched);
+            } catch (const std::exception& e) {
+                log << "  跳过整组: 无法读取保留的文件 " << referencePath << " - " << e.what() << '\n';
+                checked.clear();
+            }
+        }
+
+        bool hasKeep = std::any_of(checked.begin(), checked.end(), [](const PlannedFile& file) { return file.keep; });
+        bool hasDisposal = std::any_of(checked.begin(), checked.end(), [](const PlannedFile& file) { return !file.keep; });
+        if (!hasKeep || !hasDisposal) {
+            if (!hasKeep && !checked.empty()) {
+                log << "  跳过整组: 保留的文件未通过核对\n";
+            }
+            checked.clear();
+        }
+        group = std::move(checked);
+        return log.str();
+    }
+
+};
+
+// 分布式模式：工作节点在本地枚举和抽样，只把 (大小, 签名, 文件下标) 发给协调节点；
+// 协调节点合并各节点的大小组和签名组，再把候选组发回数据所在的节点比较，不经网络传输文件内容。
+// 协议为 TCP 上的长度前缀消息：u32 负载长度, u8 类型, 负载；整数均为本机字节序 (小端)
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+constexpr SocketHandle kInvalidSocket = INVALID_SOCKET;
+
+inline void closeSocket(SocketHandle handle) {
+    closesocket(handle);
+}
+
+inline std::string socketError() {
+    return "错误码 " + std::to_string(WSAGetLastError());
+}
+#else
+using SocketHandle = int;
+constexpr SocketHandle kInvalidSocket = -1;
+
+inline void closeSocket(SocketHandle handle) {
+    ::close(handle);
+}
+
+inline std::string socketError() {
+    return std::strerror(errno);
+}
+#endif
+
+inline void initializeSockets() {
+#ifdef _WIN32
+    static bool initialized = [] {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            throw std::runtime_error("初始化 Winsock 失败");
+        }
+        return true;
+    }();
+    (void)initialized;
+#endif
+}
+
+// 已连接的 TCP 套接字，只能移动
+class TcpSocket {
+private:
+    SocketHandle handle = kInvalidSocket;
+
+public:
+    TcpSocket() = default;
+
+    explicit TcpSocket(SocketHandle socketHandle) : handle(socketHandle) {
+#ifdef SO_NOSIGPIPE
+        int enable = 1;
+        setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+        int noDelay = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    }
+
+    ~TcpSocket() {
+        if (handle != kInvalidSocket) {
+            closeSocket(handle);
+        }
+    }
+
+    TcpSocket(TcpSocket&& other) noexcept : handle(other.handle) {
+        other.handle = kInvalidSocket;
+    }
+
+    TcpSocket& operator=(TcpSocket&& other) noexcept {
+        if (this != &other) {
+            if (handle != kInvalidSocket) {
+                closeSocket(handle);
+            }
+            handle = other.handle;
+            other.handle = kInvalidSocket;
+        }
+        return *this;
+    }
+
+    TcpSocket(const TcpSocket&) = delete;
+    TcpSocket& operator=(const TcpSocket&) = delete;
+
+    static TcpSocket connect(const std::string& host, const std::string& port) {
+        initializeSockets();
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+        if (status != 0) {
+            throw std::runtime_error("无法解析地址 " + host + ":" + port + " - " + gai_strerror(status));
+        }
+        std::string error = "没有可用的地址";
+        for (addrinfo* address = addresses; address; address = address->ai_next) {
+            SocketHandle handle = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (handle == kInvalidSocket) {
+                error = socketError();
+                continue;
+            }
+            if (::connect(handle, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0) {
+                freeaddrinfo(addresses);
+                return TcpSocket(handle);
+            }
+            error = socketError();
+            closeSocket(handle);
+        }
+        freeaddrinfo(addresses);
+        throw std::runtime_error("无法连接 " + host + ":" + port + " - " + error);
+    }
+
+    void sendAll(const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL;
+#else
+        const int flags = 0;
+#endif
+        while (length > 0) {
+            int chunk = static_cast<int>(std::min<size_t>(length, 1 << 30));
+            auto sent = ::send(handle, bytes, chunk, flags);
+            if (sent <= 0) {
+                throw std::runtime_error("发送失败: " + socketError());
+            }
+            bytes += sent;
+            length -= static_cast<size_t>(sent);
+        }
+    }
+
+    void receiveAll(void* data, size_t length) {
+        char* bytes = static_cast<char*>(data);
+        while (length > 0) {
+            int chunk = static_cast<int>(std::min<size_t>(length, 1 << 30));
+            auto received = ::recv(handle, bytes, chunk, 0);
+            if (received == 0) {
+                throw std::runtime_error("连接已关闭");
+            }
+            if (received < 0) {
+                throw std::runtime_error("接收失败: " + socketError());
+            }
+            bytes += received;
+            length -= static_cast<size_t>(received);
+        }
+    }
+
+    // 读取已到达的数据，最多 length 字节；连接关闭时返回 0
+    size_t receiveSome(void* data, size_t length) {
+        auto received = ::recv(handle, static_cast<char*>(data), static_cast<int>(std::min<size_t>(length, 1 << 30)), 0);
+        if (received < 0) {
+            throw std::runtime_error("接收失败: " + socketError());
+        }
+        return static_cast<size_t>(received);
+    }
+
+    // 接收超时 (毫秒)，超时后接收调用报错
+    void setReceiveTimeout(int milliseconds) {
+#ifdef _WIN32
+        DWORD timeout = static_cast<DWORD>(milliseconds);
+#else
+        timeval timeout = {milliseconds / 1000, (milliseconds % 1000) * 1000};
+#endif
+        setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    }
+};
+
+// 监听套接字：address 为空时监听所有地址
+class TcpListener {
+private:
+    SocketHandle handle = kInvalidSocket;
+    bool loopback = false;
+
+    static bool isLoopbackAddress(const sockaddr* address) {
+        if (address->sa_family == AF_INET) {
+            const auto* v4 = reinterpret_cast<const sockaddr_in*>(address);
+            return (ntohl(v4->sin_addr.s_addr) >> 24) == 127;
+        }
+        if (address->sa_family == AF_INET6) {
+            const unsigned char* bytes = reinterpret_cast<const sockaddr_in6*>(address)->sin6_addr.s6_addr;
+            static const unsigned char kLoopback[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+            static const unsigned char kMappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+            return std::memcmp(bytes, kLoopback, 16) == 0 ||
+                   (std::memcmp(bytes, kMappedPrefix, 12) == 0 && bytes[12] == 127);
+        }
+        return false;
+    }
+
+public:
+    TcpListener(const std::string& address, const std::string& port) {
+        initializeSockets();
+        addrinfo hints = {};
+        hints.ai_family = address.empty() ? AF_INET6 : AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* addresses = nullptr;
+        int status = getaddrinfo(address.empty() ? nullptr : address.c_str(), port.c_str(), &hints, &addresses);
+        if (status != 0) {
+            throw std::runtime_error("无法解析监听地址 " + address + ":" + port + " - " + gai_strerror(status));
+        }
+        std::string error = "没有可用的地址";
+        for (addrinfo* entry = addresses; entry && handle == kInvalidSocket; entry = entry->ai_next) {
+            SocketHandle candidate = ::socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+            if (candidate == kInvalidSocket) {
+                error = socketError();
+                continue;
+            }
+            int enable = 1;
+            setsockopt(candidate, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enable), sizeof(enable));
+            if (entry->ai_family == AF_INET6) {
+                // 同时接受 IPv4 连接
+                int v6Only = 0;
+                setsockopt(candidate, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<const char*>(&v6Only), sizeof(v6Only));
+            }
+            if (::bind(candidate, entry->ai_addr, static_cast<int>(entry->ai_addrlen)) == 0 &&
+                ::listen(candidate, 16) == 0) {
+                handle = candidate;
+                loopback = isLoopbackAddress(entry->ai_addr);
+            } else {
+                error = socketError();
+                closeSocket(candidate);
+            }
+        }
+        freeaddrinfo(addresses);
+        if (handle == kInvalidSocket) {
+            throw std::runtime_error("无法监听 " + address + ":" + port + " - " + error);
+        }
+    }
+
+    ~TcpListener() {
+        closeSocket(handle);
+    }
+
+    TcpListener(const TcpListener&) = delete;
+    TcpListener& operator=(const TcpListener&) = delete;
+
+    // 只能从本机连接 (监听的是回环地址)
+    bool loopbackOnly() const {
+        return loopback;
+    }
+
+    // 等待最多 milliseconds 毫秒，有连接可以接受时返回 true
+    bool waitForClient(int milliseconds) {
+#ifdef _WIN32
+        WSAPOLLFD entry = {handle, POLLRDNORM, 0};
+        return WSAPoll(&entry, 1, milliseconds) > 0;
+#else
+        pollfd entry = {handle, POLLIN, 0};
+        return ::poll(&entry, 1, milliseconds) > 0;
+#endif
+    }
+
+    TcpSocket accept() {
+        SocketHandle client = ::accept(handle, nullptr, nullptr);
+        if (client == kInvalidSocket) {
+            throw std::runtime_error("接受连接失败: " + socketError());
+        }
+        return TcpSocket(client);
+    }
+};
+
+// 分布式协议的消息类型；工作节点对每个请求回复 Result 或 Error
+enum class WireType : uint8_t {
+    Hello = 1,     // u32 协议版本, 令牌, u64 抽样点数, u64 抽样块大小, 比较方式
+    Scan = 2,      // 根目录 → u32 文件数, 每个文件 u32 下标, u64 大小 (同大小的硬链接只留一个)
+    Sign = 3,      // u32 轮次, 下标列表 → 每个文件 u8 是否成功, 签名
+    Hash = 4,      // 下标列表 → 每个文件 u8 是否成功, u64 摘要低位, u64 摘要高位
+    Verify = 5,    // u32 组数, 每组下标列表 → 每组 u32 重复组数, 每个重复组下标列表
+    Describe = 6,  // 下标列表 → 每个文件 路径, i64 修改时间, u64 卷号, u64 文件 ID 低位, u64 文件 ID 高位
+    Result = 0x80,
+    Error = 0xFF   // 错误信息
+};
+
+constexpr uint32_t kWireVersion = 1;
+constexpr uint32_t kMaxWireMessage = 1u << 30;
+constexpr uint32_t kMaxHelloMessage = 64 * 1024;  // 通过令牌校验之前接受的消息长度上限
+constexpr uint64_t kMaxWireSamplePoints = 1024;        // Hello 中抽样点数的上限
+constexpr uint64_t kMaxWireSampleSize = 16 * 1024 * 1024;  // Hello 中抽样块大小的上限
+
+inline void sendMessage(TcpSocket& socket, WireType type, const std::string& payload) {
+    if (payload.size() >= kMaxWireMessage) {
+        throw std::length_error("消息超过 1 GB");
+    }
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    char header[5];
+    std::memcpy(header, &length, sizeof(length));
+    header[4] = static_cast<char>(type);
+    socket.sendAll(header, sizeof(header));
+    socket.sendAll(payload.data(), payload.size());
+}
+
+// maxLength 为接受的负载长度上限，超过时不分配内存，直接报错
+inline WireType receiveMessage(TcpSocket& socket, std::string& payload, uint32_t maxLength = kMaxWireMessage) {
+    char header[5];
+    socket.receiveAll(header, sizeof(header));
+    uint32_t length;
+    std::memcpy(&length, header, sizeof(length));
+    if (length >= maxLength) {
+        throw std::runtime_error("消息长度无效");
+    }
+    payload.resize(length);
+    socket.receiveAll(&payload[0], length);
+    return static_cast<WireType>(static_cast<uint8_t>(header[4]));
+}
+
+// 比较令牌，耗时只取决于本节点令牌的长度，不随第一个不同字符的位置变化
+inline bool tokenMatches(const std::string& received, const std::string& expected) {
+    unsigned char difference = received.size() == expected.size() ? 0 : 1;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        unsigned char byte = i < received.size() ? static_cast<unsigned char>(received[i]) : 0;
+        difference |= static_cast<unsigned char>(byte ^ static_cast<unsigned char>(expected[i]));
+    }
+    return difference == 0;
+}
+
+// 工作节点：逐个接受协调节点的连接，每个连接是一次会话；会话内扫描得到的文件表只在本节点使用，
+// 对外以文件表下标引用文件。抽样参数取自协调节点，保证各节点的签名可以直接比较。
+// 会话在 kHelloTimeoutMs 内没有发来 Hello 或 Hello 过长时断开，连上却不发送的对端不会一直占住工作节点
+class DistributedWorker {
+private:
+    static constexpr int kHelloTimeoutMs = 10000;
+
+    DeduplicatorOptions baseOptions;
+    std::string token;
+
+    void handleSession(TcpSocket& socket) {
+        std::string payload;
+        socket.setReceiveTimeout(kHelloTimeoutMs);
+        if (receiveMessage(socket, payload, kMaxHelloMessage) != WireType::Hello) {
+            throw std::runtime_error("会话没有以 Hello 开始");
+        }
+        WireReader hello(payload);
+        uint32_t version = hello.get<uint32_t>();
+        std::string peerToken = hello.getString();
+        DeduplicatorOptions options = baseOptions;
+        uint64_t samplePoints = hello.get<uint64_t>();
+        uint64_t sampleSize = hello.get<uint64_t>();
+        options.verifyMode = hello.getString();
+        options.autoConfirm = true;
+        if (version != kWireVersion) {
+            sendMessage(socket, WireType::Error, "协议版本不一致");
+            return;
+        }
+        if (!tokenMatches(peerToken, token)) {
+            sendMessage(socket, WireType::Error, "令牌不正确");
+            return;
+        }
+        // 抽样参数和比较方式来自对端，超出范围的不接受，对端不能让工作节点分配任意大的读取缓冲
+        if (samplePoints == 0 || samplePoints > kMaxWireSamplePoints || sampleSize == 0 ||
+            sampleSize > kMaxWireSampleSize) {
+            sendMessage(socket, WireType::Error, "抽样参数超出范围");
+            return;
+        }
+        if (options.verifyMode != "lockstep" && options.verifyMode != "hash" && options.verifyMode != "pairwise") {
+            sendMessage(socket, WireType::Error, "无效的比较方式");
+            return;
+        }
+        options.samplePoints = static_cast<size_t>(samplePoints);
+        options.sampleSize = static_cast<size_t>(sampleSize);
+        // 通过校验后协调节点可能要等其他节点很久才发来下一个请求，不再限时
+        socket.setReceiveTimeout(0);
+        InteractiveFileDeduplicator dedup(options);
+        sendMessage(socket, WireType::Result, std::string());
+
+        FileTable files;
+        auto checkRefs = [&](const std::vector<uint32_t>& refs) {
+            for (uint32_t ref : refs) {
+                if (ref >= files.fileCount()) {
+                    throw std::runtime_error("文件下标超出范围");
+                }
+            }
+        };
+
+        for (;;) {
+            WireType type;
+            try {
+                type = receiveMessage(socket, payload);
+            } catch (const std::exception&) {
+                break;  // 协调节点结束会话
+            }
+
+            WireWriter reply;
+            try {
+                WireReader request(payload);
+                switch (type) {
+                    case WireType::Scan: {
+                        fs::path root = utf8ToPath(request.getString());
+                        std::error_code error;
+                        if (!fs::is_directory(root, error)) {
+                            throw std::runtime_error("目录不存在: " + pathToUtf8(root));
+                        }
+                        std::cout << "扫描: " << root << std::endl;
+                        files = FileTable();
+                        {
+                            PhaseTimer timer(Phase::Enumeration);
+                            DirectoryScanner scanner(options.threadCount, true);
+                            files.append(scanner.scan(root, [&](const fs::path& dir, const std::string& error) {
+                                std::cerr << "遍历目录时出错: " << dir << " - " << error << std::endl;
+                            }));
+                            PhaseProfiler::countFiles(Phase::Enumeration, 0, files.fileCount());
+                        }
+
+                        // 按大小排序后合并硬链接；本节点上唯一的大小也要发出，可能与其他节点的文件重复
+                        std::vector<uint32_t> order(files.fileCount());
+                        for (uint32_t i = 0; i < order.size(); ++i) {
+                            order[i] = i;
+                        }
+                        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                            if (files.size(a) != files.size(b)) return files.size(a) < files.size(b);
+                            return files.pathLess(a, b);
+                        });
+                        std::vector<uint32_t> shipped;
+                        size_t linkedCount = 0;
+                        for (size_t begin = 0; begin < order.size();) {
+                            size_t end = begin + 1;
+                            while (end < order.size() && files.size(order[end]) == files.size(order[begin])) {
+                                ++end;
+                            }
+                            FileGroup group = dedup.collapseHardLinks(files, order.begin() + begin, order.begin() + end,
+                                                                      linkedCount);
+                            shipped.insert(shipped.end(), group.begin(), group.end());
+                            begin = end;
+                        }
+                        reply.put(static_cast<uint32_t>(shipped.size()));
+                        for (uint32_t ref : shipped) {
+                            reply.put(ref);
+                            reply.put(static_cast<uint64_t>(files.size(ref)));
+                        }
+                        std::cout << "扫描完成: " << files.fileCount() << " 个文件" << std::endl;
+                        break;
+                    }
+                    case WireType::Sign: {
+                        uint32_t round = request.get<uint32_t>();
+                        std::vector<uint32_t> refs = request.getRefs();
+                        checkRefs(refs);
+                        std::vector<FileSignature> signatures(refs.size());
+                        std::vector<char> valid(refs.size(), 0);
+                        std::atomic<int> samplingCount{0};
+                        {
+                            PhaseTimer timer(Phase::Sampling);
+                            dedup.computeRoundSignatures(files, round, refs, nullptr, signatures, valid, samplingCount);
+                        }
+                        for (size_t i = 0; i < refs.size(); ++i) {
+                            reply.put(static_cast<uint8_t>(valid[i]));
+                            reply.put(signatures[i].size);
+                            reply.put(signatures[i].flags);
+                            reply.put(signatures[i].sampleCount);
+                            reply.put(signatures[i].samples.lo);
+                            reply.put(signatures[i].samples.hi);
+                        }
+                        break;
+                    }
+                    case WireType::Hash: {
+                        std::vector<uint32_t> refs = request.getRefs();
+                        checkRefs(refs);
+                        std::vector<std::optional<Digest128>> digests(refs.size());
+                        {
+                            PhaseTimer timer(Phase::Verification);
+                            WorkerPool(options.threadCount).parallelFor(refs.size(), [&](size_t i) {
+                                try {
+                                    digests[i] = dedup.hashFileContent(files.path(refs[i]));
+                                } catch (const std::exception& e) {
+                                    std::cerr << "比较文件失败: " << files.path(refs[i]) << " - " << e.what() << std::endl;
+                                }
+                            });
+                        }
+                        for (const auto& digest : digests) {
+                            reply.put(static_cast<uint8_t>(digest ? 1 : 0));
+                            reply.put(digest ? digest->lo : 0);
+                            reply.put(digest ? digest->hi : 0);
+                        }
+                        break;
+                    }
+                    case WireType::Verify: {
+                        uint32_t groupCount = request.get<uint32_t>();
+                        std::vector<FileGroup> groups(groupCount);
+                        for (auto& group : groups) {
+                            group = request.getRefs();
+                            checkRefs(group);
+                        }
+                        std::vector<std::vector<FileGroup>> results(groups.size());
+                        {
+                            PhaseTimer timer(Phase::Verification);
+                            WorkerPool(options.threadCount).parallelFor(groups.size(), [&](size_t g) {
+                                results[g] = dedup.findExactDuplicates(files, groups[g]);
+                            });
+                        }
+                        for (const auto& result : results) {
+                            reply.put(static_cast<uint32_t>(result.size()));
+                            for (const auto& group : result) {
+                                reply.putRefs(group);
+                            }
+                        }
+                        break;
+                    }
+                    case WireType::Describe: {
+                        std::vector<uint32_t> refs = request.getRefs();
+                        checkRefs(refs);
+                        for (uint32_t ref : refs) {
+                            FileMeta meta = files.meta(ref);
+                            reply.putString(pathToUtf8(fs::absolute(files.path(ref))));
+                            reply.put(meta.mtimeNs);
+                            reply.put(meta.volume);
+                            reply.put(meta.fileId[0]);
+                            reply.put(meta.fileId[1]);
+                        }
+                        break;
+                    }
+                    default:
+                        throw std::runtime_error("未知的请求类型");
+                }
+            } catch (const std::exception& e) {
+                sendMessage(socket, WireType::Error, e.what());
+                continue;
+            }
+            sendMessage(socket, WireType::Result, reply.data);
+        }
+        dedup.saveSignatureCache();
+    }
+
+public:
+    DistributedWorker(const DeduplicatorOptions& options, const std::string& sharedToken)
+        : baseOptions(options), token(sharedToken) {}
+
+    // 一直运行，逐个处理连接；单个会话出错只结束该会话。
+    // 会话可以让本节点扫描任意目录并返回完整路径，所以监听非回环地址时必须设置令牌
+    void serve(const std::string& address, const std::string& port) {
+        TcpListener listener(address, port);
+        if (!listener.loopbackOnly() && token.empty()) {
+            throw std::runtime_error("监听非回环地址 " + (address.empty() ? std::string("*") : address) +
+                                     " 时必须用 --token 设置令牌");
+        }
+        std::cout << "工作节点已启动, 监听 " << (address.empty() ? "*" : address) << ":" << port << std::endl;
+        for (;;) {
+            TcpSocket socket = listener.accept();
+            std::cout << "协调节点已连接" << std::endl;
+            try {
+                handleSession(socket);
+            } catch (const std::exception& e) {
+                std::cerr << "会话出错: " << e.what() << std::endl;
+            }
+            std::cout << "会话结束" << std::endl;
+        }
+    }
+};
+
+// 一个工作节点及其要扫描的根目录，来自 --worker HOST:PORT=ROOT
+struct WorkerEndpoint {
+    std::string host;
+    std::string port;
+    std::string root;
+
+    std::string name() const {
+        return (host.find(':') == std::string::npos ? host : "[" + host + "]") + ":" + port;
+    }
+};
+
+inline bool parseWorkerEndpoint(const std::string& text, WorkerEndpoint& endpoint) {
+    size_t equals = text.find('=');
+    std::string address = text.substr(0, equals);
+    size_t colon = address.rfind(':');
+    if (equals == std::string::npos || colon == std::string::npos || colon == 0 || colon + 1 == address.size() ||
+        equals + 1 == text.size()) {
+        return false;
+    }
+    endpoint.host = address.substr(0, colon);
+    endpoint.port = address.substr(colon + 1);
+    endpoint.root = text.substr(equals + 1);
+    if (endpoint.host.size() > 2 && endpoint.host.front() == '[' && endpoint.host.back() == ']') {
+        endpoint.host = endpoint.host.substr(1, endpoint.host.size() - 2);  // [IPv6]:PORT
+    }
+    return true;
+}
+
+// 协调节点：合并各工作节点的大小组，按轮次请求各节点计算签名并跨节点重新分组 (与单机的渐进抽样相同)；
+// 抽样结束后，全部位于同一节点的组由该节点逐字节比较，跨节点的组由各节点计算全文摘要后按摘要分组
+class DistributedCoordinator {
+private:
+    struct Node {
+        WorkerEndpoint endpoint;
+        TcpSocket socket;
+    };
+
+    // 某个节点上的一个文件
+    struct Item {
+        uint32_t node;
+        uint32_t ref;
+        uint64_t size;
+    };
+    using ItemGroup = std::vector<Item>;
+
+    struct ConfirmedGroup {
+        ItemGroup items;
+        std::optional<Digest128> digest;  // 节点内逐字节比较的组没有全文摘要
+        bool hashOnly = false;            // 跨节点的组只按全文摘要确认，没有逐字节比较
+    };
+
+    InteractiveFileDeduplicator& dedup;
+    DeduplicatorOptions options;
+    std::string token;
+    std::vector<Node> nodes;
+
+    // 向一个节点发出请求并等待回复，节点返回错误时抛出异常
+    std::string request(Node& node, WireType type, const std::string& payload) {
+        sendMessage(node.socket, type, payload);
+        std::string reply;
+        if (receiveMessage(node.socket, reply) == WireType::Error) {
+            throw std::runtime_error(node.endpoint.name() + ": " + reply);
+        }
+        return reply;
+    }
+
+    // 对每个节点并行执行 fn(节点序号)，全部完成后重新抛出第一个异常
+    template <typename Fn>
+    void forEachNode(Fn&& fn) {
+        std::vector<std::thread> threads;
+        std::exception_ptr firstError;
+        std::mutex errorMutex;
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            threads.emplace_back([&, n] {
+                try {
+                    fn(n);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!firstError) {
+                        firstError = std::current_exception();
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+
+    // 按节点拆分一批文件，refsOf[n] 与 slotsOf[n] 对齐，slot 为文件在 items 中的位置
+    void splitByNode(const std::vector<Item>& items, std::vector<std::vector<uint32_t>>& refsOf,
+                     std::vector<std::vector<size_t>>& slotsOf) const {
+        refsOf.assign(nodes.size(), {});
+        slotsOf.assign(nodes.size(), {});
+        for (size_t i = 0; i < items.size(); ++i) {
+            refsOf[items[i].node].push_back(items[i].ref);
+            slotsOf[items[i].node].push_back(i);
+        }
+    }
+
+    static bool itemLess(const Item& a, const Item& b) {
+        return std::tie(a.node, a.ref) < std::tie(b.node, b.ref);
+    }
+
+    // 第 round 轮：请求各节点计算签名，组内按签名拆分，单成员的组淘汰
+    std::vector<ItemGroup> refineRound(const std::vector<ItemGroup>& groups, uint32_t round) {
+        PhaseTimer timer(Phase::Sampling);
+        std::vector<Item> items;
+        for (const auto& group : groups) {
+            items.insert(items.end(), group.begin(), group.end());
+        }
+        std::vector<std::vector<uint32_t>> refsOf;
+        std::vector<std::vector<size_t>> slotsOf;
+        splitByNode(items, refsOf, slotsOf);
+
+        std::vector<std::optional<FileSignature>> signatures(items.size());
+        forEachNode([&](size_t n) {
+            if (refsOf[n].empty()) {
+                return;
+            }
+            WireWriter payload;
+            payload.put(round);
+            payload.putRefs(refsOf[n]);
+            std::string reply = request(nodes[n], WireType::Sign, payload.data);
+            WireReader reader(reply);
+            for (size_t slot : slotsOf[n]) {
+                bool valid = reader.get<uint8_t>() != 0;
+                FileSignature signature;
+                signature.size = reader.get<uint64_t>();
+                signature.flags = reader.get<uint32_t>();
+                signature.sampleCount = reader.get<uint32_t>();
+                signature.samples.lo = reader.get<uint64_t>();
+                signature.samples.hi = reader.get<uint64_t>();
+                if (valid) {
+                    signatures[slot] = signature;
+                }
+            }
+        });
+
+        std::vector<ItemGroup> refined;
+        size_t offset = 0;
+        for (const auto& group : groups) {
+            std::vector<std::pair<FileSignature, Item>> keyed;
+            for (size_t i = 0; i < group.size(); ++i) {
+                if (signatures[offset + i]) {
+                    keyed.emplace_back(*signatures[offset + i], group[i]);
+                }
+            }
+            offset += group.size();
+            std::sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) {
+                if (!(a.first == b.first)) return a.first < b.first;
+                return itemLess(a.second, b.second);
+            });
+            for (size_t begin = 0; begin < keyed.size();) {
+                size_t end = begin + 1;
+                while (end < keyed.size() && keyed[end].first == keyed[begin].first) {
+                    ++end;
+                }
+                if (end - begin > 1) {
+                    ItemGroup part;
+                    for (size_t k = begin; k < end; ++k) {
+                        part.push_back(keyed[k].second);
+                    }
+                    refined.push_back(std::move(part));
+                }
+                begin = end;
+            }
+        }
+        return refined;
+    }
+
+    // 全部位于同一节点的组交给该节点逐字节比较
+    void verifyLocalGroups(const std::vector<ItemGroup>& groups, std::vector<ConfirmedGroup>& confirmed) {
+        PhaseTimer timer(Phase::Verification);
+        std::vector<std::vector<const ItemGroup*>> groupsOf(nodes.size());
+        for (const auto& group : groups) {
+            groupsOf[group[0].node].push_back(&group);
+        }
+        std::vector<std::vector<ConfirmedGroup>> confirmedOf(nodes.size());
+        forEachNode([&](size_t n) {
+            if (groupsOf[n].empty()) {
+                return;
+            }
+            WireWriter payload;
+            payload.put(static_cast<uint32_t>(groupsOf[n].size()));
+            for (const ItemGroup* group : groupsOf[n]) {
+                std::vector<uint32_t> refs;
+                for (const Item& item : *group) {
+                    refs.push_back(item.ref);
+                }
+                payload.putRefs(refs);
+            }
+            std::string reply = request(nodes[n], WireType::Verify, payload.data);
+            WireReader reader(reply);
+            for (const ItemGroup* group : groupsOf[n]) {
+                uint32_t partCount = reader.get<uint32_t>();
+                for (uint32_t p = 0; p < partCount; ++p) {
+                    ConfirmedGroup result;
+                    for (uint32_t ref : reader.getRefs()) {
+                        result.items.push_back({static_cast<uint32_t>(n), ref, (*group)[0].size});
+                    }
+                    confirmedOf[n].push_back(std::move(result));
+                }
+            }
+        });
+        for (auto& list : confirmedOf) {
+            for (auto& group : list) {
+                confirmed.push_back(std::move(group));
+            }
+        }
+    }
+
+    // 跨节点的组：各节点计算本地成员的全文摘要，按摘要分组；摘要不是加密哈希，这些组在报告中标为只按摘要确认
+    void verifyCrossNodeGroups(const std::vector<ItemGroup>& groups, std::vector<ConfirmedGroup>& confirmed) {
+        PhaseTimer timer(Phase::Verification);
+        std::vector<Item> items;
+        for (const auto& group : groups) {
+            items.insert(items.end(), group.begin(), group.end());
+        }
+        std::vector<std::vector<uint32_t>> refsOf;
+        std::vector<std::vector<size_t>> slotsOf;
+        splitByNode(items, refsOf, slotsOf);
+
+        std::vector<std::optional<Digest128>> digests(items.size());
+        forEachNode([&](size_t n) {
+            if (refsOf[n].empty()) {
+                return;
+            }
+            WireWriter payload;
+            payload.putRefs(refsOf[n]);
+            std::string reply = request(nodes[n], WireType::Hash, payload.data);
+            WireReader reader(reply);
+            for (size_t slot : slotsOf[n]) {
+                bool ok = reader.get<uint8_t>() != 0;
+                Digest128 digest;
+                digest.lo = reader.get<uint64_t>();
+                digest.hi = reader.get<uint64_t>();
+                if (ok) {
+                    digests[slot] = digest;
+                }
+            }
+        });
+
+        size_t offset = 0;
+        for (const auto& group : groups) {
+            std::vector<std::pair<Digest128, Item>> keyed;
+            for (size_t i = 0; i < group.size(); ++i) {
+                if (digests[offset + i]) {
+                    keyed.emplace_back(*digests[offset + i], group[i]);
+                }
+            }
+            offset += group.size();
+            std::sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) {
+                if (a.first != b.first) return a.first < b.first;
+                return itemLess(a.second, b.second);
+            });
+            for (size_t begin = 0; begin < keyed.size();) {
+                size_t end = begin + 1;
+                while (end < keyed.size() && keyed[end].first == keyed[begin].first) {
+                    ++end;
+                }
+                if (end - begin > 1) {
+                    ConfirmedGroup result;
+                    result.digest = keyed[begin].first;
+                    result.hashOnly = true;
+                    for (size_t k = begin; k < end; ++k) {
+                        result.items.push_back(keyed[k].second);
+                    }
+                    confirmed.push_back(std::move(result));
+                }
+                begin = end;
+            }
+        }
+    }
+
+public:
+    DistributedCoordinator(InteractiveFileDeduplicator& deduplicator, const DeduplicatorOptions& coordinatorOptions,
+                           const std::string& sharedToken, const std::vector<WorkerEndpoint>& endpoints)
+        : dedup(deduplicator), options(coordinatorOptions), token(sharedToken) {
+        for (const auto& endpoint : endpoints) {
+            nodes.push_back({endpoint, TcpSocket()});
+        }
+    }
+
+    // 检测各节点之间和节点内部的重复文件并输出；远程文件不在这里删除，需要时用 --report 导出后在各节点处理
+    void run() {
+        forEachNode([&](size_t n) {
+            Node& node = nodes[n];
+            node.socket = TcpSocket::connect(node.endpoint.host, node.endpoint.port);
+            WireWriter hello;
+            hello.put(kWireVersion);
+            hello.putString(token);
+            hello.put(static_cast<uint64_t>(options.samplePoints));
+            hello.put(static_cast<uint64_t>(options.sampleSize));
+            hello.putString(options.verifyMode);
+            request(node, WireType::Hello, hello.data);
+        });
+        std::cout << "已连接 " << nodes.size() << " 个工作节点" << std::endl;
+
+        // 第一层：合并各节点的文件大小；协调节点的统计只有各阶段的耗时和文件数，读取发生在工作节点上
+        std::vector<Item> items;
+        {
+            PhaseTimer timer(Phase::Enumeration);
+            std::vector<std::vector<Item>> scannedOf(nodes.size());
+            forEachNode([&](size_t n) {
+                WireWriter payload;
+                payload.putString(nodes[n].endpoint.root);
+                std::string reply = request(nodes[n], WireType::Scan, payload.data);
+                WireReader reader(reply);
+                uint32_t count = reader.get<uint32_t>();
+                scannedOf[n].reserve(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    uint32_t ref = reader.get<uint32_t>();
+                    uint64_t size = reader.get<uint64_t>();
+                    scannedOf[n].push_back({static_cast<uint32_t>(n), ref, size});
+                }
+            });
+            for (size_t n = 0; n < nodes.size(); ++n) {
+                std::cout << "  " << nodes[n].endpoint.name() << " " << nodes[n].endpoint.root << ": "
+                          << scannedOf[n].size() << " 个文件" << std::endl;
+                items.insert(items.end(), scannedOf[n].begin(), scannedOf[n].end());
+                scannedOf[n] = std::vector<Item>();
+            }
+            PhaseProfiler::countFiles(Phase::Enumeration, 0, items.size());
+        }
+        std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+            if (a.size != b.size) return a.size < b.size;
+            return itemLess(a, b);
+        });
+
+        std::vector<ItemGroup> active;
+        for (size_t begin = 0; begin < items.size();) {
+            size_t end = begin + 1;
+            while (end < items.size() && items[end].size == items[begin].size) {
+                ++end;
+            }
+            if (end - begin > 1) {
+                active.emplace_back(items.begin() + begin, items.begin() + end);
+            }
+            begin = end;
+        }
+        items = std::vector<Item>();
+
+        // 第二层：跨节点的渐进抽样
+        std::vector<ItemGroup> finished;
+        for (uint32_t round = 1; !active.empty(); ++round) {
+            std::vector<ItemGroup> sampling;
+            for (auto& group : active) {
+                if (dedup.samplePlan(group[0].size, round).empty()) {
+                    finished.push_back(std::move(group));
+                } else {
+                    sampling.push_back(std::move(group));
+                }
+            }
+            if (sampling.empty()) {
+                break;
+            }
+            active = refineRound(sampling, round);
+            std::cout << "第 " << round << " 轮抽样后剩余 " << active.size() << " 组" << std::endl;
+        }
+
+        // 第三层：节点内的组就地逐字节比较，跨节点的组比较全文摘要
+        std::vector<ItemGroup> localGroups;
+        std::vector<ItemGroup> crossGroups;
+        for (auto& group : finished) {
+            bool local = std::all_of(group.begin(), group.end(), [&](const Item& item) { return item.node == group[0].node; });
+            (local ? localGroups : crossGroups).push_back(std::move(group));
+        }
+        std::cout << "正在确认重复文件... (节点内 " << localGroups.size() << " 组, 跨节点 " << crossGroups.size()
+                  << " 组)" << std::endl;
+        std::vector<ConfirmedGroup> confirmed;
+        verifyLocalGroups(localGroups, confirmed);
+        verifyCrossNodeGroups(crossGroups, confirmed);
+
+        // 取回确认文件的路径和元数据，按 (大小, 节点, 下标) 排序输出
+        std::vector<Item> described;
+        for (const auto& group : confirmed) {
+            described.insert(described.end(), group.items.begin(), group.items.end());
+        }
+        std::vector<std::vector<uint32_t>> refsOf;
+        std::vector<std::vector<size_t>> slotsOf;
+        splitByNode(described, refsOf, slotsOf);
+        std::vector<std::pair<std::string, FileMeta>> details(described.size());
+        forEachNode([&](size_t n) {
+            if (refsOf[n].empty()) {
+                return;
+            }
+            WireWriter payload;
+            payload.putRefs(refsOf[n]);
+            std::string reply = request(nodes[n], WireType::Describe, payload.data);
+            WireReader reader(reply);
+            for (size_t slot : slotsOf[n]) {
+                details[slot].first = reader.getString();
+                details[slot].second.size = described[slot].size;
+                details[slot].second.mtimeNs = reader.get<int64_t>();
+                details[slot].second.volume = reader.get<uint64_t>();
+                details[slot].second.fileId[0] = reader.get<uint64_t>();
+                details[slot].second.fileId[1] = reader.get<uint64_t>();
+            }
+        });
+
+        std::vector<size_t> order(confirmed.size());
+        std::vector<size_t> firstSlot(confirmed.size());
+        for (size_t g = 0, slot = 0; g < confirmed.size(); slot += confirmed[g].items.size(), ++g) {
+            order[g] = g;
+            firstSlot[g] = slot;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            const Item& first = confirmed[a].items[0];
+            const Item& second = confirmed[b].items[0];
+            if (first.size != second.size) return first.size < second.size;
+            return itemLess(first, second);
+        });
+
+        std::unique_ptr<DuplicateReportWriter> report;
+        if (options.reportFormat != ReportFormat::None) {
+            fs::path path = options.reportPath.empty()
+                                ? fs::path(std::string("duplicates.") + reportFormatName(options.reportFormat))
+                                : fs::path(options.reportPath);
+            std::vector<std::string> nodeNames;
+            for (const auto& node : nodes) {
+                nodeNames.push_back(node.endpoint.name());
+            }
+            report = std::make_unique<DuplicateReportWriter>(options.reportFormat, path, nodeNames);
+        }
+
+        uint64_t duplicateFiles = 0;
+        uintmax_t reclaimable = 0;
+        std::cout << "\n" << std::string(50, '=') << std::endl;
+        for (size_t rank = 0; rank < order.size(); ++rank) {
+            const ConfirmedGroup& group = confirmed[order[rank]];
+            size_t slot = firstSlot[order[rank]];
+            duplicateFiles += group.items.size() - 1;
+            reclaimable += group.items[0].size * (group.items.size() - 1);
+            std::cout << "重复组 " << rank + 1 << " (" << group.items.size() << " 个文件, 每个 "
+                      << dedup.formatFileSize(group.items[0].size) << "):" << std::endl;
+            std::vector<DuplicateReportWriter::ReportedFile> files;
+            for (size_t i = 0; i < group.items.size(); ++i) {
+                const auto& detail = details[slot + i];
+                std::cout << "  " << nodes[group.items[i].node].endpoint.name() << "  " << detail.first << std::endl;
+                files.push_back({group.items[i].node, group.items[i].ref, detail.first, detail.second});
+            }
+            if (report) {
+                report->write(group.items[0].size, files, group.digest, group.hashOnly);
+            }
+        }
+        std::cout << std::string(50, '=') << std::endl;
+        std::cout << "发现重复组: " << confirmed.size() << " 组, 重复文件: " << duplicateFiles
+                  << " 个, 可节省空间: " << dedup.formatFileSize(reclaimable) << std::endl;
+        if (report) {
+            report->finish();
+            std::cout << "报告已写入: " << report->path() << std::endl;
+        }
+    }
+};
+
+// 实时进度报告：后台线程每秒汇总一次 ProgressCounters 和分阶段读取量，算出各阶段的文件/s、读取速率和剩余时间。
+// --progress 在标准错误上刷新一行当前阶段的状态 (标准错误不是终端时每 10 秒输出一行)；
+// --metrics-file 把同样的数据以 Prometheus 文本格式写入文件 (先写临时文件再改名，读取方不会看到写了一半的内容)，
+// --metrics-port 在本地端口上以 HTTP 提供。剩余时间按阶段开始以来的平均速率估算已知的工作量，
+// 有预计读取量的阶段 (精确比较) 按字节、其余按文件数；抽样的工作量每轮开始时才知道，枚举没有预计总量
+class ProgressReporter {
+public:
+    struct Options {
+        bool statusLine = false;
+        std::string metricsFile;    // 空表示不写文件
+        std::string metricsAddress;
+        std::string metricsPort;    // 空表示不监听
+    };
+
+private:
+    static constexpr int kPlainLineTicks = 10;  // 非终端时每 kPlainLineTicks 次汇总输出一行
+
+    struct StageRate {
+        bool started = false;
+        std::chrono::steady_clock::time_point startedAt;
+        double filesPerSecond = 0;
+        double bytesPerSecond = 0;
+        double etaSeconds = -1;  // 负数表示无法估算
+    };
+
+    Options options;
+    bool terminal = false;
+    std::unique_ptr<TcpListener> listener;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastTick = startTime;
+    ProgressCounters::Snapshot last;
+    StageRate rates[kPhaseCount];
+    Phase activeStage = Phase::None;
+    bool metricsFileFailed = false;
+
+    std::mutex metricsMutex;
+    std::string metricsText;
+
+    std::atomic<bool> stopping{false};
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread reporter;
+    std::thread server;
+
+    static const char* stageTitle(Phase phase) {
+        switch (phase) {
+            case Phase::Enumeration: return "枚举";
+            case Phase::Sampling: return "抽样";
+            case Phase::Verification: return "精确比较";
+            case Phase::Deletion: return "删除";
+            default: return "";
+        }
+    }
+
+    static std::string formatDuration(double seconds) {
+        uint64_t total = static_cast<uint64_t>(seconds + 0.5);
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%02llu:%02llu:%02llu", static_cast<unsigned long long>(total / 3600),
+                 static_cast<unsigned long long>(total / 60 % 60), static_cast<unsigned long long>(total % 60));
+        return buffer;
+    }
+
+    static std::string formatRate(double bytesPerSecond) {
+        const char* units[] = {"B", "KB", "MB", "GB"};
+        int unitIndex = 0;
+        while (bytesPerSecond >= 1024.0 && unitIndex < 3) {
+            bytesPerSecond /= 1024.0;
+            unitIndex++;
+        }
+        std::ostringstream out;
+        out.imbue(std::locale::classic());
+        out << std::fixed << std::setprecision(2) << bytesPerSecond << ' ' << units[unitIndex] << "/s";
+        return out.str();
+    }
+
+    double estimate(size_t stage, const ProgressCounters::Snapshot& current,
+                    std::chrono::steady_clock::time_point now) const {
+        const StageRate& rate = rates[stage];
+        double elapsed = std::chrono::duration<double>(now - rate.startedAt).count();
+        if (!rate.started || elapsed <= 0) {
+            return -1;
+        }
+        uint64_t done = current.files[stage];
+        uint64_t expected = current.expectedFiles[stage];
+        if (current.expectedBytes[stage] > 0 && current.bytesRead[stage] > 0) {
+            done = current.bytesRead[stage];
+            expected = current.expectedBytes[stage];
+        }
+        if (expected == 0 || done == 0) {
+            return -1;
+        }
+        if (done >= expected) {
+            return 0;
+        }
+        return static_cast<double>(expected - done) * elapsed / static_cast<double>(done);
+    }
+
+    std::string statusText(Phase phase, const ProgressCounters::Snapshot& current,
+                           std::chrono::steady_clock::time_point now) const {
+        size_t stage = static_cast<size_t>(phase);
+        const StageRate& rate = rates[stage];
+        std::ostringstream out;
+        out.imbue(std::locale::classic());
+        out << '[' << formatDuration(std::chrono::duration<double>(now - startTime).count()) << "] "
+            << stageTitle(phase) << ' ' << current.files[stage];
+        if (current.expectedFiles[stage] > 0) {
+            out << '/' << current.expectedFiles[stage];
+        }
+        out << " 个文件, " << static_cast<uint64_t>(rate.filesPerSecond + 0.5) << " 个/s, "
+            << formatRate(rate.bytesPerSecond);
+        if (current.queueDepth[stage] > 0) {
+            out << ", 队列 " << current.queueDepth[stage];
+        }
+        if (rate.etaSeconds >= 0) {
+            out << ", 剩余 " << formatDuration(rate.etaSeconds);
+        }
+        return out.str();
+    }
+
+    std::string renderMetrics(const ProgressCounters::Snapshot& current, std::chrono::steady_clock::time_point now,
+                              bool running) const {
+        std::ostringstream out;
+        out.imbue(std::locale::classic());
+        out << std::fixed << std::setprecision(3);
+        out << "# HELP dedup_running 是否仍在运行\n# TYPE dedup_running gauge\n"
+            << "dedup_running " << (running ? 1 : 0) << '\n';
+        out << "# HELP dedup_elapsed_seconds 已运行的时间\n# TYPE dedup_elapsed_seconds gauge\n"
+            << "dedup_elapsed_seconds " << std::chrono::duration<double>(now - startTime).count() << '\n';
+        out << "# HELP dedup_peak_memory_bytes 进程峰值内存\n# TYPE dedup_peak_memory_bytes gauge\n"
+            << "dedup_peak_memory_bytes " << processPeakMemory() << '\n';
+
+        auto family = [&](const char* name, const char* type, const char* help, auto value) {
+            out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+            for (size_t i = 0; i < kPhaseCount; ++i) {
+                auto v = value(i);
+                if (v >= 0) {
+                    out << name << "{stage=\"" << phaseName(static_cast<Phase>(i)) << "\"} " << v << '\n';
+                }
+            }
+        };
+        family("dedup_files_processed_total", "counter", "各阶段已处理的文件数",
+               [&](size_t i) { return static_cast<int64_t>(current.files[i]); });
+        family("dedup_files_expected", "gauge", "各阶段已知的待处理文件数",
+               [&](size_t i) { return static_cast<int64_t>(current.expectedFiles[i]); });
+        family("dedup_bytes_read_total", "counter", "各阶段读取的字节数",
+               [&](size_t i) { return static_cast<int64_t>(current.bytesRead[i]); });
+        family("dedup_bytes_expected", "gauge", "各阶段已知的待读取字节数",
+               [&](size_t i) { return static_cast<int64_t>(current.expectedBytes[i]); });
+        family("dedup_queue_depth", "gauge", "各阶段排队或在途的工作数",
+               [&](size_t i) { return static_cast<int64_t>(current.queueDepth[i]); });
+        family("dedup_files_per_second", "gauge", "最近一次汇总间隔内的文件处理速率",
+               [&](size_t i) { return rates[i].filesPerSecond; });
+        family("dedup_bytes_per_second", "gauge", "最近一次汇总间隔内的读取速率",
+               [&](size_t i) { return rates[i].bytesPerSecond; });
+        family("dedup_eta_seconds", "gauge", "按平均速率估算的剩余时间，无法估算时不输出",
+               [&](size_t i) { return rates[i].etaSeconds; });
+        family("dedup_stage_active", "gauge", "最近有进展的阶段为 1",
+               [&](size_t i) { return static_cast<int64_t>(running && static_cast<Phase>(i) == activeStage); });
+        return out.str();
+    }
+
+    void writeMetricsFile(const std::string& text) {
+        fs::path path(options.metricsFile);
+        fs::path temporary = path;
+        temporary += ".tmp";
+        std::error_code ec;
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file << text;
+            if (!file) {
+                ec = std::make_error_code(std::errc::io_error);
+            }
+        }
+        if (!ec) {
+            fs::rename(temporary, path, ec);
+        }
+        if (ec && !metricsFileFailed) {
+            // 只提示一次，之后每次汇总照常重试
+            metricsFileFailed = true;
+            std::cerr << "警告: 无法写入指标文件 " << options.metricsFile << " - " << ec.message() << std::endl;
+        }
+    }
+
+    void update(uint64_t tick, bool running) {
+        auto now = std::chrono::steady_clock::now();
+        double interval = std::chrono::duration<double>(now - lastTick).count();
+        ProgressCounters::Snapshot current = ProgressCounters::snapshot();
+        Phase progressed = Phase::None;
+        for (size_t i = 0; i < kPhaseCount; ++i) {
+            uint64_t files = current.files[i] - last.files[i];
+            uint64_t bytes = current.bytesRead[i] - last.bytesRead[i];
+            StageRate& rate = rates[i];
+            if (files > 0 || bytes > 0) {
+                progressed = static_cast<Phase>(i);
+                if (!rate.started) {
+                    rate.started = true;
+                    rate.startedAt = lastTick;
+                }
+            }
+            rate.filesPerSecond = interval > 0 ? files / interval : 0;
+            rate.bytesPerSecond = interval > 0 ? bytes / interval : 0;
+            rate.etaSeconds = estimate(i, current, now);
+        }
+        if (progressed != Phase::None) {
+            activeStage = progressed;
+        }
+        last = current;
+        lastTick = now;
+
+        std::string metrics = renderMetrics(current, now, running);
+        if (!options.metricsFile.empty()) {
+            writeMetricsFile(metrics);
+        }
+        {
+            std::lock_guard<std::mutex> lock(metricsMutex);
+            metricsText = std::move(metrics);
+        }
+
+        if (!options.statusLine || !running) {
+            return;
+        }
+        if (terminal) {
+            // 没有进展时 (如等待用户输入) 擦掉状态行，不留下过时的内容
+            if (progressed != Phase::None) {
+                StatusLine::show(statusText(progressed, current, now));
+            } else {
+                StatusLine::clear();
+            }
+        } else if (tick % kPlainLineTicks == 0 && activeStage != Phase::None) {
+            StatusLine::print(statusText(activeStage, current, now));
+        }
+    }
+
+    void report() {
+        uint64_t tick = 0;
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (!wake.wait_for(lock, std::chrono::seconds(1), [&] { return stopping.load(); })) {
+            lock.unlock();
+            update(++tick, true);
+            lock.lock();
+        }
+    }
+
+    // 每个连接只回答一个请求；GET /metrics (或 /) 返回最近一次汇总的指标
+    void serve() {
+        while (!stopping.load()) {
+            try {
+                if (!listener->waitForClient(200)) {
+                    continue;
+                }
+                TcpSocket client = listener->accept();
+                client.setReceiveTimeout(2000);
+                std::string request;
+                char buffer[1024];
+                while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+                    size_t received = client.receiveSome(buffer, sizeof(buffer));
+                    if (received == 0) {
+                        break;
+                    }
+                    request.append(buffer, received);
+                }
+
+                std::string status = "200 OK";
+                std::string body;
+                size_t targetEnd = request.find(' ', 4);
+                std::string target = request.compare(0, 4, "GET ") == 0 && targetEnd != std::string::npos
+                                         ? request.substr(4, targetEnd - 4) : std::string();
+                if (target == "/metrics" || target == "/") {
+                    std::lock_guard<std::mutex> lock(metricsMutex);
+                    body = metricsText;
+                } else if (target.empty()) {
+                    status = "405 Method Not Allowed";
+                    body = "只支持 GET\n";
+                } else {
+                    status = "404 Not Found";
+                    body = "指标位于 /metrics\n";
+                }
+                std::string response = "HTTP/1.1 " + status + "\r\n"
+                                       "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                                       "Connection: close\r\n\r\n" + body;
+                client.sendAll(response.data(), response.size());
+            } catch (const std::exception&) {
+                // 单个连接出错 (超时、对方断开) 不影响后续请求
+            }
+        }
+    }
+
+public:
+    explicit ProgressReporter(const Options& reporterOptions) : options(reporterOptions) {
+#ifdef _WIN32
+        HANDLE error = GetStdHandle(STD_ERROR_HANDLE);
+        DWORD mode = 0;
+        terminal = GetConsoleMode(error, &mode) != 0;
+#ifdef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+        if (terminal) {
+            SetConsoleMode(error, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+        }
+#endif
+#else
+        terminal = isatty(STDERR_FILENO) != 0;
+#endif
+        if (!options.metricsPort.empty()) {
+            listener = std::make_unique<TcpListener>(options.metricsAddress, options.metricsPort);
+        }
+        metricsText = renderMetrics(last, startTime, true);
+        reporter = std::thread([this] { report(); });
+        if (listener) {
+            server = std::thread([this] { serve(); });
+        }
+    }
+
+    // 停止汇总并擦掉状态行；指标文件最后写一次，dedup_running 为 0
+    ~ProgressReporter() {
+        stopping = true;
+        wake.notify_all();
+        reporter.join();
+        if (server.joinable()) {
+            server.join();
+        }
+        update(0, false);
+        StatusLine::clear();
+    }
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+};
+
+// 解析字节数，支持 K/M/G 后缀（按 1024 进位）；负数和乘以后缀后溢出的值无效
+bool parseByteSize(const std::string& text, size_t& bytes) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    size_t consumed = 0;
+    unsigned long long value;
+    try {
+        value = std::stoull(text, &consumed);
+    } catch (const std::exception&) {
+        return false;
+    }
+    std::string suffix = text.substr(consumed);
+    unsigned shift = 0;
+    if (suffix == "K" || suffix == "k") {
+        shift = 10;
+    } else if (suffix == "M" || suffix == "m") {
+        shift = 20;
+    } else if (suffix == "G" || suffix == "g") {
+        shift = 30;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    if (value > (static_cast<unsigned long long>(std::numeric_limits<size_t>::max()) >> shift)) {
+        return false;
+    }
+    bytes = static_cast<size_t>(value << shift);
+    return true;
+}
+
+// 解析时长，支持 ms/s/m/h 后缀，没有后缀时为秒；负数和换算为毫秒后溢出的值无效
+bool parseDuration(const std::string& text, uint64_t& milliseconds) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    size_t consumed = 0;
+    unsigned long long value;
+    try {
+        value = std::stoull(text, &consumed);
+    } catch (const std::exception&) {
+        return false;
+    }
+    std::string suffix = text.substr(consumed);
+    uint64_t unit;
+    if (suffix == "ms") {
+        unit = 1;
+    } else if (suffix.empty() || suffix == "s") {
+        unit = 1000;
+    } else if (suffix == "m") {
+        unit = 60 * 1000;
+    } else if (suffix == "h") {
+        unit = 3600 * 1000;
+    } else {
+        return false;
+    }
+    // 预算与 steady_clock 的时长比较，换算后不能超过它能表示的范围 (纳秒精度时约 292 年)
+    const uint64_t limit = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::duration::max()).count());
+    if (value > limit / unit) {
+        return false;
+    }
+    milliseconds = value * unit;
+    return true;
+}
+
+// 控制台设置：Windows 控制台切换到 UTF-8 代码页；POSIX 终端直接输出 UTF-8，无需设置
+inline void setupConsole() {
+#ifdef _WIN32
+    SetConsoleOutputCP(CP_UTF8);
+    SetConsoleCP(CP_UTF8);
+#endif
+}
+
+#ifndef AFD_NO_MAIN
+int main(int argc, char* argv[]) {
+    // 全面设置编码
+    setupConsole();
+    
+    std::cout << "程序启动..." << std::endl;
+    
+    // 安全的本地化设置方式
+    try {
+        std::locale::global(std::locale("")); // 使用系统默认本地化
+    } catch (const std::exception& e) {
+        std::cout << "警告: 无法设置本地化，使用C本地化 (" << e.what() << ")" << std::endl;
+        std::locale::global(std::locale("C"));
+    }
+    
+    if (argc < 2) {
+        std::cerr << "错误: 请指定目录路径" << std::endl;
+        std::cerr << "使用 -h 查看帮助信息" << std::endl;
+        return 1;
+    }
+
+    // 回显参数时隐藏 --token 的值
+    auto shownArg = [&](int i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--token=", 0) == 0) {
+            return std::string("--token=***");
+        }
+        if (i > 1 && std::string(argv[i - 1]) == "--token") {
+            return std::string("***");
+        }
+        return arg;
+    };
+
+    // 显示参数信息
+    std::cout << "接收到 " << argc << " 个参数:" << std::endl;
+    for (int i = 0; i < argc; i++) {
+        std::cout << "  参数[" << i << "]: " << shownArg(i) << std::endl;
+    }
+
+    DeduplicatorOptions options;
+    std::string directory;
+    std::string planPath;
+    std::string serveAddress;  // 非空时作为工作节点运行
+    bool orderGiven = false;
+    std::string token;
+    std::vector<WorkerEndpoint> workers;
+    ProgressReporter::Options progressOptions;
+
+// 在 main 函数的参数解析部分，修改为：
+
+// 参数解析
+for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    std::cout << "解析参数: " << shownArg(i) << std::endl;
+
+    // 支持 --option=value 写法：拆开后按 "--option value" 处理
+    std::string inlineValue;
+    bool hasInlineValue = false;
+    if (arg.rfind("--", 0) == 0 && arg.find('=') != std::string::npos) {
+        size_t eq = arg.find('=');
+        inlineValue = arg.substr(eq + 1);
+        arg = arg.substr(0, eq);
+        hasInlineValue = true;
+    }
+    auto hasValue = [&]() { return hasInlineValue || i + 1 < argc; };
+    auto takeValue = [&]() -> std::string { return hasInlineValue ? inlineValue : std::string(argv[++i]); };
+    
+    if (arg == "-h" || arg == "--help") {
+        std::cout << "高级文件去重工具 - 支持子文件夹处理" << std::endl;
+        std::cout << "用法: advanced_dedup [选项] <目录路径>" << std::endl;
+        std::cout << "      advanced_dedup [选项] --apply <保留方案>" << std::endl;
+        std::cout << "      advanced_dedup [选项] --serve [地址:]端口" << std::endl;
+        std::cout << "      advanced_dedup [选项] --worker 主机:端口=目录 [--worker ...]" << std::endl;
+        std::cout << "选项:" << std::endl;
+        std::cout << "  -d, --dry-run         模拟运行，不实际删除" << std::endl;
+        std::cout << "  -v, --verbose         详细输出" << std::endl;
+        std::cout << "  -y, --yes             自动确认所有操作" << std::endl;
+        std::cout << "  -m, --mode MODE       处理模式: all(全局) 或 folder(单文件夹) [默认: all]" << std::endl;
+        std::cout << "  -n, --no-skip         不跳过无重复文件的文件夹" << std::endl;
+        std::cout << "  -p, --points NUM      第 2 轮抽样点数, 之后每轮翻倍 (默认: 4)" << std::endl;
+        std::cout << "  -s, --size SIZE       基础抽样块大小, 之后每轮翻倍 (默认: 4096)" << std::endl;
+        std::cout << "  -t, --threads NUM     扫描、抽样和删除阶段的工作线程数, 0 表示使用全部 CPU 核心 (默认: 1)" << std::endl;
+        std::cout << "      --verify MODE     精确比较方式: lockstep(同步分块) / hash(全文哈希) / pairwise(两两比较) [默认: lockstep]" << std::endl;
+        std::cout << "      --io BACKEND      文件读取后端: stream / mmap(内存映射) / direct(无缓冲对齐读取) / async(IOCP / io_uring) [默认: stream]" << std::endl;
+#ifdef _WIN32
+        std::cout << "  -c, --cache FILE      使用持久化签名缓存, auto 表示默认位置 (%LOCALAPPDATA%\\AFD)" << std::endl;
+#else
+        std::cout << "  -c, --cache FILE      使用持久化签名缓存, auto 表示默认位置 ($XDG_CACHE_HOME/afd 或 ~/.cache/afd)" << std::endl;
+#endif
+        std::cout << "      --scan METHOD     全局模式的枚举方式: dir(目录遍历) / mft(直接读取 NTFS 主文件表, 需管理员权限) [默认: dir]" << std::endl;
+        std::cout << "      --incremental     配合 --scan mft, 保存卷快照并通过 USN 日志只读取变化的文件" << std::endl;
+        std::cout << "      --schedule ORDER  抽样读取顺序: none(按大小组) / physical(按磁盘物理位置, 适合机械硬盘) [默认: none]" << std::endl;
+        std::cout << "      --queue-depth NUM 同时进行的读取数 (默认: 按物理位置调度 4, 异步读取 32)" << std::endl;
+        std::cout << "      --pipeline        全局模式下扫描、抽样、精确比较重叠进行, 确认的重复组立即输出" << std::endl;
+        std::cout << "      --mem-limit SIZE  大小/签名分组排序缓冲的上限, 超出部分写入临时文件外部排序, 可带 K/M/G 后缀;"
+                     " 文件表和候选组仍常驻内存" << std::endl;
+        std::cout << "      --stats           结束时打印各阶段 (枚举/抽样/精确比较/删除) 的耗时、文件数、读取量、系统调用次数和峰值内存" << std::endl;
+        std::cout << "      --stats-json FILE 把同样的统计写成 JSON 文件, - 表示标准输出" << std::endl;
+        std::cout << "      --progress        在标准错误上刷新一行状态: 当前阶段的文件数、文件/s、读取速率、队列深度和剩余时间" << std::endl;
+        std::cout << "      --metrics-file FILE 每秒把各阶段的进度指标以 Prometheus 文本格式写入文件" << std::endl;
+        std::cout << "      --metrics-port ADDR 在 [地址:]端口 上以 HTTP 提供同样的指标 (/metrics), 默认地址 127.0.0.1" << std::endl;
+        std::cout << "      --action MODE     不保留的重复文件: delete(删除) / hardlink(硬链接) / reflink(块克隆) / symlink(符号链接) [默认: delete]" << std::endl;
+        std::cout << "      --report FORMAT   把确认的重复组边检测边写入报告: jsonl / csv / bin, 不展示也不处理重复文件" << std::endl;
+        std::cout << "      --report-file FILE 报告文件路径 (默认: duplicates.<格式>)" << std::endl;
+        std::cout << "      --apply FILE      不扫描目录, 核对后直接执行 jsonl 格式的保留方案 (如 --report jsonl 的输出)" << std::endl;
+        std::cout << "      --recheck         配合 --apply, 执行前重新计算抽样签名, 确认内容与保留的文件相同" << std::endl;
+        std::cout << "      --min-size SIZE   忽略小于此大小的文件, 可带 K/M/G 后缀 (默认: 0)" << std::endl;
+        std::cout << "      --order ORDER     全局模式的检测顺序: size(从小到大) / reclaimable(按可节省空间从大到小) [默认: size, 设置预算时为 reclaimable]" << std::endl;
+        std::cout << "      --budget-bytes SIZE 抽样和精确比较的读取量上限, 到达后停止并处理已确认的重复组" << std::endl;
+        std::cout << "      --time-budget TIME 运行时间上限, 支持 ms/s/m/h 后缀, 到达后停止并处理已确认的重复组" << std::endl;
+        std::cout << "      --journal FILE    全局检测时把文件表、抽样签名和比较结果持续写入断点日志, 正常结束后删除" << std::endl;
+        std::cout << "      --resume          配合 --journal, 从上次中断处继续, 已完成的枚举、抽样和比较不再重复" << std::endl;
+        std::cout << "      --chunk-index     全局模式下建立内容定义分块索引, 报告截断 / 追加等部分相同的文件和块级去重可节省的空间" << std::endl;
+        std::cout << "      --chunk-size SIZE 分块的平均长度, 2 的幂, 可带 K/M 后缀 (默认: 16K)" << std::endl;
+        std::cout << "      --serve ADDR      作为分布式工作节点监听 [地址:]端口, 由协调节点指定扫描的目录;"
+                     " 默认地址 127.0.0.1, 监听其他地址时必须指定 --token" << std::endl;
+        std::cout << "      --worker NODE     作为协调节点, 扫描工作节点上的目录 (主机:端口=目录), 可重复指定" << std::endl;
+        std::cout << "      --token TEXT      协调节点与工作节点之间的共享令牌, 两端必须一致 (默认: 空)" << std::endl;
+        std::cout << std::endl;
+        std::cout << "模式说明:" << std::endl;
+        std::cout << "  all:    在整个目录树中查找重复文件（跨文件夹比较）" << std::endl;
+        std::cout << "  folder: 分别在每个文件夹内查找重复文件（不跨文件夹比较）" << std::endl;
+        return 0;
+    } else if (arg == "-d" || arg == "--dry-run") {
+        options.dryRun = true;
+        std::cout << "设置: 模拟运行模式" << std::endl;
+    } else if (arg == "-v" || arg == "--verbose") {
+        options.verbose = true;
+        std::cout << "设置: 详细输出模式" << std::endl;
+    } else if (arg == "-y" || arg == "--yes") {
+        options.autoConfirm = true;
+        std::cout << "设置: 自动确认模式" << std::endl;
+    } else if (arg == "-m" || arg == "--mode") {
+        if (hasValue()) {
+            options.mode = takeValue();
+            if (options.mode != "all" && options.mode != "folder") {
+                std::cerr << "错误: 模式必须是 'all' 或 'folder'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 模式 = " << options.mode << std::endl;
+        } else {
+            std::cerr << "错误: -m 参数需要指定模式" << std::endl;
+            return 1;
+        }
+    } else if (arg == "-n" || arg == "--no-skip") {
+        options.skipEmptyFolders = false;
+        std::cout << "设置: 不跳过无重复文件的文件夹" << std::endl;
+    } else if (arg == "-p" || arg == "--points") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            try {
+                options.samplePoints = std::stoul(value);
+                std::cout << "设置: 抽样点数 = " << options.samplePoints << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "错误: 无效的抽样点数 '" << value << "'" << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "错误: -p 参数需要指定数字" << std::endl;
+            return 1;
+        }
+    } else if (arg == "-s" || arg == "--size") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            try {
+                options.sampleSize = std::stoul(value);
+                std::cout << "设置: 抽样大小 = " << options.sampleSize << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "错误: 无效的抽样大小 '" << value << "'" << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "错误: -s 参数需要指定数字" << std::endl;
+            return 1;
+        }
+    } else if (arg == "-t" || arg == "--threads") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            try {
+                options.threadCount = std::stoul(value);
+                if (options.threadCount == 0) {
+                    options.threadCount = std::max(1u, std::thread::hardware_concurrency());
+                }
+                std::cout << "设置: 工作线程数 = " << options.threadCount << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "错误: 无效的线程数 '" << value << "'" << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "错误: -t 参数需要指定数字" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--verify") {
+        if (hasValue()) {
+            options.verifyMode = takeValue();
+            if (options.verifyMode != "lockstep" && options.verifyMode != "hash" && options.verifyMode != "pairwise") {
+                std::cerr << "错误: 比较方式必须是 'lockstep'、'hash' 或 'pairwise'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 精确比较方式 = " << options.verifyMode << std::endl;
+        } else {
+            std::cerr << "错误: --verify 参数需要指定比较方式" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--io") {
+        if (hasValue()) {
+            std::string backendName = takeValue();
+            if (!parseIoBackend(backendName, options.ioBackend)) {
+                std::cerr << "错误: 读取后端必须是 'stream'、'mmap'、'direct' 或 'async'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 读取后端 = " << backendName << std::endl;
+        } else {
+            std::cerr << "错误: --io 参数需要指定读取后端" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--stats") {
+        options.printStats = true;
+        std::cout << "设置: 输出分阶段统计" << std::endl;
+    } else if (arg == "--stats-json") {
+        if (hasValue()) {
+            options.statsJsonPath = takeValue();
+            std::cout << "设置: 统计 JSON = " << options.statsJsonPath << std::endl;
+        } else {
+            std::cerr << "错误: --stats-json 参数需要指定文件路径或 -" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--journal") {
+        if (hasValue()) {
+            options.journalPath = takeValue();
+            std::cout << "设置: 断点日志 = " << options.journalPath << std::endl;
+        } else {
+            std::cerr << "错误: --journal 参数需要指定文件路径" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--resume") {
+        options.resume = true;
+        std::cout << "设置: 从断点日志继续" << std::endl;
+    } else if (arg == "--progress") {
+        progressOptions.statusLine = true;
+        options.showProgress = true;
+        std::cout << "设置: 显示实时进度" << std::endl;
+    } else if (arg == "--metrics-file") {
+        if (hasValue()) {
+            progressOptions.metricsFile = takeValue();
+            std::cout << "设置: 指标文件 = " << progressOptions.metricsFile << std::endl;
+        } else {
+            std::cerr << "错误: --metrics-file 参数需要指定文件路径" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--metrics-port") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            size_t colon = value.rfind(':');
+            progressOptions.metricsAddress = colon == std::string::npos ? "127.0.0.1" : value.substr(0, colon);
+            progressOptions.metricsPort = colon == std::string::npos ? value : value.substr(colon + 1);
+            std::string& address = progressOptions.metricsAddress;
+            if (address.size() > 2 && address.front() == '[' && address.back() == ']') {
+                address = address.substr(1, address.size() - 2);
+            }
+            if (progressOptions.metricsPort.empty()) {
+                std::cerr << "错误: 无效的指标地址 '" << value << "'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 指标服务监听 = " << value << std::endl;
+        } else {
+            std::cerr << "错误: --metrics-port 参数需要指定 [地址:]端口" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--action") {
+        if (hasValue()) {
+            std::string actionName = takeValue();
+            if (!parseDuplicateAction(actionName, options.action)) {
+                std::cerr << "错误: 处理方式必须是 'delete'、'hardlink'、'reflink' 或 'symlink'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 重复文件处理方式 = " << duplicateActionName(options.action) << std::endl;
+        } else {
+            std::cerr << "错误: --action 参数需要指定处理方式" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--report") {
+        if (hasValue()) {
+            std::string formatName = takeValue();
+            if (!parseReportFormat(formatName, options.reportFormat)) {
+                std::cerr << "错误: 报告格式必须是 'jsonl'、'csv' 或 'bin'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 报告格式 = " << reportFormatName(options.reportFormat) << std::endl;
+        } else {
+            std::cerr << "错误: --report 参数需要指定格式" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--report-file") {
+        if (hasValue()) {
+            options.reportPath = takeValue();
+            std::cout << "设置: 报告文件 = " << options.reportPath << std::endl;
+        } else {
+            std::cerr << "错误: --report-file 参数需要指定文件路径" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--apply") {
+        if (hasValue()) {
+            planPath = takeValue();
+            std::cout << "设置: 保留方案 = " << planPath << std::endl;
+        } else {
+            std::cerr << "错误: --apply 参数需要指定保留方案文件" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--recheck") {
+        options.recheckPlan = true;
+        std::cout << "设置: 执行方案前重新核对抽样签名" << std::endl;
+    } else if (arg == "--min-size") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            if (!parseByteSize(value, options.minFileSize)) {
+                std::cerr << "错误: 无效的最小文件大小 '" << value << "'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 最小文件大小 = " << value << std::endl;
+        } else {
+            std::cerr << "错误: --min-size 参数需要指定大小" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--order") {
+        if (hasValue()) {
+            options.workOrder = takeValue();
+            if (options.workOrder != "size" && options.workOrder != "reclaimable") {
+                std::cerr << "错误: 检测顺序必须是 'size' 或 'reclaimable'" << std::endl;
+                return 1;
+            }
+            orderGiven = true;
+            std::cout << "设置: 检测顺序 = " << options.workOrder << std::endl;
+        } else {
+            std::cerr << "错误: --order 参数需要指定顺序" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--budget-bytes") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            if (!parseByteSize(value, options.readBudget) || options.readBudget == 0) {
+                std::cerr << "错误: 无效的读取预算 '" << value << "'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 读取预算 = " << value << std::endl;
+        } else {
+            std::cerr << "错误: --budget-bytes 参数需要指定大小" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--time-budget") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            if (!parseDuration(value, options.timeBudgetMs) || options.timeBudgetMs == 0) {
+                std::cerr << "错误: 无效的时间预算 '" << value << "'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 时间预算 = " << value << std::endl;
+        } else {
+            std::cerr << "错误: --time-budget 参数需要指定时长" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--chunk-index") {
+        options.chunkIndex = true;
+        std::cout << "设置: 建立分块索引" << std::endl;
+    } else if (arg == "--chunk-size") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            size_t size = 0;
+            if (!parseByteSize(value, size) || size < 1024 || size > (16u << 20) || (size & (size - 1)) != 0) {
+                std::cerr << "错误: 分块长度必须是 1K 到 16M 之间的 2 的幂 '" << value << "'" << std::endl;
+                return 1;
+            }
+            options.chunkSize = size;
+            std::cout << "设置: 平均分块长度 = " << value << std::endl;
+        } else {
+            std::cerr << "错误: --chunk-size 参数需要指定大小" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--serve") {
+        if (hasValue()) {
+            serveAddress = takeValue();
+            std::cout << "设置: 工作节点监听 = " << serveAddress << std::endl;
+        } else {
+            std::cerr << "错误: --serve 参数需要指定 [地址:]端口" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--worker") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            WorkerEndpoint endpoint;
+            if (!parseWorkerEndpoint(value, endpoint)) {
+                std::cerr << "错误: 无效的工作节点 '" << value << "', 格式为 主机:端口=目录" << std::endl;
+                return 1;
+            }
+            workers.push_back(endpoint);
+            std::cout << "设置: 工作节点 " << endpoint.name() << " 扫描 " << endpoint.root << std::endl;
+        } else {
+            std::cerr << "错误: --worker 参数需要指定 主机:端口=目录" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--token") {
+        if (hasValue()) {
+            token = takeValue();
+            std::cout << "设置: 共享令牌已指定" << std::endl;
+        } else {
+            std::cerr << "错误: --token 参数需要指定令牌" << std::endl;
+            return 1;
+        }
+    } else if (arg == "-c" || arg == "--cache") {
+        if (hasValue()) {
+            options.cachePath = takeValue();
+            std::cout << "设置: 签名缓存 = " << options.cachePath << std::endl;
+        } else {
+            std::cerr << "错误: --cache 参数需要指定缓存文件路径或 auto" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--scan") {
+        if (hasValue()) {
+            std::string scanMode = takeValue();
+            if (scanMode != "dir" && scanMode != "mft") {
+                std::cerr << "错误: 枚举方式必须是 'dir' 或 'mft'" << std::endl;
+                return 1;
+            }
+            options.scanMode = scanMode;
+            std::cout << "设置: 枚举方式 = " << scanMode << std::endl;
+        } else {
+            std::cerr << "错误: --scan 参数需要指定枚举方式" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--schedule") {
+        if (hasValue()) {
+            std::string schedule = takeValue();
+            if (schedule != "none" && schedule != "physical") {
+                std::cerr << "错误: 读取顺序必须是 'none' 或 'physical'" << std::endl;
+                return 1;
+            }
+            options.ioSchedule = schedule;
+            std::cout << "设置: 抽样读取顺序 = " << schedule << std::endl;
+        } else {
+            std::cerr << "错误: --schedule 参数需要指定读取顺序" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--queue-depth") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            try {
+                int depth = std::stoi(value);
+                if (depth < 1) {
+                    std::cerr << "错误: 队列深度必须大于 0" << std::endl;
+                    return 1;
+                }
+                options.queueDepth = static_cast<size_t>(depth);
+                std::cout << "设置: 队列深度 = " << options.queueDepth << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "错误: 无效的队列深度 '" << value << "'" << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "错误: --queue-depth 参数需要指定数字" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--incremental") {
+        options.scanMode = "mft";
+        options.incrementalScan = true;
+        std::cout << "设置: 通过 USN 日志增量扫描" << std::endl;
+    } else if (arg == "--mem-limit") {
+        if (hasValue()) {
+            std::string value = takeValue();
+            if (!parseByteSize(value, options.memoryLimit) || options.memoryLimit == 0) {
+                std::cerr << "错误: 无效的内存上限 '" << value << "'" << std::endl;
+                return 1;
+            }
+            std::cout << "设置: 分组排序内存上限 = " << value << std::endl;
+        } else {
+            std::cerr << "错误: --mem-limit 参数需要指定大小" << std::endl;
+            return 1;
+        }
+    } else if (arg == "--pipeline") {
+        options.pipeline = true;
+        std::cout << "设置: 流水线模式" << std::endl;
+    } else if (arg[0] != '-') {
+        // 这是目录路径
+        directory = arg;
+        std::cout << "设置: 目录路径 = " << directory << std::endl;
+    } else {
+        std::cerr << "未知选项: " << arg << std::endl;
+        return 1;
+    }
+}
+
+#ifndef _WIN32
+if (options.scanMode == "mft") {
+    std::cerr << "警告: MFT 扫描仅支持 Windows NTFS 卷，将使用目录遍历" << std::endl;
+    options.scanMode = "dir";
+    options.incrementalScan = false;
+}
+#endif
+
+// 预算默认配合按可节省空间排序；流水线按枚举顺序推进，无法排序，预算和排序时改用常规流程
+if (!orderGiven && (options.readBudget > 0 || options.timeBudgetMs > 0)) {
+    options.workOrder = "reclaimable";
+}
+if (options.workOrder == "reclaimable" || options.readBudget > 0 || options.timeBudgetMs > 0) {
+    if (options.mode != "all") {
+        std::cerr << "警告: 检测顺序和预算只用于全局模式, 已忽略" << std::endl;
+    } else if (options.pipeline) {
+        std::cerr << "警告: 流水线模式不支持检测顺序和预算, 已关闭流水线" << std::endl;
+        options.pipeline = false;
+    }
+}
+
+// 断点日志按全局检测的文件表下标记录；流水线边枚举边抽样，没有固定的文件表，写日志时改用常规流程
+if (options.resume && options.journalPath.empty()) {
+    std::cerr << "错误: --resume 需要配合 --journal 指定断点日志" << std::endl;
+    return 1;
+}
+if (!options.journalPath.empty()) {
+    if (options.mode != "all") {
+        std::cerr << "警告: 断点日志只用于全局模式, 已忽略" << std::endl;
+        options.journalPath.clear();
+        options.resume = false;
+    } else if (options.pipeline) {
+        std::cerr << "警告: 流水线模式不支持断点日志, 已关闭流水线" << std::endl;
+        options.pipeline = false;
+    }
+}
+
+// 分块在全文哈希的读取中切分，同步比较读到分歧就停止，因此改用全文哈希
+if (options.chunkIndex) {
+    if (options.verifyMode == "pairwise") {
+        std::cerr << "错误: --chunk-index 不能与 --verify pairwise 同时使用" << std::endl;
+        return 1;
+    }
+    if (options.verifyMode == "lockstep") {
+        std::cout << "提示: --chunk-index 需要读完整个文件, 精确比较改用全文哈希" << std::endl;
+        options.verifyMode = "hash";
+    }
+    if (options.mode != "all") {
+        std::cerr << "警告: 分块索引只用于全局模式, 已忽略" << std::endl;
+        options.chunkIndex = false;
+    }
+}
+
+// 进度报告在各模式下都可用，main 返回时停止
+std::optional<ProgressReporter> progress;
+if (progressOptions.statusLine || !progressOptions.metricsFile.empty() || !progressOptions.metricsPort.empty()) {
+    try {
+        progress.emplace(progressOptions);
+    } catch (const std::exception& e) {
+        std::cerr << "错误: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!progressOptions.metricsPort.empty()) {
+        std::cout << "指标服务已启动: " << progressOptions.metricsAddress << ":" << progressOptions.metricsPort
+                  << "/metrics" << std::endl;
+    }
+}
+
+// --apply 不扫描目录，直接执行保留方案
+if (!planPath.empty()) {
+    try {
+        InteractiveFileDeduplicator dedup(options);
+        bool applied = dedup.applyPlan(planPath);
+        dedup.reportStats();
+        return applied ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "程序出错: " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// 分布式模式：工作节点一直运行；协调节点不需要本地目录，只输出重复组和报告
+if (!serveAddress.empty()) {
+    size_t colon = serveAddress.rfind(':');
+    std::string address = colon == std::string::npos ? "127.0.0.1" : serveAddress.substr(0, colon);
+    std::string port = colon == std::string::npos ? serveAddress : serveAddress.substr(colon + 1);
+    if (address.size() > 2 && address.front() == '[' && address.back() == ']') {
+        address = address.substr(1, address.size() - 2);
+    }
+    options.reportFormat = ReportFormat::None;
+    try {
+        DistributedWorker(options, token).serve(address, port);
+    } catch (const std::exception& e) {
+        std::cerr << "程序出错: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+if (!workers.empty()) {
+    if (options.reportFormat == ReportFormat::Binary) {
+        std::cerr << "错误: 分布式模式的报告只支持 jsonl 或 csv 格式" << std::endl;
+        return 1;
+    }
+    try {
+        // 报告由协调节点写出，本地去重器只用于抽样计划、格式化和统计
+        DeduplicatorOptions localOptions = options;
+        localOptions.reportFormat = ReportFormat::None;
+        InteractiveFileDeduplicator dedup(localOptions);
+        DistributedCoordinator(dedup, options, token, workers).run();
+        dedup.reportStats();
+    } catch (const std::exception& e) {
+        std::cerr << "程序出错: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// 在参数解析完成后，添加路径验证
+if (directory.empty()) {
+    std::cerr << "错误: 未指定目录路径" << std::endl;
+    std::cerr << "请使用: main.exe [选项] <目录路径>" << std::endl;
+    std::cerr << "使用 -h 查看帮助信息" << std::endl;
+    return 1;
+}
+
+// 验证目录是否存在
+std::cout << "验证目录是否存在..." << std::endl;
+if (!fs::exists(directory)) {
+    std::cerr << "错误: 目录不存在: " << directory << std::endl;
+    return 1;
+}
+
+if (!fs::is_directory(directory)) {
+    std::cerr << "错误: 路径不是目录: " << directory << std::endl;
+    return 1;
+}
+
+std::cout << "目录验证通过" << std::endl;
+
+    std::cout << "最终参数:" << std::endl;
+    std::cout << "  目录: " << directory << std::endl;
+    std::cout << "  模式: " << options.mode << std::endl;
+    std::cout << "  模拟运行: " << (options.dryRun ? "是" : "否") << std::endl;
+    std::cout << "  详细输出: " << (options.verbose ? "是" : "否") << std::endl;
+
+    try {
+        InteractiveFileDeduplicator dedup(options);
+        std::cout << "开始执行去重操作..." << std::endl;
+        dedup.deduplicate(directory);
+        dedup.reportStats();
+        std::cout << "去重操作完成" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "程序出错: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "程序正常结束" << std::endl;
+    return 0;
+}
+#endif
\ No newline at end of file
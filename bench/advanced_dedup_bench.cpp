@@ -0,0 +1,576 @@
+// advanced_dedup 基准程序：生成可复现的合成数据集，分别测量各阶段和端到端检测的吞吐量
+// 直接包含 advanced_dedup.cpp (以 AFD_NO_MAIN 编译，不含其 main)，测量的是与正式程序相同的代码；
+// 每项测量输出一行 JSON，便于跨版本对比
+#include "advanced_dedup.cpp"
+
+namespace {
+
+struct BenchResult {
+    std::string name;
+    std::string dataset;
+    std::string cache = "warm";  // warm = 数据已在系统缓存中，cold = 测量前把数据集的文件清出缓存
+    int run = 0;
+    uint64_t files = 0;      // 处理的文件数
+    uint64_t bytes = 0;      // 处理的数据量 (哈希测量为哈希的字节数)
+    uint64_t bytesRead = 0;  // 实际读取的字节数 (哈希测量与 bytes 相同)
+    double seconds = 0;
+};
+
+// 丢弃写入的内容，测量期间替换 std::cout 的缓冲区，去掉去重器的进度输出
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int ch) override {
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char*, std::streamsize count) override {
+        return count;
+    }
+};
+
+class SilenceStdout {
+private:
+    NullBuffer sink;
+    std::streambuf* saved;
+
+public:
+    SilenceStdout() : saved(std::cout.rdbuf(&sink)) {}
+
+    ~SilenceStdout() {
+        std::cout.rdbuf(saved);
+    }
+
+    SilenceStdout(const SilenceStdout&) = delete;
+    SilenceStdout& operator=(const SilenceStdout&) = delete;
+};
+
+// SplitMix64：数据集的内容和大小都由它生成，种子相同则生成的数据集逐字节相同
+class Random {
+private:
+    uint64_t state;
+
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // [low, high] 内的整数
+    uint64_t between(uint64_t low, uint64_t high) {
+        return low + next() % (high - low + 1);
+    }
+
+    void fill(unsigned char* data, size_t length) {
+        for (size_t i = 0; i < length; i += 8) {
+            uint64_t word = next();
+            std::memcpy(data + i, &word, std::min<size_t>(8, length - i));
+        }
+    }
+};
+
+uint64_t totalBytesRead() {
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < kPhaseCount; ++i) {
+        bytes += PhaseProfiler::counters(static_cast<Phase>(i)).bytesRead;
+    }
+    return bytes;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// mbPerSecond 按实际读取量计算，只处理元数据的阶段为 0；peakRssBytes 是进程到此为止的峰值
+void printResult(const BenchResult& result) {
+    double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(3);
+    line << "{\"bench\":\"" << result.name << "\",\"dataset\":\"" << result.dataset << "\",\"cache\":\""
+         << result.cache << "\",\"run\":" << result.run << ",\"files\":" << result.files
+         << ",\"bytes\":" << result.bytes << ",\"bytesRead\":" << result.bytesRead
+         << ",\"seconds\":" << result.seconds << ",\"filesPerSecond\":" << result.files / seconds
+         << ",\"mbPerSecond\":" << result.bytesRead / seconds / (1024.0 * 1024.0)
+         << ",\"peakRssBytes\":" << processPeakMemory() << "}";
+    std::cout << line.str() << std::endl;
+}
+
+// 合成数据集：每种数据集针对一类典型负载，规模随 --scale 线性变化
+struct DatasetProfile {
+    const char* name;
+    const char* description;
+    void (*generate)(const fs::path& root, double scale, Random& random);
+};
+
+size_t scaled(size_t count, double scale) {
+    return std::max<size_t>(1, static_cast<size_t>(count * scale));
+}
+
+void writeFile(const fs::path& path, const std::vector<unsigned char>& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!out) {
+        throw std::runtime_error("写入文件失败: " + path.string());
+    }
+}
+
+// 大量小文件：1 B - 8 KB，约 30% 是此前某个文件的副本，分散在 100 个目录中
+void generateSmallFiles(const fs::path& root, double scale, Random& random) {
+    size_t count = scaled(20000, scale);
+    std::vector<std::vector<unsigned char>> originals;
+    for (size_t i = 0; i < count; ++i) {
+        fs::path dir = root / ("d" + std::to_string(i % 100));
+        fs::create_directories(dir);
+        std::vector<unsigned char> data;
+        if (!originals.empty() && random.between(0, 99) < 30) {
+            data = originals[random.between(0, originals.size() - 1)];
+        } else {
+            data.resize(random.between(1, 8192));
+            random.fill(data.data(), data.size());
+            originals.push_back(data);
+        }
+        writeFile(dir / ("f" + std::to_string(i) + ".bin"), data);
+    }
+}
+
+// 大小相同、共享 1 MB 文件头的大文件：每 4 个中两个相同，另两个在文件头之后的随机位置或最后一个字节不同，
+// 抽样必须读到文件头之后才能区分
+void generateLargeSharedHeader(const fs::path& root, double scale, Random& random) {
+    size_t count = std::max<size_t>(4, scaled(8, scale));
+    size_t size = std::max<size_t>(2 << 20, static_cast<size_t>((32 << 20) * std::min(scale, 1.0)));
+    fs::create_directories(root);
+
+    std::vector<unsigned char> base(size);
+    random.fill(base.data(), base.size());
+    for (size_t i = 0; i < count; ++i) {
+        std::vector<unsigned char> data = base;
+        if (i % 4 >= 2) {
+            size_t offset = i % 2 == 0 ? size - 1 : static_cast<size_t>(random.between(1 << 20, size - 1));
+            data[offset] ^= static_cast<unsigned char>(1 + i);
+        }
+        writeFile(root / ("large" + std::to_string(i) + ".bin"), data);
+    }
+}
+
+// 深层目录：多条 64 层的目录链，每层 3 个 4 KB 文件，约一半内容相同
+void generateDeepDirectories(const fs::path& root, double scale, Random& random) {
+    size_t chains = scaled(20, scale);
+    std::vector<unsigned char> shared(4096);
+    random.fill(shared.data(), shared.size());
+    for (size_t chain = 0; chain < chains; ++chain) {
+        fs::path dir = root / ("chain" + std::to_string(chain));
+        for (int depth = 0; depth < 64; ++depth) {
+            dir /= "level" + std::to_string(depth);
+            fs::create_directories(dir);
+            for (int k = 0; k < 3; ++k) {
+                std::vector<unsigned char> data = shared;
+                if (random.between(0, 1) == 0) {
+                    random.fill(data.data(), data.size());
+                }
+                writeFile(dir / ("f" + std::to_string(k) + ".bin"), data);
+            }
+        }
+    }
+}
+
+// 高重复率：256 KB 文件，每 10 个中只有 1 个原始文件，其余是随机某个原始文件的副本
+void generateDuplicateHeavy(const fs::path& root, double scale, Random& random) {
+    size_t count = scaled(2000, scale);
+    size_t originals = std::max<size_t>(1, count / 10);
+    fs::create_directories(root);
+    std::vector<std::vector<unsigned char>> contents(originals, std::vector<unsigned char>(256 * 1024));
+    for (auto& content : contents) {
+        random.fill(content.data(), content.size());
+    }
+    for (size_t i = 0; i < count; ++i) {
+        size_t source = i < originals ? i : static_cast<size_t>(random.between(0, originals - 1));
+        writeFile(root / ("f" + std::to_string(i) + ".bin"), contents[source]);
+    }
+}
+
+// 硬链接：每个 64 KB 文件另有 3 个硬链接，每 10 个文件中还有一个普通副本
+void generateHardLinks(const fs::path& root, double scale, Random& random) {
+    size_t count = scaled(500, scale);
+    fs::create_directories(root / "links");
+    for (size_t i = 0; i < count; ++i) {
+        std::vector<unsigned char> data(64 * 1024);
+        random.fill(data.data(), data.size());
+        fs::path original = root / ("f" + std::to_string(i) + ".bin");
+        writeFile(original, data);
+        for (int k = 0; k < 3; ++k) {
+            fs::create_hard_link(original, root / "links" / ("f" + std::to_string(i) + "_" + std::to_string(k) + ".bin"));
+        }
+        if (i % 10 == 0) {
+            writeFile(root / ("copy" + std::to_string(i) + ".bin"), data);
+        }
+    }
+}
+
+const std::vector<DatasetProfile>& datasetProfiles() {
+    static const std::vector<DatasetProfile> profiles = {
+        {"small", "20000 个 1 B - 8 KB 的小文件, 30% 重复", generateSmallFiles},
+        {"large-header", "8 个 32 MB 的同大小文件, 共享 1 MB 文件头", generateLargeSharedHeader},
+        {"deep", "20 条 64 层的目录链, 每层 3 个 4 KB 文件", generateDeepDirectories},
+        {"dup-heavy", "2000 个 256 KB 文件, 90% 重复", generateDuplicateHeavy},
+        {"hardlinks", "500 个 64 KB 文件, 每个另有 3 个硬链接", generateHardLinks},
+    };
+    return profiles;
+}
+
+// 尽力把文件清出系统缓存：Linux 用 POSIX_FADV_DONTNEED 丢弃干净的缓存页；Windows 以无缓冲方式打开，
+// 缓存管理器会清除该文件的缓存页；其余平台不支持。
+// 刚生成的文件的缓存页还是脏页，不会被丢弃，所以先把它们写回磁盘
+bool evictFromCache(const fs::path& path) {
+#ifdef _WIN32
+    HANDLE writable = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (writable != INVALID_HANDLE_VALUE) {
+        FlushFileBuffers(writable);
+        CloseHandle(writable);
+    }
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    CloseHandle(handle);
+    return true;
+#elif defined(POSIX_FADV_DONTNEED)
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ::fsync(fd);
+    int result = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+    return result == 0;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+bool coldCacheSupported() {
+#if defined(_WIN32) || defined(POSIX_FADV_DONTNEED)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void evictTable(const FileTable& files) {
+    for (uint32_t i = 0; i < files.fileCount(); ++i) {
+        evictFromCache(files.path(i));
+    }
+}
+
+volatile uint64_t hashSink;  // 保留哈希结果，避免循环被优化掉
+
+// 哈希内核：对内存中的缓冲区按抽样块大小分段计算 128 位摘要
+BenchResult benchHash(size_t bytes, size_t blockSize) {
+    std::vector<unsigned char> buffer(bytes);
+    Random random(1);
+    random.fill(buffer.data(), buffer.size());
+
+    BenchResult result;
+    result.name = "hash/" + std::to_string(blockSize);
+    result.dataset = "memory";
+    result.bytes = bytes;
+    result.bytesRead = bytes;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t mix = 0;
+    for (size_t offset = 0; offset < bytes; offset += blockSize) {
+        mix ^= hashing::hash128(buffer.data() + offset, std::min(blockSize, bytes - offset)).lo;
+    }
+    result.seconds = secondsSince(start);
+    hashSink = mix;
+    return result;
+}
+
+// 依次单独测量枚举、大小分组、抽样和精确比较，每个阶段的输入由上一阶段的测量产生；最后测量端到端检测。
+// cold 时每个读取文件内容的阶段开始前把数据集的文件清出缓存 (不计入时间)；只有文件内容是冷的，
+// 目录项和 inode 仍在缓存中，因此不测 cold 的 enumerate，end_to_end 中的枚举也是热的
+void benchDataset(const std::string& dataset, const fs::path& root, DeduplicatorOptions options,
+                  const std::string& cache, int run) {
+    options.dryRun = true;
+    options.autoConfirm = true;
+    bool cold = cache == "cold";
+
+    auto measure = [&](const std::string& name, const std::function<void(BenchResult&)>& body) {
+        BenchResult result;
+        result.name = name;
+        result.dataset = dataset;
+        result.cache = cache;
+        result.run = run;
+        uint64_t readBefore = totalBytesRead();
+        auto start = std::chrono::steady_clock::now();
+        {
+            SilenceStdout silence;
+            body(result);
+        }
+        result.seconds = secondsSince(start);
+        result.bytesRead = totalBytesRead() - readBefore;
+        printResult(result);
+    };
+
+    std::unique_ptr<InteractiveFileDeduplicator> dedup;
+    {
+        SilenceStdout silence;
+        dedup = std::make_unique<InteractiveFileDeduplicator>(options);
+    }
+
+    // 清不掉目录项和 inode 缓存，cold 时只枚举、不输出 enumerate 的测量
+    FileTable files;
+    uint64_t totalSize = 0;
+    auto enumerate = [&](BenchResult& result) {
+        DirectoryScanner scanner(options.threadCount, true);
+        files.append(scanner.scan(root));
+        result.files = files.fileCount();
+        for (uint32_t i = 0; i < files.fileCount(); ++i) {
+            totalSize += files.size(i);
+        }
+        result.bytes = totalSize;
+    };
+    if (cold) {
+        BenchResult unused;
+        enumerate(unused);
+    } else {
+        measure("enumerate", enumerate);
+    }
+
+    std::vector<uint32_t> candidates;
+    measure("size_group", [&](BenchResult& result) {
+        candidates = dedup->collectSizeCandidates(files);
+        result.files = files.fileCount();
+        result.bytes = totalSize;
+    });
+
+    if (cold) {
+        evictTable(files);
+    }
+    std::vector<FileGroup> signatureGroups;
+    measure("sampling", [&](BenchResult& result) {
+        signatureGroups = dedup->refineBySampling(files, candidates, false);
+        result.files = candidates.size();
+        for (uint32_t file : candidates) {
+            result.bytes += files.size(file);
+        }
+    });
+
+    if (cold) {
+        evictTable(files);
+    }
+    measure("verify", [&](BenchResult& result) {
+        // findExactDuplicates 由调用方标记阶段，这里同样标记，读取量才计入统计
+        PhaseScope scope(Phase::Verification);
+        for (const auto& group : signatureGroups) {
+            dedup->findExactDuplicates(files, group);
+            result.files += group.size();
+            result.bytes += files.size(group[0]) * group.size();
+        }
+        dedup->clearPrehashedGroups();
+    });
+
+    if (cold) {
+        evictTable(files);
+    }
+    measure("end_to_end", [&](BenchResult& result) {
+        InteractiveFileDeduplicator endToEnd(options);
+        auto detected = endToEnd.findDuplicatesInFolderRecursive(root);
+        result.files = static_cast<uint64_t>(detected.totalFiles);
+        result.bytes = detected.totalSize;
+    });
+}
+
+bool profileSelected(const std::string& list, const std::string& name) {
+    return list.empty() || ("," + list + ",").find("," + name + ",") != std::string::npos;
+}
+
+void printUsage() {
+    std::cout << "用法: advanced_dedup_bench [选项] [<目录路径>]" << std::endl;
+    std::cout << "不指定目录时生成合成数据集并逐个测量, 结束后删除; 指定目录时只测量该目录" << std::endl;
+    std::cout << "选项:" << std::endl;
+    std::cout << "  -t, --threads NUM     工作线程数, 0 表示使用全部 CPU 核心 (默认: 1)" << std::endl;
+    std::cout << "  -r, --repeat NUM      每项测量重复的次数 (默认: 3)" << std::endl;
+    std::cout << "  -p, --points NUM      第 2 轮抽样点数 (默认: 4)" << std::endl;
+    std::cout << "  -s, --size SIZE       基础抽样块大小 (默认: 4096)" << std::endl;
+    std::cout << "      --io BACKEND      文件读取后端 (默认: stream)" << std::endl;
+    std::cout << "      --verify MODE     精确比较方式 (默认: lockstep)" << std::endl;
+    std::cout << "      --cache MODE      warm、cold 或 both (默认: both)" << std::endl;
+    std::cout << "      --profiles LIST   逗号分隔的数据集名称 (默认: 全部)" << std::endl;
+    std::cout << "      --scale FACTOR    数据集规模倍数 (默认: 1)" << std::endl;
+    std::cout << "      --seed NUM        数据集随机种子 (默认: 1)" << std::endl;
+    std::cout << "      --scratch DIR     数据集生成位置, 其中的数据集目录必须不存在或为空 (默认: 系统临时目录)" << std::endl;
+    std::cout << "      --keep            测量后保留生成的数据集" << std::endl;
+    std::cout << "      --generate        只生成数据集, 不测量 (隐含 --keep)" << std::endl;
+    std::cout << "数据集:" << std::endl;
+    for (const auto& profile : datasetProfiles()) {
+        std::cout << "  " << std::left << std::setw(14) << profile.name << profile.description << std::endl;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    setupConsole();
+
+    DeduplicatorOptions options;
+    int repeat = 3;
+    double scale = 1.0;
+    uint64_t seed = 1;
+    bool keep = false;
+    bool generateOnly = false;
+    std::string cacheMode = "both";
+    std::string profileList;
+    std::string directory;
+    fs::path scratch;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        try {
+            if ((arg == "-t" || arg == "--threads") && hasValue) {
+                options.threadCount = std::stoul(argv[++i]);
+                if (options.threadCount == 0) {
+                    options.threadCount = std::max(1u, std::thread::hardware_concurrency());
+                }
+            } else if ((arg == "-r" || arg == "--repeat") && hasValue) {
+                repeat = std::max(1, std::stoi(argv[++i]));
+            } else if ((arg == "-p" || arg == "--points") && hasValue) {
+                options.samplePoints = std::stoul(argv[++i]);
+            } else if ((arg == "-s" || arg == "--size") && hasValue) {
+                options.sampleSize = std::stoul(argv[++i]);
+            } else if (arg == "--io" && hasValue) {
+                if (!parseIoBackend(argv[++i], options.ioBackend)) {
+                    throw std::invalid_argument(arg);
+                }
+            } else if (arg == "--verify" && hasValue) {
+                options.verifyMode = argv[++i];
+                if (options.verifyMode != "lockstep" && options.verifyMode != "hash" && options.verifyMode != "pairwise") {
+                    throw std::invalid_argument(arg);
+                }
+            } else if (arg == "--cache" && hasValue) {
+                cacheMode = argv[++i];
+                if (cacheMode != "warm" && cacheMode != "cold" && cacheMode != "both") {
+                    throw std::invalid_argument(arg);
+                }
+            } else if (arg == "--profiles" && hasValue) {
+                profileList = argv[++i];
+            } else if (arg == "--scale" && hasValue) {
+                scale = std::stod(argv[++i]);
+                if (scale <= 0) {
+                    throw std::invalid_argument(arg);
+                }
+            } else if (arg == "--seed" && hasValue) {
+                seed = std::stoull(argv[++i]);
+            } else if (arg == "--scratch" && hasValue) {
+                scratch = argv[++i];
+            } else if (arg == "--keep") {
+                keep = true;
+            } else if (arg == "--generate") {
+                generateOnly = true;
+                keep = true;
+            } else if (arg == "-h" || arg == "--help") {
+                printUsage();
+                return 0;
+            } else if (!arg.empty() && arg[0] != '-') {
+                directory = arg;
+            } else {
+                std::cerr << "错误: 未知选项 " << arg << std::endl;
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "错误: 无效的参数值 " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::string> caches;
+    if (cacheMode != "cold") {
+        caches.push_back("warm");
+    }
+    if (cacheMode != "warm") {
+        if (coldCacheSupported()) {
+            caches.push_back("cold");
+        } else {
+            std::cerr << "警告: 此平台不支持把文件清出系统缓存，跳过 cold 测量" << std::endl;
+        }
+    }
+
+    bool generated = directory.empty();
+    // 只删除本程序生成的数据集目录；根目录只有是本程序创建的临时目录时才删除，--scratch 指定的目录保留
+    bool ownScratch = generated && scratch.empty();
+    std::vector<fs::path> createdRoots;
+    auto removeGenerated = [&]() {
+        if (!generated || keep) {
+            return;
+        }
+        std::error_code ec;
+        for (const auto& root : createdRoots) {
+            fs::remove_all(root, ec);
+        }
+        if (ownScratch) {
+            fs::remove_all(scratch, ec);
+        }
+    };
+
+    std::vector<std::pair<std::string, fs::path>> datasets;
+    try {
+        if (!generated) {
+            if (!fs::is_directory(directory)) {
+                std::cerr << "错误: 目录不存在: " << directory << std::endl;
+                return 1;
+            }
+            datasets.emplace_back("dir", directory);
+        } else {
+            if (scratch.empty()) {
+                scratch = fs::temp_directory_path() / ("afd_bench_" + std::to_string(currentProcessId()));
+            }
+            for (const auto& profile : datasetProfiles()) {
+                if (!profileSelected(profileList, profile.name)) {
+                    continue;
+                }
+                fs::path root = scratch / profile.name;
+                if (fs::exists(root) && (!fs::is_directory(root) || !fs::is_empty(root))) {
+                    std::cerr << "错误: 数据集目录已存在且不为空: " << root.string() << std::endl;
+                    removeGenerated();
+                    return 1;
+                }
+                createdRoots.push_back(root);
+                // 每个数据集的种子由 --seed 和名称决定，只生成部分数据集时内容也不变
+                Random random(seed ^ hashing::hash128(profile.name, std::strlen(profile.name)).lo);
+                auto start = std::chrono::steady_clock::now();
+                profile.generate(root, scale, random);
+                std::cerr << "已生成数据集 " << profile.name << ": " << root.string() << " ("
+                          << static_cast<long long>(secondsSince(start) * 1000) << " ms)" << std::endl;
+                datasets.emplace_back(profile.name, root);
+            }
+            if (datasets.empty()) {
+                std::cerr << "错误: 没有匹配的数据集: " << profileList << std::endl;
+                return 1;
+            }
+        }
+
+        if (!generateOnly) {
+            for (int run = 0; run < repeat; ++run) {
+                BenchResult hash = benchHash(64 * 1024 * 1024, options.sampleSize);
+                hash.run = run;
+                printResult(hash);
+                for (const auto& dataset : datasets) {
+                    for (const auto& cache : caches) {
+                        benchDataset(dataset.first, dataset.second, options, cache, run);
+                    }
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "基准测试出错: " << e.what() << std::endl;
+        removeGenerated();
+        return 1;
+    }
+
+    removeGenerated();
+    return 0;
+}